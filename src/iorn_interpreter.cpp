@@ -4,1057 +4,7505 @@
 #include <regex>
 #include <sstream>
 #include <map>
+#include <set>
 #include <cmath>
 #include <algorithm>
+#include <numeric>
 #include <vector>
+#include <array>
+#include <deque>
+#include <unordered_map>
+#include <string_view>
+#include <cstdlib>
+#include <memory>
+#include <memory_resource>
+#include <charconv>
+#include <stdexcept>
+#include <cstdint>
+#include <cstddef>
+#include <atomic>
+#include <new>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <cerrno>
+#include <climits>
+#include <limits>
+#include <csignal>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
 #ifdef _WIN32
 #include <windows.h>
 #include <io.h>
 #include <fcntl.h>
+#else
+#include <poll.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/time.h>
+#endif
+#ifdef __linux__
+#include <sys/inotify.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#else
+#include <filesystem>
 #endif
 
-class IornInterpreter {
+// Allocation counters behind `--stats=alloc`. Once that is given, every
+// operator new in the process is counted with two relaxed atomic increments.
+static std::atomic<size_t> allocationCount{0};
+static std::atomic<size_t> allocationBytes{0};
+static std::atomic<bool> allocationCounting{false};
+
+// Bytes held on behalf of an interpreter, behind `--max-memory` and
+// `--stats=mem`. While an account is active on a thread, every operator new
+// on that thread is charged to it and to its parent; the matching delete
+// credits them back on whatever thread it runs. An operator new that would
+// take an account over its limit throws std::bad_alloc instead. `held` also
+// counts one reference for the owner, so an account whose owner is gone is
+// freed by the delete that returns its last byte. Accounts are only charged
+// once `--max-memory` or `--stats=mem` turns memoryAccounting on; until then
+// operator new is malloc() plus the header.
+struct MemoryAccount {
+    std::atomic<size_t> held{1};
+    std::atomic<size_t> peak{0};
+    std::atomic<size_t> refused{0};    // size of the allocation the limit refused, 0 if none
+    size_t limit = 0;                  // 0 for no limit
+    MemoryAccount* parent = nullptr;
+
+    static MemoryAccount* create(MemoryAccount* parent = nullptr) {
+        // Taken from malloc so that creating an account is not charged to one.
+        MemoryAccount* account = new (std::malloc(sizeof(MemoryAccount))) MemoryAccount();
+        account->parent = parent;
+        return account;
+    }
+
+    size_t current() const { return held.load(std::memory_order_relaxed) - 1; }
+
+    void resetPeak() {
+        peak.store(current(), std::memory_order_relaxed);
+        refused.store(0, std::memory_order_relaxed);
+    }
+
+    bool overLimit() const { return refused.load(std::memory_order_relaxed) != 0; }
+
+    // Records the refusal if `size` more bytes would take the account over
+    // its limit.
+    bool refuse(size_t size) {
+        if (limit == 0 || current() + size <= limit) return false;
+        refused.store(std::max<size_t>(size, 1), std::memory_order_relaxed);
+        return true;
+    }
+
+    void charge(size_t size) {
+        for (MemoryAccount* account = this; account != nullptr; account = account->parent) {
+            size_t now = account->held.fetch_add(size, std::memory_order_relaxed) + size - 1;
+            size_t seen = account->peak.load(std::memory_order_relaxed);
+            while (now > seen && !account->peak.compare_exchange_weak(seen, now, std::memory_order_relaxed)) {}
+        }
+    }
+
+    void credit(size_t size) {
+        for (MemoryAccount* account = this; account != nullptr; ) {
+            MemoryAccount* parent = account->parent;
+            drop(account, size);
+            account = parent;
+        }
+    }
+
+    // Gives up the owner's reference.
+    void release() { drop(this, 1); }
+
 private:
-    std::map<std::string, std::string> variables;
-    
-    void setRedColor() {
-#ifdef _WIN32
-        HANDLE hConsole = GetStdHandle(STD_ERROR_HANDLE);
-        if (hConsole != INVALID_HANDLE_VALUE) {
-            SetConsoleTextAttribute(hConsole, FOREGROUND_RED | FOREGROUND_INTENSITY);
+    static void drop(MemoryAccount* account, size_t size) {
+        if (account->held.fetch_sub(size, std::memory_order_acq_rel) == size) {
+            account->~MemoryAccount();
+            std::free(account);
         }
+    }
+};
+
+static thread_local MemoryAccount* activeAccount = nullptr;
+static std::atomic<bool> memoryAccounting{false};
+
+// Makes `account` the one charged on this thread until the scope ends.
+class MemoryScope {
+public:
+    explicit MemoryScope(MemoryAccount* account) : saved(activeAccount) { activeAccount = account; }
+    ~MemoryScope() { activeAccount = saved; }
+    void switchTo(MemoryAccount* account) { activeAccount = account; }
+    MemoryScope(const MemoryScope&) = delete;
+    MemoryScope& operator=(const MemoryScope&) = delete;
+
+private:
+    MemoryAccount* saved;
+};
+
+// True when the account charged on this thread, or one above it, refused an
+// allocation during the current run.
+static bool memoryLimitExceeded() {
+    for (const MemoryAccount* account = activeAccount; account != nullptr; account = account->parent) {
+        if (account->overLimit()) return true;
+    }
+    return false;
+}
+
+// Every block carries its size and the account it was charged to, so the
+// delete can credit the right account. The header stays when accounting is
+// off, since a block may outlive the switch.
+struct alignas(alignof(std::max_align_t)) AllocationHeader {
+    size_t size;
+    MemoryAccount* account;
+};
+
+// The account an allocation of `size` bytes is charged to, if any.
+static MemoryAccount* chargeAllocation(size_t size) {
+    MemoryAccount* charged = memoryAccounting.load(std::memory_order_relaxed) ? activeAccount : nullptr;
+    for (MemoryAccount* account = charged; account != nullptr; account = account->parent) {
+        if (account->refuse(size)) throw std::bad_alloc();
+    }
+    if (allocationCounting.load(std::memory_order_relaxed)) {
+        allocationCount.fetch_add(1, std::memory_order_relaxed);
+        allocationBytes.fetch_add(size, std::memory_order_relaxed);
+    }
+    if (charged) charged->charge(size);
+    return charged;
+}
+
+// Gives the charge back and throws if malloc() found no memory.
+static void* checkBlock(void* block, size_t size, MemoryAccount* account) {
+    if (block == nullptr) {
+        if (account) account->credit(size);
+        throw std::bad_alloc();
+    }
+    return block;
+}
+
+static void* placeHeader(void* at, size_t size, MemoryAccount* account) {
+    AllocationHeader* header = static_cast<AllocationHeader*>(at);
+    header->size = size;
+    header->account = account;
+    return header + 1;
+}
+
+// Kept out of line so the compiler does not pair inlined malloc() and free()
+// calls with operator new and delete and warn about a mismatch.
+#if defined(__GNUC__)
+#define IORN_NOINLINE __attribute__((noinline))
 #else
-        std::cerr << "\033[31m";
+#define IORN_NOINLINE
 #endif
+
+void* operator new(size_t size) {
+    MemoryAccount* account = chargeAllocation(size);
+    return placeHeader(checkBlock(std::malloc(sizeof(AllocationHeader) + size), size, account), size, account);
+}
+
+void* operator new[](size_t size) {
+    return operator new(size);
+}
+
+// An over-aligned block also keeps the address malloc() returned, just
+// below its header.
+IORN_NOINLINE void* operator new(size_t size, std::align_val_t alignment) {
+    size_t align = std::max(static_cast<size_t>(alignment), alignof(AllocationHeader));
+    size_t reserved = sizeof(AllocationHeader) + sizeof(void*);
+    MemoryAccount* account = chargeAllocation(size);
+    char* block = static_cast<char*>(checkBlock(std::malloc(reserved + align + size), size, account));
+    uintptr_t start = reinterpret_cast<uintptr_t>(block) + reserved;
+    char* data = block + reserved + (align - start % align) % align;
+    reinterpret_cast<void**>(data - sizeof(AllocationHeader))[-1] = block;
+    return placeHeader(data - sizeof(AllocationHeader), size, account);
+}
+
+IORN_NOINLINE void* operator new[](size_t size, std::align_val_t alignment) {
+    return operator new(size, alignment);
+}
+
+IORN_NOINLINE void operator delete(void* p) noexcept {
+    if (p == nullptr) return;
+    AllocationHeader* header = static_cast<AllocationHeader*>(p) - 1;
+    if (header->account) header->account->credit(header->size);
+    std::free(header);
+}
+
+IORN_NOINLINE void operator delete[](void* p) noexcept { operator delete(p); }
+IORN_NOINLINE void operator delete(void* p, size_t) noexcept { operator delete(p); }
+IORN_NOINLINE void operator delete[](void* p, size_t) noexcept { operator delete(p); }
+
+IORN_NOINLINE void operator delete(void* p, std::align_val_t) noexcept {
+    if (p == nullptr) return;
+    AllocationHeader* header = static_cast<AllocationHeader*>(p) - 1;
+    if (header->account) header->account->credit(header->size);
+    std::free(reinterpret_cast<void**>(header)[-1]);
+}
+
+IORN_NOINLINE void operator delete[](void* p, std::align_val_t alignment) noexcept { operator delete(p, alignment); }
+IORN_NOINLINE void operator delete(void* p, size_t, std::align_val_t alignment) noexcept { operator delete(p, alignment); }
+IORN_NOINLINE void operator delete[](void* p, size_t, std::align_val_t alignment) noexcept { operator delete(p, alignment); }
+
+// Bump allocator for data that lives exactly as long as its owner: parsed
+// statements and their text, the caches indexing them, and the variables of a
+// run. An allocation is a pointer increment inside a 64 KB chunk; nothing is
+// freed individually and everything goes back to the heap at once, so running
+// scripts in a loop does not fragment it. Also usable as a memory resource
+// for std::pmr containers.
+class Arena : public std::pmr::memory_resource {
+public:
+    Arena() = default;
+    Arena(const Arena&) = delete;
+    Arena& operator=(const Arena&) = delete;
+
+    std::string_view copy(std::string_view text) {
+        if (text.empty()) return std::string_view();
+        char* data = static_cast<char*>(allocate(text.length(), 1));
+        std::copy(text.begin(), text.end(), data);
+        return std::string_view(data, text.length());
     }
-    
-    void resetColor() {
-#ifdef _WIN32
-        HANDLE hConsole = GetStdHandle(STD_ERROR_HANDLE);
-        if (hConsole != INVALID_HANDLE_VALUE) {
-            SetConsoleTextAttribute(hConsole, FOREGROUND_RED | FOREGROUND_GREEN | FOREGROUND_BLUE);
+
+    // Objects made here are never destroyed; they may only own memory that
+    // also comes from this arena.
+    template <typename T, typename... Args>
+    T* create(Args&&... args) {
+        return new (allocate(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+    }
+
+    void release() {
+        chunks.clear();
+        current = limit = nullptr;
+        used = reserved = 0;
+    }
+
+    size_t bytesUsed() const { return used; }
+    size_t bytesReserved() const { return reserved; }
+
+private:
+    static constexpr size_t chunkSize = 64 * 1024;
+
+    void* do_allocate(size_t bytes, size_t alignment) override {
+        used += bytes;
+        // Large blocks get a chunk of their own so the current one keeps its tail.
+        if (bytes > chunkSize / 4) {
+            return alignUp(newChunk(bytes + alignment), alignment);
         }
-#else
-        std::cerr << "\033[0m";
-#endif
+        char* p = alignUp(current, alignment);
+        if (p == nullptr || p + bytes > limit) {
+            current = newChunk(chunkSize);
+            limit = current + chunkSize;
+            p = alignUp(current, alignment);
+        }
+        current = p + bytes;
+        return p;
     }
-    
-    int getLineNumber(const std::string& code, size_t pos) {
-        return static_cast<int>(std::count(code.begin(), code.begin() + pos, '\n') + 1);
+
+    void do_deallocate(void*, size_t, size_t) override {}
+
+    bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override {
+        return this == &other;
+    }
+
+    static char* alignUp(char* p, size_t alignment) {
+        if (p == nullptr) return nullptr;
+        uintptr_t address = reinterpret_cast<uintptr_t>(p);
+        return p + ((alignment - address % alignment) % alignment);
+    }
+
+    char* newChunk(size_t bytes) {
+        chunks.emplace_back(new char[bytes]);
+        reserved += bytes;
+        return chunks.back().get();
+    }
+
+    std::vector<std::unique_ptr<char[]>> chunks;
+    char* current = nullptr;
+    char* limit = nullptr;
+    size_t used = 0;
+    size_t reserved = 0;
+};
+
+// Variable value. The text lives in a shared, append-only buffer: copies
+// share it, and appending to a value that still ends at the end of its buffer
+// extends the buffer in place with capacity doubling. A value whose buffer
+// has been extended by another copy takes a private copy of its own prefix
+// first, so `rename variable s string = s + "...";` repeated n times costs
+// O(n) in total instead of O(n^2).
+class Value {
+public:
+    Value() = default;
+    Value(std::string text) : buffer(std::make_shared<std::string>(std::move(text))), length(buffer->length()) {}
+    Value(const char* text) : Value(std::string(text)) {}
+    explicit Value(std::string_view text) : buffer(std::make_shared<std::string>(text)), length(text.length()) {}
+
+    std::string_view view() const {
+        return buffer ? std::string_view(buffer->data(), length) : std::string_view();
+    }
+
+    std::string str() const {
+        return std::string(view());
+    }
+
+    void append(std::string_view text) {
+        if (text.empty()) return;
+        if (!buffer) {
+            *this = Value(std::string(text));
+            return;
+        }
+        // Text taken from this buffer would dangle if the buffer grows.
+        if (text.data() >= buffer->data() && text.data() < buffer->data() + buffer->capacity()) {
+            std::string copy(text);
+            append(copy);
+            return;
+        }
+        if (buffer->length() != length) {
+            buffer = std::make_shared<std::string>(view());
+        }
+        if (buffer->capacity() < length + text.length()) {
+            buffer->reserve(std::max(buffer->capacity() * 2, length + text.length()));
+        }
+        buffer->append(text.data(), text.length());
+        length = buffer->length();
     }
+
+    bool operator==(std::string_view other) const { return view() == other; }
+    bool operator!=(std::string_view other) const { return view() != other; }
+
+private:
+    std::shared_ptr<std::string> buffer;
+    size_t length = 0;
+};
+
+// Compiled form of an if-condition. The condition text is parsed once into a
+// flat node list with operand kinds already known; evaluation walks the nodes
+// without regex, string splitting or allocation.
+//
+// A Call node names the function in `text` and points to its first Arg node;
+// each Arg holds one argument expression in `lhs` and the next Arg in `rhs`.
+// A List (`[1, 2]`) chains its elements the same way. Index (`xs[i]`) names
+// the array in `text` and holds the index in `lhs`; the array builtins hold
+// their one argument in `lhs`.
+// Local nodes only occur in function bodies: they read a parameter or local
+// variable from the frame of the running function.
+enum class CondOp {
+    IntLit, FloatLit, StringLit, BoolLit, Slot, Local,
+    Neg, Add, Sub, Mul, Div, Mod, Pow,
+    Eq, Ne, Ge, Le, Gt, Lt,
+    And, Or, Not,
+    Call, Arg,
+    Index, List, Length, Sum, Min, Max, Range
+};
+
+struct Function;
+struct NumberArray;
+
+struct CondNode {
+    CondOp op;
+    int lhs = -1;
+    int rhs = -1;
+    double number = 0;
+    bool numericText = false;          // string literal whose content is a number
+    bool calls = false;                // a function is called in this subtree
+    bool arrays = false;               // an array element or aggregate is read in this subtree
+    int local = -1;                    // frame slot of a Local node
+    std::string text;                  // literal text, variable or function name, or expression source
+    const Value* slot = nullptr;       // resolved variable value, filled on first use
+    const Function* callee = nullptr;  // resolved function of a Call, filled on first call
+    NumberArray* array = nullptr;      // resolved array of a Slot or Index, filled on first use
+};
+
+struct CompiledCondition {
+    std::vector<CondNode> nodes;
+    int root = -1;
+};
+
+struct CondValue {
+    bool numeric;
+    double number;
+    std::string_view text;
+    Value owner;                       // holds `text` when it was computed, e.g. returned by a call
+    bool unformatted = false;          // `text` of a number held by a function is built on demand
+    bool integer = false;
+};
+
+// Why evaluating a condition or an initialiser failed. Failures are ordinary
+// results rather than exceptions: an operand that is not a number is how a
+// comparison learns to compare text, and scripts do that all the time.
+enum class EvalError : uint8_t {
+    None, InvalidCondition, InvalidExpression, NotNumeric, NotBoolean, UndeclaredVariable, OutOfRange,
+    // Calls of user-defined functions.
+    UnknownFunction, ArgumentCount, ArgumentType, NoValue, MissingReturn, ReturnType, CallDepth,
+    Reported,                          // already reported inside the called function
+    // Arrays.
+    ArrayValue, NotArray, IndexOutOfRange, LengthMismatch, EmptyArray
+};
+
+template <typename T>
+struct EvalResult {
+    T value{};
+    EvalError error = EvalError::None;
+    int node = -1;                     // node the failure was found at
+    explicit operator bool() const { return error == EvalError::None; }
+};
+
+// A failed evaluation as reported to the user.
+struct Diagnostic {
+    EvalError kind = EvalError::None;
+    int line = 0;
+    std::string_view source;           // condition or initialiser as written
+    std::string_view operand;          // variable or literal at the failing node
+    std::string_view expected;         // declared type, for initialisers
+};
+
+// Numbers cross the string boundary only through parseNumber() and
+// formatNumber(): literals, input, condition operands and computed values.
+// Neither depends on the locale. IORN spells a number as `-?\d+` (numeric)
+// or `-?\d+\.\d+` (floating); exponents, signs other than a leading '-'
+// and surrounding spaces are not numbers.
+enum class NumberForm : uint8_t { None, Integer, Decimal };
+
+// Validates and converts in one pass. Up to 19 digits whose value fits a
+// double's mantissa are converted exactly from the accumulated integer;
+// longer numbers are left to std::from_chars. A number beyond the range of
+// a double is not a number; one too small for it reads as 0.
+static NumberForm parseNumber(std::string_view text, double& out) {
+    static constexpr double powersOfTen[] = {
+        1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+        1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+    };
+    const char* p = text.data();
+    const char* end = p + text.length();
+    bool negative = p != end && *p == '-';
+    if (negative) p++;
     
-    int getCharNumber(const std::string& code, size_t pos) {
-        size_t lastNewline = code.rfind('\n', pos);
-        return static_cast<int>((lastNewline == std::string::npos) ? pos + 1 : pos - lastNewline);
+    uint64_t mantissa = 0;
+    const char* digits = p;
+    while (p != end && static_cast<unsigned>(*p - '0') < 10) mantissa = mantissa * 10 + static_cast<unsigned>(*p++ - '0');
+    if (p == digits) return NumberForm::None;
+    size_t integerDigits = static_cast<size_t>(p - digits);
+    size_t fractionDigits = 0;
+    NumberForm form = NumberForm::Integer;
+    if (p != end && *p == '.') {
+        const char* fraction = ++p;
+        while (p != end && static_cast<unsigned>(*p - '0') < 10) mantissa = mantissa * 10 + static_cast<unsigned>(*p++ - '0');
+        fractionDigits = static_cast<size_t>(p - fraction);
+        if (fractionDigits == 0) return NumberForm::None;
+        form = NumberForm::Decimal;
     }
+    if (p != end) return NumberForm::None;
     
-    bool checkSyntax(const std::string& code) {
-        std::istringstream stream(code);
-        std::string line;
-        int lineNum = 0;
-        
-        while (std::getline(stream, line)) {
-            lineNum++;
-            
-            if (line.empty() || line.find("@rem") != std::string::npos || 
-                line.find("##") != std::string::npos || line.find("\"\"\"") != std::string::npos ||
-                line.find("@remLine") != std::string::npos) {
-                continue;
-            }
-            
-            std::regex functionCall("\\w+\\s*\\(");
-            std::regex nullDeclaration("new variable\\s+\\w+\\s+NULL;");
-            bool isIfRelated = (line.find("if (") != std::string::npos || line.find("else") != std::string::npos || line.find("endif") != std::string::npos);
-            bool isIgnore = (line.find("ignore") != std::string::npos);
-            
-            if ((std::regex_search(line, functionCall) || line.find("import ") != std::string::npos || 
-                 line.find("new variable") != std::string::npos || line.find("rename variable") != std::string::npos) && 
-                !std::regex_match(line, nullDeclaration) && !isIfRelated && !isIgnore) {
-                
-                std::string trimmed = line;
-                trimmed.erase(trimmed.find_last_not_of(" \t\r\n") + 1);
-                
-                if (!trimmed.empty() && trimmed.back() != ';' && trimmed.back() != ':') {
-                    setRedColor();
-                    std::cerr << "There is no ending on " << lineNum 
-                              << " page " << trimmed.length() + 1 << " character!" << std::endl;
-                    resetColor();
-                    return false;
-                }
-            }
+    // Both operands are exact doubles, so the one division rounds correctly.
+    if (integerDigits + fractionDigits <= 19 && mantissa <= (uint64_t(1) << 53)) {
+        double value = static_cast<double>(mantissa) / powersOfTen[fractionDigits];
+        out = negative ? -value : value;
+    } else if (std::from_chars(text.data(), end, out, std::chars_format::fixed).ec != std::errc()) {
+        if (std::find_if(digits, digits + integerDigits, [](char c) { return c != '0'; }) != digits + integerDigits) {
+            return NumberForm::None;
         }
-        return true;
+        out = negative ? -0.0 : 0.0;
     }
-    
-    std::string removeComments(const std::string& code) {
-        std::string result = code;
-        
-        size_t pos = 0;
-        while ((pos = result.find("@remLine(", pos)) != std::string::npos) {
-            size_t start = pos;
-            size_t end = pos + 9;
-            int brackets = 1;
-            
-            while (end < result.length() && brackets > 0) {
-                if (result[end] == '(') brackets++;
-                else if (result[end] == ')') brackets--;
-                end++;
-            }
-            
-            if (brackets == 0) {
-                result.erase(start, end - start);
-                pos = start;
-            } else {
-                pos++;
-            }
+    return form;
+}
+
+// Recursive-descent compiler for conditions:
+//   or-expr   := and-expr ("or" and-expr)*
+//   and-expr  := not-expr ("and" not-expr)*
+//   not-expr  := "not" not-expr | comparison
+//   comparison:= sum (("=="|"!="|">="|"<="|">"|"<") sum)?
+//   sum       := product (("+"|"-") product)*
+//   product   := unary (("*"|"/"|"%") unary)*
+//   unary     := "-" unary | power
+//   power     := primary (("**"|"^") unary)?
+//   primary   := number | "string" | TRUE | FALSE | name | name "[" sum "]" | call
+//              | "[" (sum ("," sum)*)? "]" | "(" or-expr ")"
+//   call      := name "(" (or-expr ("," or-expr)*)? ")"
+// The array builtins length, sum, min, max and range take one argument.
+class ConditionCompiler {
+public:
+    explicit ConditionCompiler(const std::string& source) : src(source) {}
+
+    bool compile(CompiledCondition& out) {
+        nodes = &out.nodes;
+        nodes->clear();
+        pos = 0;
+        int root = parseOr();
+        skipSpaces();
+        if (root < 0 || pos != src.length() || !isBooleanValued(root)) {
+            return false;
         }
-        
-        result = std::regex_replace(result, std::regex("@rem.*"), "");
-        result = std::regex_replace(result, std::regex("##.*"), "");
-        result = std::regex_replace(result, std::regex("\"\"\"[\\s\\S]*?\"\"\""), "");
-        
-        return result;
+        out.root = root;
+        return true;
     }
-    
-    bool validateVariable(const std::string& varName, const std::string& varType, const std::string& varValue, int lineNum) {
-        if (varName.empty() || !std::isalpha(varName[0])) {
-            setRedColor();
-            std::cerr << "Variable name '" << varName << "' is invalid on line " << lineNum << ". Must start with a letter." << std::endl;
-            resetColor();
+
+    // Arithmetic initialiser of a numeric or floating variable.
+    bool compileExpression(CompiledCondition& out) {
+        nodes = &out.nodes;
+        nodes->clear();
+        pos = 0;
+        int root = parseSum();
+        skipSpaces();
+        if (root < 0 || pos != src.length() || isBooleanOp((*nodes)[root].op) || (*nodes)[root].op == CondOp::StringLit) {
             return false;
         }
-        
-        if (variables.find(varName) != variables.end()) {
-            setRedColor();
-            std::cerr << "Variable '" << varName << "' is already declared on line " << lineNum << "." << std::endl;
-            resetColor();
+        out.root = root;
+        return true;
+    }
+
+    // Value of any type: a function argument or return value.
+    bool compileValue(CompiledCondition& out) {
+        nodes = &out.nodes;
+        nodes->clear();
+        pos = 0;
+        int root = parseOr();
+        skipSpaces();
+        if (root < 0 || pos != src.length()) {
             return false;
         }
-        
-        std::string trimmedValue = varValue;
-        trimmedValue.erase(0, trimmedValue.find_first_not_of(" \t"));
-        trimmedValue.erase(trimmedValue.find_last_not_of(" \t") + 1);
-        
-        if (varType == "string") {
-            if (trimmedValue.length() < 2 || trimmedValue.front() != '"' || trimmedValue.back() != '"') {
-                setRedColor();
-                std::cerr << "String value must be enclosed in quotes on line " << lineNum << "." << std::endl;
-                resetColor();
-                return false;
+        out.root = root;
+        return true;
+    }
+
+private:
+    const std::string& src;
+    size_t pos = 0;
+    std::vector<CondNode>* nodes = nullptr;
+
+    void skipSpaces() {
+        while (pos < src.length() && std::isspace(static_cast<unsigned char>(src[pos]))) pos++;
+    }
+
+    static bool isWordChar(char c) {
+        return std::isalnum(static_cast<unsigned char>(c)) || c == '_';
+    }
+
+    bool matchWord(const char* word) {
+        skipSpaces();
+        size_t len = std::char_traits<char>::length(word);
+        if (src.compare(pos, len, word) != 0) return false;
+        if (pos + len < src.length() && isWordChar(src[pos + len])) return false;
+        pos += len;
+        return true;
+    }
+
+    bool matchSymbol(const char* symbol) {
+        skipSpaces();
+        size_t len = std::char_traits<char>::length(symbol);
+        if (src.compare(pos, len, symbol) != 0) return false;
+        pos += len;
+        return true;
+    }
+
+    bool isBooleanOp(CondOp op) const {
+        return op == CondOp::BoolLit || op == CondOp::Not || op == CondOp::And || op == CondOp::Or ||
+               (op >= CondOp::Eq && op <= CondOp::Lt);
+    }
+
+    bool isBooleanValued(int idx) const {
+        CondOp op = (*nodes)[idx].op;
+        return isBooleanOp(op) || op == CondOp::Slot || op == CondOp::Call;
+    }
+
+    int add(CondNode node) {
+        nodes->push_back(std::move(node));
+        return static_cast<int>(nodes->size()) - 1;
+    }
+
+    int node(CondOp op, int lhs, int rhs = -1) {
+        CondNode n;
+        n.op = op;
+        n.lhs = lhs;
+        n.rhs = rhs;
+        n.calls = (lhs >= 0 && (*nodes)[lhs].calls) || (rhs >= 0 && (*nodes)[rhs].calls);
+        n.arrays = op == CondOp::Index || (op >= CondOp::Length && op <= CondOp::Max) ||
+                   (lhs >= 0 && (*nodes)[lhs].arrays) || (rhs >= 0 && (*nodes)[rhs].arrays);
+        return add(std::move(n));
+    }
+
+    int logical(CondOp op, int lhs, int rhs) {
+        if (lhs < 0 || rhs < 0 || !isBooleanValued(lhs) || !isBooleanValued(rhs)) return -1;
+        return node(op, lhs, rhs);
+    }
+
+    // Arithmetic nodes keep their source text for the string-comparison fallback.
+    // Inner links of a chain like `a + b + c` are only ever operands of the
+    // next link, so only the whole chain is named; naming every prefix would
+    // copy the text a quadratic number of times.
+    int arithmetic(CondOp op, int lhs, int rhs, size_t start, bool named = true) {
+        if (lhs < 0 || (rhs < 0 && op != CondOp::Neg)) return -1;
+        if (isBooleanOp((*nodes)[lhs].op) || (rhs >= 0 && isBooleanOp((*nodes)[rhs].op))) return -1;
+        int idx = node(op, lhs, rhs);
+        if (named) name(idx, start);
+        return idx;
+    }
+
+    void name(int idx, size_t start) {
+        std::string text = src.substr(start, pos - start);
+        text.erase(text.find_last_not_of(" \t\r\n") + 1);
+        (*nodes)[idx].text = std::move(text);
+    }
+
+    int parseOr() {
+        int lhs = parseAnd();
+        while (lhs >= 0 && matchWord("or")) {
+            lhs = logical(CondOp::Or, lhs, parseAnd());
+        }
+        return lhs;
+    }
+
+    int parseAnd() {
+        int lhs = parseNot();
+        while (lhs >= 0 && matchWord("and")) {
+            lhs = logical(CondOp::And, lhs, parseNot());
+        }
+        return lhs;
+    }
+
+    int parseNot() {
+        if (matchWord("not")) {
+            int operand = parseNot();
+            if (operand < 0 || !isBooleanValued(operand)) return -1;
+            return node(CondOp::Not, operand);
+        }
+        return parseComparison();
+    }
+
+    int parseComparison() {
+        int lhs = parseSum();
+        if (lhs < 0) return -1;
+        // Two-character operators come first so `>=` is never read as `>`.
+        static const std::pair<const char*, CondOp> operators[] = {
+            {"==", CondOp::Eq}, {"!=", CondOp::Ne}, {">=", CondOp::Ge},
+            {"<=", CondOp::Le}, {">", CondOp::Gt}, {"<", CondOp::Lt}
+        };
+        for (const auto& op : operators) {
+            if (matchSymbol(op.first)) {
+                int rhs = parseSum();
+                return rhs < 0 ? -1 : node(op.second, lhs, rhs);
             }
-        } else if (varType == "numeric") {
-            if (!std::regex_match(trimmedValue, std::regex("^-?\\d+$"))) {
-                setRedColor();
-                std::cerr << "Invalid numeric value '" << trimmedValue << "' on line " << lineNum << "." << std::endl;
-                resetColor();
-                return false;
+        }
+        return lhs;
+    }
+
+    int parseSum() {
+        skipSpaces();
+        size_t start = pos;
+        int first = parseProduct();
+        int lhs = first;
+        while (lhs >= 0) {
+            if (matchSymbol("+")) lhs = arithmetic(CondOp::Add, lhs, parseProduct(), start, false);
+            else if (matchSymbol("-")) lhs = arithmetic(CondOp::Sub, lhs, parseProduct(), start, false);
+            else break;
+        }
+        if (lhs >= 0 && lhs != first) name(lhs, start);
+        return lhs;
+    }
+
+    int parseProduct() {
+        skipSpaces();
+        size_t start = pos;
+        int first = parseUnary();
+        int lhs = first;
+        while (lhs >= 0) {
+            if (matchSymbol("*")) lhs = arithmetic(CondOp::Mul, lhs, parseUnary(), start, false);
+            else if (matchSymbol("/")) lhs = arithmetic(CondOp::Div, lhs, parseUnary(), start, false);
+            else if (matchSymbol("%")) lhs = arithmetic(CondOp::Mod, lhs, parseUnary(), start, false);
+            else break;
+        }
+        if (lhs >= 0 && lhs != first) name(lhs, start);
+        return lhs;
+    }
+
+    int parseUnary() {
+        skipSpaces();
+        size_t start = pos;
+        if (matchSymbol("-")) {
+            return arithmetic(CondOp::Neg, parseUnary(), -1, start);
+        }
+        return parsePower();
+    }
+
+    int parsePower() {
+        skipSpaces();
+        size_t start = pos;
+        int base = parsePrimary();
+        if (base >= 0 && (matchSymbol("**") || matchSymbol("^"))) {
+            return arithmetic(CondOp::Pow, base, parseUnary(), start);
+        }
+        return base;
+    }
+
+    int parsePrimary() {
+        skipSpaces();
+        if (pos >= src.length()) return -1;
+        char c = src[pos];
+
+        if (c == '(') {
+            pos++;
+            int inner = parseOr();
+            return (inner >= 0 && matchSymbol(")")) ? inner : -1;
+        }
+
+        if (c == '[') {
+            size_t start = pos++;
+            int list = node(CondOp::List, -1);
+            if (!matchSymbol("]")) {
+                int previous = -1;
+                do {
+                    int element = parseSum();
+                    if (element < 0) return -1;
+                    int arg = node(CondOp::Arg, element);
+                    if (previous < 0) (*nodes)[list].lhs = arg;
+                    else (*nodes)[previous].rhs = arg;
+                    previous = arg;
+                } while (matchSymbol(","));
+                if (!matchSymbol("]")) return -1;
             }
-        } else if (varType == "floating") {
-            if (!std::regex_match(trimmedValue, std::regex("^-?\\d+\\.\\d+$"))) {
-                setRedColor();
-                std::cerr << "Invalid floating value '" << trimmedValue << "' on line " << lineNum << ". Must contain decimal point." << std::endl;
-                resetColor();
-                return false;
+            for (int arg = (*nodes)[list].lhs; arg >= 0; arg = (*nodes)[arg].rhs) {
+                (*nodes)[list].calls = (*nodes)[list].calls || (*nodes)[arg].calls;
+                (*nodes)[list].arrays = (*nodes)[list].arrays || (*nodes)[arg].arrays;
+            }
+            (*nodes)[list].text = src.substr(start, pos - start);
+            return list;
+        }
+
+        if (c == '"') {
+            size_t close = src.find('"', pos + 1);
+            if (close == std::string::npos) return -1;
+            CondNode n;
+            n.op = CondOp::StringLit;
+            n.text = src.substr(pos + 1, close - pos - 1);
+            n.numericText = parseNumber(n.text, n.number) != NumberForm::None;
+            pos = close + 1;
+            return add(std::move(n));
+        }
+
+        if (std::isdigit(static_cast<unsigned char>(c))) {
+            size_t start = pos;
+            while (pos < src.length() && std::isdigit(static_cast<unsigned char>(src[pos]))) pos++;
+            bool isFloat = false;
+            if (pos + 1 < src.length() && src[pos] == '.' && std::isdigit(static_cast<unsigned char>(src[pos + 1]))) {
+                isFloat = true;
+                pos++;
+                while (pos < src.length() && std::isdigit(static_cast<unsigned char>(src[pos]))) pos++;
+            }
+            // Conditions have always accepted an exponent, as in `1e5`.
+            size_t digits = pos + 1 < src.length() && (src[pos + 1] == '+' || src[pos + 1] == '-') ? pos + 2 : pos + 1;
+            bool exponent = pos < src.length() && (src[pos] == 'e' || src[pos] == 'E') &&
+                            digits < src.length() && std::isdigit(static_cast<unsigned char>(src[digits]));
+            if (exponent) {
+                pos = digits;
+                while (pos < src.length() && std::isdigit(static_cast<unsigned char>(src[pos]))) pos++;
+            }
+            CondNode n;
+            n.op = isFloat || exponent ? CondOp::FloatLit : CondOp::IntLit;
+            n.text = src.substr(start, pos - start);
+            if (exponent) {
+                if (std::from_chars(n.text.data(), n.text.data() + n.text.length(), n.number).ec != std::errc()) return -1;
+            } else if (parseNumber(n.text, n.number) == NumberForm::None) {
+                return -1;
+            }
+            return add(std::move(n));
+        }
+
+        if (std::isalpha(static_cast<unsigned char>(c)) || c == '_') {
+            size_t start = pos;
+            while (pos < src.length() && isWordChar(src[pos])) pos++;
+            std::string word = src.substr(start, pos - start);
+            if (word == "and" || word == "or" || word == "not") return -1;
+            if (pos < src.length() && src[pos] == '(') {
+                return parseCall(std::move(word));
+            }
+            if (pos < src.length() && src[pos] == '[') {
+                pos++;
+                int index = parseSum();
+                if (index < 0 || !matchSymbol("]")) return -1;
+                int idx = node(CondOp::Index, index);
+                (*nodes)[idx].text = std::move(word);
+                return idx;
+            }
+            CondNode n;
+            if (word == "TRUE" || word == "FALSE") {
+                n.op = CondOp::BoolLit;
+                n.number = (word == "TRUE") ? 1 : 0;
+            } else {
+                n.op = CondOp::Slot;
+            }
+            n.text = std::move(word);
+            return add(std::move(n));
+        }
+
+        return -1;
+    }
+
+    int parseCall(std::string name) {
+        static const std::pair<const char*, CondOp> builtins[] = {
+            {"length", CondOp::Length}, {"sum", CondOp::Sum}, {"min", CondOp::Min},
+            {"max", CondOp::Max}, {"range", CondOp::Range}
+        };
+        for (const auto& builtin : builtins) {
+            if (name != builtin.first) continue;
+            size_t start = pos - name.length();
+            pos++;
+            int argument = parseSum();
+            if (argument < 0 || !matchSymbol(")")) return -1;
+            int idx = node(builtin.second, argument);
+            (*nodes)[idx].text = src.substr(start, pos - start);
+            return idx;
+        }
+        pos++;
+        CondNode n;
+        n.op = CondOp::Call;
+        n.calls = true;
+        n.text = std::move(name);
+        int call = add(std::move(n));
+        if (matchSymbol(")")) return call;
+        int previous = -1;
+        do {
+            int value = parseOr();
+            if (value < 0) return -1;
+            int arg = node(CondOp::Arg, value);
+            if (previous < 0) (*nodes)[call].lhs = arg;
+            else (*nodes)[previous].rhs = arg;
+            previous = arg;
+        } while (matchSymbol(","));
+        return matchSymbol(")") ? call : -1;
+    }
+};
+
+// Structural-character scanning, in the style of simdjson: the source is
+// classified in 64-byte blocks into one bitmap per interesting byte, so the
+// lexer and the comment stripper jump from one structural character to the
+// next instead of searching the text byte by byte.
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#define IORN_SCAN_X86 1
+#include <immintrin.h>
+#endif
+
+enum ScanClass {
+    ScanNewline, ScanQuote, ScanHash, ScanAt, ScanDollar,
+    ScanBracket, ScanSemicolon, ScanParen, ScanClassCount
+};
+
+enum class ScanMode { Auto, Scalar, Sse2, Avx2 };
+
+struct ScanBlock {
+    uint64_t bits[ScanClassCount];
+};
+
+static void classifyBlockScalar(const char* p, ScanBlock& out) {
+    for (uint64_t& word : out.bits) word = 0;
+    for (int i = 0; i < 64; i++) {
+        uint64_t bit = uint64_t(1) << i;
+        switch (p[i]) {
+            case '\n': out.bits[ScanNewline] |= bit; break;
+            case '"': out.bits[ScanQuote] |= bit; break;
+            case '#': out.bits[ScanHash] |= bit; break;
+            case '@': out.bits[ScanAt] |= bit; break;
+            case '$': out.bits[ScanDollar] |= bit; break;
+            case '[': out.bits[ScanBracket] |= bit; break;
+            case ';': out.bits[ScanSemicolon] |= bit; break;
+            case '(': case ')': out.bits[ScanParen] |= bit; break;
+            default: break;
+        }
+    }
+}
+
+#ifdef IORN_SCAN_X86
+__attribute__((target("sse2")))
+static inline uint64_t matchSse2(__m128i v, char c) {
+    return static_cast<uint16_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(v, _mm_set1_epi8(c))));
+}
+
+__attribute__((target("sse2")))
+static void classifyBlockSse2(const char* p, ScanBlock& out) {
+    for (uint64_t& word : out.bits) word = 0;
+    for (int chunk = 0; chunk < 4; chunk++) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + chunk * 16));
+        int shift = chunk * 16;
+        out.bits[ScanNewline] |= matchSse2(v, '\n') << shift;
+        out.bits[ScanQuote] |= matchSse2(v, '"') << shift;
+        out.bits[ScanHash] |= matchSse2(v, '#') << shift;
+        out.bits[ScanAt] |= matchSse2(v, '@') << shift;
+        out.bits[ScanDollar] |= matchSse2(v, '$') << shift;
+        out.bits[ScanBracket] |= matchSse2(v, '[') << shift;
+        out.bits[ScanSemicolon] |= matchSse2(v, ';') << shift;
+        out.bits[ScanParen] |= (matchSse2(v, '(') | matchSse2(v, ')')) << shift;
+    }
+}
+
+__attribute__((target("avx2")))
+static inline uint64_t matchAvx2(__m256i v, char c) {
+    return static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, _mm256_set1_epi8(c))));
+}
+
+__attribute__((target("avx2")))
+static void classifyBlockAvx2(const char* p, ScanBlock& out) {
+    for (uint64_t& word : out.bits) word = 0;
+    for (int chunk = 0; chunk < 2; chunk++) {
+        __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + chunk * 32));
+        int shift = chunk * 32;
+        out.bits[ScanNewline] |= matchAvx2(v, '\n') << shift;
+        out.bits[ScanQuote] |= matchAvx2(v, '"') << shift;
+        out.bits[ScanHash] |= matchAvx2(v, '#') << shift;
+        out.bits[ScanAt] |= matchAvx2(v, '@') << shift;
+        out.bits[ScanDollar] |= matchAvx2(v, '$') << shift;
+        out.bits[ScanBracket] |= matchAvx2(v, '[') << shift;
+        out.bits[ScanSemicolon] |= matchAvx2(v, ';') << shift;
+        out.bits[ScanParen] |= (matchAvx2(v, '(') | matchAvx2(v, ')')) << shift;
+    }
+}
+#endif
+
+static ScanMode detectScanMode() {
+#ifdef IORN_SCAN_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) return ScanMode::Avx2;
+    if (__builtin_cpu_supports("sse2")) return ScanMode::Sse2;
+#endif
+    return ScanMode::Scalar;
+}
+
+static const char* scanModeName(ScanMode mode) {
+    switch (mode) {
+        case ScanMode::Avx2: return "avx2";
+        case ScanMode::Sse2: return "sse2";
+        case ScanMode::Scalar: return "scalar";
+        default: return "auto";
+    }
+}
+
+class StructuralIndex {
+public:
+    static const size_t npos = static_cast<size_t>(-1);
+
+    StructuralIndex(std::string_view text, ScanMode mode = ScanMode::Auto) : length(text.length()) {
+        static const ScanMode detected = detectScanMode();
+        if (mode == ScanMode::Auto) mode = detected;
+
+        blocks.resize((length + 63) / 64);
+
+        char tail[64];
+        for (size_t b = 0; b < blocks.size(); b++) {
+            const char* p = text.data() + b * 64;
+            if (b * 64 + 64 > length) {
+                // Zero padding never matches a structural character.
+                std::fill(std::begin(tail), std::end(tail), '\0');
+                std::copy(p, text.data() + length, tail);
+                p = tail;
+            }
+            classify(mode, p, blocks[b]);
+        }
+    }
+
+    // Position of the first character of any class in `classes` (a bitmask of
+    // 1 << ScanClass) at or after `from`, or npos.
+    size_t next(unsigned classes, size_t from) const {
+        size_t b = from / 64;
+        if (b >= blocks.size()) return npos;
+        uint64_t word = combined(classes, b) & (~uint64_t(0) << (from % 64));
+        while (word == 0) {
+            if (++b >= blocks.size()) return npos;
+            word = combined(classes, b);
+        }
+        return b * 64 + static_cast<size_t>(__builtin_ctzll(word));
+    }
+
+    // One class needs no combining, which matters where it is called for
+    // every line or literal.
+    size_t next(ScanClass cls, size_t from) const {
+        size_t b = from / 64;
+        if (b >= blocks.size()) return npos;
+        uint64_t word = blocks[b].bits[cls] & (~uint64_t(0) << (from % 64));
+        while (word == 0) {
+            if (++b >= blocks.size()) return npos;
+            word = blocks[b].bits[cls];
+        }
+        return b * 64 + static_cast<size_t>(__builtin_ctzll(word));
+    }
+
+    size_t count(ScanClass cls) const {
+        size_t total = 0;
+        for (const ScanBlock& block : blocks) total += static_cast<size_t>(__builtin_popcountll(block.bits[cls]));
+        return total;
+    }
+
+private:
+    size_t length;
+    std::vector<ScanBlock> blocks;
+
+    uint64_t combined(unsigned classes, size_t b) const {
+        uint64_t word = 0;
+        for (unsigned rest = classes; rest != 0; rest &= rest - 1) {
+            word |= blocks[b].bits[__builtin_ctz(rest)];
+        }
+        return word;
+    }
+
+    static void classify(ScanMode mode, const char* p, ScanBlock& out) {
+#ifdef IORN_SCAN_X86
+        if (mode == ScanMode::Avx2) { classifyBlockAvx2(p, out); return; }
+        if (mode == ScanMode::Sse2) { classifyBlockSse2(p, out); return; }
+#endif
+        classifyBlockScalar(p, out);
+    }
+};
+
+// Splits text into lines the way repeated std::getline would: a trailing
+// newline does not produce an extra empty line.
+static std::vector<std::string_view> splitLines(std::string_view text, const StructuralIndex& index) {
+    std::vector<std::string_view> lines;
+    lines.reserve(index.count(ScanNewline) + 1);
+    size_t start = 0;
+    while (start < text.length()) {
+        size_t end = index.next(ScanNewline, start);
+        if (end == StructuralIndex::npos) end = text.length();
+        lines.push_back(text.substr(start, end - start));
+        start = end + 1;
+    }
+    return lines;
+}
+
+static std::vector<std::string_view> splitLines(std::string_view text) {
+    return splitLines(text, StructuralIndex(text));
+}
+
+// Multi-line comment state carried from one line to the next, so a single
+// edited line can be re-stripped without looking at the rest of the file.
+struct CommentState {
+    bool inBlock = false;  // inside """ ... """
+    int remLineDepth = 0;  // open parentheses of @remLine( ... )
+
+    bool operator==(const CommentState& other) const {
+        return inBlock == other.inBlock && remLineDepth == other.remLineDepth;
+    }
+    bool operator!=(const CommentState& other) const { return !(*this == other); }
+};
+
+// Removes the four comment styles in one left-to-right pass over the
+// structural index. Markers inside ordinary string literals are kept, and
+// newlines inside removed multi-line comments are kept so line numbers in
+// later diagnostics still match the source file. `code` is a whole script or
+// one line of it: a """ block or @remLine( still open at its end is left in
+// `state` for the next line, so a comment that is never closed runs to the
+// end of the script whichever way the script is read.
+static std::string stripComments(std::string_view code, CommentState& state, ScanMode mode = ScanMode::Auto) {
+    StructuralIndex index(code, mode);
+    std::string result;
+    result.reserve(code.length());
+    
+    const unsigned markers = (1u << ScanQuote) | (1u << ScanHash) | (1u << ScanAt);
+    // `pos` only moves forward, so the end of the current line is looked up
+    // once per line rather than once per string literal on it.
+    size_t stop = 0;
+    bool stopKnown = false;
+    auto lineEnd = [&](size_t from) {
+        if (!stopKnown || from > stop) {
+            stop = index.next(ScanNewline, from);
+            if (stop == StructuralIndex::npos) stop = code.length();
+            stopKnown = true;
+        }
+        return stop;
+    };
+    
+    size_t copied = 0;
+    size_t pos = 0;
+    while (true) {
+        if (state.inBlock || state.remLineDepth > 0) {
+            // Inside a multi-line comment that began at `copied`.
+            size_t end = code.length();
+            if (state.inBlock) {
+                size_t close = pos;
+                while ((close = index.next(ScanQuote, close)) != StructuralIndex::npos &&
+                       code.compare(close, 3, "\"\"\"") != 0) {
+                    close++;
+                }
+                if (close != StructuralIndex::npos) {
+                    state.inBlock = false;
+                    end = close + 3;
+                }
+            } else {
+                size_t p = pos;
+                while (state.remLineDepth > 0 && (p = index.next(ScanParen, p)) != StructuralIndex::npos) {
+                    state.remLineDepth += (code[p] == '(') ? 1 : -1;
+                    p++;
+                }
+                if (state.remLineDepth == 0) end = p;
+            }
+            for (size_t nl = index.next(ScanNewline, copied); nl != StructuralIndex::npos && nl < end;
+                 nl = index.next(ScanNewline, nl + 1)) {
+                result += '\n';
+            }
+            copied = pos = end;
+            if (state.inBlock || state.remLineDepth > 0) break;
+            continue;
+        }
+        
+        if ((pos = index.next(markers, pos)) == StructuralIndex::npos) break;
+        if (code[pos] == '@' && code.compare(pos, 9, "@remLine(") == 0) {
+            result.append(code.substr(copied, pos - copied));
+            copied = pos;
+            state.remLineDepth = 1;
+            pos += 9;
+        } else if ((code[pos] == '@' && code.compare(pos, 4, "@rem") == 0) ||
+                   (code[pos] == '#' && code.compare(pos, 2, "##") == 0)) {
+            result.append(code.substr(copied, pos - copied));
+            copied = pos = lineEnd(pos);
+        } else if (code[pos] == '"' && code.compare(pos, 3, "\"\"\"") == 0) {
+            result.append(code.substr(copied, pos - copied));
+            copied = pos;
+            state.inBlock = true;
+            pos += 3;
+        } else if (code[pos] == '"') {
+            // Ordinary string literal: skip to its closing quote on the same line.
+            size_t close = index.next(ScanQuote, pos + 1);
+            pos = (close != StructuralIndex::npos && close < lineEnd(pos)) ? close + 1 : pos + 1;
+        } else {
+            pos++;
+        }
+    }
+    result.append(code.substr(copied));
+    return result;
+}
+
+static std::string stripComments(std::string_view code, ScanMode mode = ScanMode::Auto) {
+    CommentState state;
+    return stripComments(code, state, mode);
+}
+
+// Keywords. Every spelling of every keyword word, English or Russian (UTF-8),
+// is an entry of one perfect hash table built at compile time, so a word is
+// recognised with one hash and one comparison whichever language it is in.
+// Multi-word keywords are put together from their words by scanKeywords().
+enum class Keyword : uint8_t {
+    None, NewVariable, RenameVariable, If, Then, ElseToIf, Resume, ElsePerform, Endif, Ignore, True, False,
+    NewFunction, Return, Endfunction,
+    // Words that are keywords only as part of one of the above.
+    New, Rename, Variable, Else, To, Perform, Function
+};
+
+struct KeywordSpelling {
+    std::string_view text;
+    Keyword keyword;
+};
+
+constexpr KeywordSpelling keywordSpellings[] = {
+    {"new", Keyword::New}, {"rename", Keyword::Rename}, {"variable", Keyword::Variable},
+    {"if", Keyword::If}, {"then", Keyword::Then}, {"else", Keyword::Else}, {"to", Keyword::To},
+    {"resume", Keyword::Resume}, {"perform", Keyword::Perform}, {"endif", Keyword::Endif},
+    {"ignore", Keyword::Ignore}, {"TRUE", Keyword::True}, {"FALSE", Keyword::False},
+    {"function", Keyword::Function}, {"return", Keyword::Return}, {"endfunction", Keyword::Endfunction},
+    {"новая", Keyword::New}, {"изменить", Keyword::Rename}, {"переменная", Keyword::Variable},
+    {"переменную", Keyword::Variable}, {"если", Keyword::If}, {"тогда", Keyword::Then},
+    {"иначе", Keyword::Else}, {"продолжить", Keyword::Resume}, {"выполнить", Keyword::Perform},
+    {"конецесли", Keyword::Endif}, {"пропустить", Keyword::Ignore}, {"ИСТИНА", Keyword::True},
+    {"ЛОЖЬ", Keyword::False}, {"функция", Keyword::Function}, {"вернуть", Keyword::Return},
+    {"конецфункции", Keyword::Endfunction}
+};
+
+// Spelling the rest of the front end works with.
+static std::string_view canonicalSpelling(Keyword keyword) {
+    switch (keyword) {
+        case Keyword::NewVariable: return "new variable";
+        case Keyword::RenameVariable: return "rename variable";
+        case Keyword::If: return "if";
+        case Keyword::Then: return "then";
+        case Keyword::ElseToIf: return "else to if";
+        case Keyword::Resume: return "resume";
+        case Keyword::ElsePerform: return "else perform";
+        case Keyword::Endif: return "endif";
+        case Keyword::Ignore: return "ignore";
+        case Keyword::True: return "TRUE";
+        case Keyword::False: return "FALSE";
+        case Keyword::NewFunction: return "new function";
+        case Keyword::Return: return "return";
+        case Keyword::Endfunction: return "endfunction";
+        default: return std::string_view();
+    }
+}
+
+constexpr size_t keywordTableBits = 6;
+
+// Mixes the length and four bytes. The second byte matters: every Cyrillic
+// letter starts with 0xD0 or 0xD1.
+constexpr size_t keywordSlot(std::string_view word, uint32_t seed) {
+    uint32_t h = seed;
+    h = (h ^ static_cast<uint32_t>(word.length())) * 16777619u;
+    h = (h ^ static_cast<unsigned char>(word[0])) * 16777619u;
+    h = (h ^ static_cast<unsigned char>(word[1])) * 16777619u;
+    h = (h ^ static_cast<unsigned char>(word[word.length() / 2])) * 16777619u;
+    h = (h ^ static_cast<unsigned char>(word[word.length() - 1])) * 16777619u;
+    h = (h ^ (h >> 15)) * 0x2c1b3c6du;
+    return h >> (32 - keywordTableBits);
+}
+
+// First seed for which no two spellings share a slot.
+constexpr uint32_t findKeywordSeed() {
+    for (uint32_t seed = 1; seed < 100000; seed++) {
+        bool used[size_t(1) << keywordTableBits] = {};
+        bool collision = false;
+        for (const KeywordSpelling& spelling : keywordSpellings) {
+            size_t slot = keywordSlot(spelling.text, seed);
+            collision = collision || used[slot];
+            used[slot] = true;
+        }
+        if (!collision) return seed;
+    }
+    return 0;
+}
+
+constexpr uint32_t keywordSeed = findKeywordSeed();
+static_assert(keywordSeed != 0, "no perfect hash seed for the keyword table");
+
+constexpr std::array<KeywordSpelling, size_t(1) << keywordTableBits> buildKeywordTable() {
+    std::array<KeywordSpelling, size_t(1) << keywordTableBits> table{};
+    for (const KeywordSpelling& spelling : keywordSpellings) {
+        table[keywordSlot(spelling.text, keywordSeed)] = spelling;
+    }
+    return table;
+}
+
+constexpr uint32_t buildKeywordLengths() {
+    uint32_t lengths = 0;
+    for (const KeywordSpelling& spelling : keywordSpellings) {
+        lengths |= uint32_t(1) << spelling.text.length();
+    }
+    return lengths;
+}
+
+constexpr auto keywordTable = buildKeywordTable();
+constexpr uint32_t keywordLengths = buildKeywordLengths();  // bit n set if some spelling is n bytes long
+
+// Bytes that make up words: ASCII letters, digits and '_', and every byte of
+// a UTF-8 multibyte sequence.
+constexpr std::array<bool, 256> buildWordBytes() {
+    std::array<bool, 256> bytes{};
+    for (int c = 0; c < 256; c++) {
+        bytes[c] = (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '_' || c >= 0x80;
+    }
+    return bytes;
+}
+
+constexpr auto wordBytes = buildWordBytes();
+
+static bool isWordByte(char c) {
+    return wordBytes[static_cast<unsigned char>(c)];
+}
+
+static Keyword lookupKeyword(std::string_view word) {
+    // Most identifiers are turned away by their length alone.
+    if (word.length() >= 32 || !((keywordLengths >> word.length()) & 1)) return Keyword::None;
+    const KeywordSpelling& slot = keywordTable[keywordSlot(word, keywordSeed)];
+    return slot.text == word ? slot.keyword : Keyword::None;
+}
+
+struct KeywordMatch {
+    Keyword keyword = Keyword::None;
+    size_t begin = std::string_view::npos;
+    size_t end = std::string_view::npos;
+
+    explicit operator bool() const {
+        return keyword != Keyword::None;
+    }
+};
+
+// The word starting at `pos` after spaces and tabs, or Keyword::None.
+static Keyword nextKeywordWord(std::string_view text, size_t& pos) {
+    size_t start = pos;
+    while (start < text.length() && (text[start] == ' ' || text[start] == '\t')) start++;
+    if (start == pos || start >= text.length() || !isWordByte(text[start])) return Keyword::None;
+    size_t end = start;
+    while (end < text.length() && isWordByte(text[end])) end++;
+    pos = end;
+    return lookupKeyword(text.substr(start, end - start));
+}
+
+// Calls `visit` with every keyword of `text` from `from` on, skipping string
+// literals, until it returns false. `from` must not be inside a word or a
+// literal.
+template <typename Visit>
+static void scanKeywords(std::string_view text, size_t from, Visit&& visit) {
+    size_t pos = from;
+    while (pos < text.length()) {
+        char c = text[pos];
+        if (c == '"') {
+            // A literal ends at its closing quote or, unterminated, at the end of its line.
+            size_t close = text.find('"', pos + 1);
+            size_t newline = text.find('\n', pos + 1);
+            pos = (close == std::string_view::npos || newline < close) ? std::min(newline, text.length()) : close + 1;
+            continue;
+        }
+        if (!isWordByte(c)) {
+            pos++;
+            continue;
+        }
+
+        size_t end = pos;
+        while (end < text.length() && isWordByte(text[end])) end++;
+        KeywordMatch match{lookupKeyword(text.substr(pos, end - pos)), pos, end};
+        size_t next = end;
+        switch (match.keyword) {
+            case Keyword::New:
+            case Keyword::Rename: {
+                Keyword second = nextKeywordWord(text, next);
+                match.keyword = (second == Keyword::Function && match.keyword == Keyword::New) ? Keyword::NewFunction
+                              : (second != Keyword::Variable) ? Keyword::None
+                              : (match.keyword == Keyword::New) ? Keyword::NewVariable : Keyword::RenameVariable;
+                break;
+            }
+            case Keyword::Else: {
+                Keyword second = nextKeywordWord(text, next);
+                if (second == Keyword::To) second = nextKeywordWord(text, next);
+                match.keyword = (second == Keyword::If) ? Keyword::ElseToIf
+                              : (second == Keyword::Perform) ? Keyword::ElsePerform : Keyword::None;
+                break;
+            }
+            case Keyword::Variable:
+            case Keyword::To:
+            case Keyword::Perform:
+            case Keyword::Function:
+                match.keyword = Keyword::None;
+                break;
+            default:
+                break;
+        }
+        if (match) {
+            match.end = next;
+            if (!visit(match)) return;
+            pos = next;
+        } else {
+            pos = end;
+        }
+    }
+}
+
+// First `keyword` at or after `from`; with a `follower`, only one followed by
+// that character (spaces and tabs in between), and `end` is past it.
+static KeywordMatch findKeyword(std::string_view text, Keyword keyword, size_t from = 0, char follower = 0) {
+    KeywordMatch found;
+    scanKeywords(text, from, [&](KeywordMatch match) {
+        if (match.keyword != keyword) return true;
+        if (follower != 0) {
+            size_t next = match.end;
+            while (next < text.length() && (text[next] == ' ' || text[next] == '\t')) next++;
+            if (next >= text.length() || text[next] != follower) return true;
+            match.end = next + 1;
+        }
+        found = match;
+        return false;
+    });
+    return found;
+}
+
+static KeywordMatch firstKeyword(std::string_view text) {
+    KeywordMatch found;
+    scanKeywords(text, 0, [&](const KeywordMatch& match) {
+        found = match;
+        return false;
+    });
+    return found;
+}
+
+// First non-ASCII byte at or after `from`, or the length of `text`.
+static size_t nextNonAscii(std::string_view text, size_t from) {
+    size_t i = from;
+    for (; i + 8 <= text.length(); i += 8) {
+        uint64_t block;
+        std::memcpy(&block, text.data() + i, 8);
+        if (block & 0x8080808080808080ull) break;
+    }
+    while (i < text.length() && !(static_cast<unsigned char>(text[i]) & 0x80)) i++;
+    return i;
+}
+
+// Rewrites keywords written in Russian to their English spelling, outside
+// string literals, so the rest of the front end only deals with one
+// language. Neither a keyword nor a literal runs past the end of a line, so
+// only lines holding a non-ASCII byte are scanned; false when nothing was
+// rewritten.
+static bool translateKeywords(std::string_view text, std::string& translated) {
+    bool rewritten = false;
+    size_t copied = 0;
+    size_t i = 0;
+    while ((i = nextNonAscii(text, i)) < text.length()) {
+        size_t begin = text.rfind('\n', i);
+        begin = (begin == std::string_view::npos) ? 0 : begin + 1;
+        size_t end = text.find('\n', i);
+        if (end == std::string_view::npos) end = text.length();
+        scanKeywords(text.substr(0, end), begin, [&](const KeywordMatch& match) {
+            std::string_view spelling = text.substr(match.begin, match.end - match.begin);
+            if (std::none_of(spelling.begin(), spelling.end(), [](char c) { return static_cast<unsigned char>(c) & 0x80; })) return true;
+            if (!rewritten) {
+                translated.clear();
+                translated.reserve(text.length());
+                rewritten = true;
+            }
+            translated.append(text, copied, match.begin - copied);
+            translated.append(canonicalSpelling(match.keyword));
+            copied = match.end;
+            return true;
+        });
+        i = end;
+    }
+    if (rewritten) translated.append(text, copied, std::string_view::npos);
+    return rewritten;
+}
+
+// Hand-written matchers for the statement forms. Each one accepts what the
+// regular expression in its comment accepts, without copying the text.
+static bool isWordChar(char c) {
+    return std::isalnum(static_cast<unsigned char>(c)) || c == '_';
+}
+
+static size_t skipSpaces(std::string_view text, size_t pos) {
+    while (pos < text.length() && std::isspace(static_cast<unsigned char>(text[pos]))) pos++;
+    return pos;
+}
+
+static size_t skipWord(std::string_view text, size_t pos) {
+    while (pos < text.length() && isWordChar(text[pos])) pos++;
+    return pos;
+}
+
+// \w+\s*\(
+static bool containsCall(std::string_view line) {
+    for (size_t open = line.find('('); open != std::string_view::npos; open = line.find('(', open + 1)) {
+        size_t p = open;
+        while (p > 0 && std::isspace(static_cast<unsigned char>(line[p - 1]))) p--;
+        if (p > 0 && isWordChar(line[p - 1])) return true;
+    }
+    return false;
+}
+
+// ^new variable\s+\w+\s+NULL;$
+static bool isNullDeclaration(std::string_view line) {
+    if (line.compare(0, 12, "new variable") != 0) return false;
+    size_t nameStart = skipSpaces(line, 12);
+    size_t nameEnd = skipWord(line, nameStart);
+    size_t next = skipSpaces(line, nameEnd);
+    return nameStart > 12 && nameEnd > nameStart && next > nameEnd && line.substr(next) == "NULL;";
+}
+
+// Front-end checks shared by the interpreter and the language server. Each
+// returns false and fills `message` when the check fails.
+static bool checkLineEnding(std::string_view line, int lineNum, std::string& message, int* column = nullptr) {
+    if (line.empty() || line.find("@rem") != std::string::npos || 
+        line.find("##") != std::string::npos || line.find("\"\"\"") != std::string::npos ||
+        line.find("@remLine") != std::string::npos) {
+        return true;
+    }
+    
+    bool isIfRelated = false;
+    bool isIgnore = false;
+    bool isDeclaration = false;
+    scanKeywords(line, 0, [&](const KeywordMatch& match) {
+        isIfRelated = isIfRelated || match.keyword == Keyword::If || match.keyword == Keyword::ElseToIf ||
+                      match.keyword == Keyword::ElsePerform || match.keyword == Keyword::Endif;
+        isIgnore = isIgnore || match.keyword == Keyword::Ignore;
+        isDeclaration = isDeclaration || match.keyword == Keyword::NewVariable || match.keyword == Keyword::RenameVariable ||
+                        match.keyword == Keyword::Return;
+        return true;
+    });
+    
+    if ((containsCall(line) || line.find("import ") != std::string::npos || isDeclaration) &&
+        !isNullDeclaration(line) && !isIfRelated && !isIgnore) {
+        
+        std::string_view trimmed = line.substr(0, line.find_last_not_of(" \t\r\n") + 1);
+        
+        if (!trimmed.empty() && trimmed.back() != ';' && trimmed.back() != ':') {
+            message = "There is no ending on " + std::to_string(lineNum) +
+                      " page " + std::to_string(trimmed.length() + 1) + " character!";
+            if (column) *column = static_cast<int>(trimmed.length()) + 1;
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool checkVariableName(std::string_view varName, int lineNum, std::string& message) {
+    if (varName.empty() || !std::isalpha(static_cast<unsigned char>(varName[0]))) {
+        message = "Variable name '" + std::string(varName) + "' is invalid on line " + std::to_string(lineNum) + ". Must start with a letter.";
+        return false;
+    }
+    return true;
+}
+
+static std::string_view trimSpaces(std::string_view text) {
+    size_t first = text.find_first_not_of(" \t");
+    if (first == std::string_view::npos) return std::string_view();
+    return text.substr(first, text.find_last_not_of(" \t") - first + 1);
+}
+
+// True for an initialiser such as `15 * 3` or `x + 1`; a plain number is a
+// literal, not an expression.
+static bool isArithmeticExpression(std::string_view text) {
+    double number;
+    if (parseNumber(text, number) != NumberForm::None) return false;
+    std::string source(text);
+    CompiledCondition compiled;
+    return ConditionCompiler(source).compileExpression(compiled);
+}
+
+// True for a value that is one call of a user-defined function, such as
+// `greet("Bob")`.
+static bool isFunctionCall(std::string_view text) {
+    std::string source(text);
+    CompiledCondition compiled;
+    if (!ConditionCompiler(source).compileValue(compiled)) return false;
+    const CondNode& root = compiled.nodes[compiled.root];
+    return root.op == CondOp::Call && root.text != "input" && root.text != "Print";
+}
+
+// Whether formatNumber() can write `value`.
+static bool isRepresentable(double value, bool integer) {
+    return std::isfinite(value) && (!integer || std::fabs(value) < 9.2e18);
+}
+
+// Text of a computed numeric or floating value: numeric values are
+// truncated, floating values use the shortest fixed-point form that reads
+// back the same and keep a decimal point, so parseNumber() accepts every
+// value written here (1e20 is 100000000000000000000.0). False for infinity,
+// NaN and integers out of range.
+static bool formatNumber(double value, bool integer, std::string& text) {
+    if (!isRepresentable(value, integer)) return false;
+    char buffer[400];                  // DBL_MAX has 309 digits, DBL_TRUE_MIN 325 after the point
+    if (integer) {
+        auto result = std::to_chars(buffer, buffer + sizeof(buffer), static_cast<long long>(value));
+        text.assign(buffer, result.ptr);
+        return true;
+    }
+    auto result = std::to_chars(buffer, buffer + sizeof(buffer), value, std::chars_format::fixed);
+    text.assign(buffer, result.ptr);
+    if (text.find('.') == std::string::npos) text += ".0";
+    return true;
+}
+
+// A scalar computed from array elements. Numeric elements can be past the
+// 2^53 a double holds exactly, so a whole value is also kept in 64 bits.
+struct ExactNumber {
+    double real = 0;
+    long long integer = 0;
+    bool whole = false;                // `integer` holds the value
+};
+
+static ExactNumber exactNumber(double value) {
+    return {value, 0, false};
+}
+
+static ExactNumber exactNumber(long long value) {
+    return {static_cast<double>(value), value, true};
+}
+
+// parseNumber() that also reads an integer in 64 bits where it fits.
+static NumberForm parseExact(std::string_view text, ExactNumber& out) {
+    NumberForm form = parseNumber(text, out.real);
+    out.whole = form == NumberForm::Integer && isRepresentable(out.real, true) &&
+                std::from_chars(text.data(), text.data() + text.length(), out.integer).ec == std::errc();
+    return form;
+}
+
+// Elements of a `numeric[]` or `floating[]` variable, stored contiguously as
+// native numbers. Only the vector of the element type is used.
+struct NumberArray {
+    bool integer = true;
+    std::vector<long long> integers;
+    std::vector<double> reals;
+
+    size_t size() const {
+        return integer ? integers.size() : reals.size();
+    }
+
+    double at(size_t i) const {
+        return integer ? static_cast<double>(integers[i]) : reals[i];
+    }
+
+    // Switches to floating elements, converting those held so far.
+    void toReals() {
+        if (!integer) return;
+        reals.assign(integers.begin(), integers.end());
+        integers.clear();
+        integers.shrink_to_fit();
+        integer = false;
+    }
+};
+
+static bool isLiteralNode(const CondNode& node) {
+    return node.op == CondOp::IntLit || node.op == CondOp::FloatLit || node.op == CondOp::StringLit || node.op == CondOp::BoolLit;
+}
+
+static bool isArrayType(std::string_view type) {
+    return type == "numeric[]" || type == "floating[]";
+}
+
+static bool isArrayBuiltin(std::string_view name) {
+    return name == "length" || name == "sum" || name == "min" || name == "max" || name == "range";
+}
+
+// Folds `data` with eight independent accumulators, so no element waits for
+// the previous one and the loop vectorises.
+template <typename Lane, typename Element, typename Combine>
+static Lane reduceLanes(const Element* data, size_t count, Lane initial, Combine combine) {
+    Lane lanes[8];
+    std::fill(std::begin(lanes), std::end(lanes), initial);
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        for (size_t k = 0; k < 8; k++) lanes[k] = combine(lanes[k], data[i + k]);
+    }
+    for (; i < count; i++) lanes[0] = combine(lanes[0], data[i]);
+    Lane result = initial;
+    for (Lane lane : lanes) result = combine(result, lane);
+    return result;
+}
+
+// Calls `visit` with an accessor for the elements of `array`, or for
+// `scalar` at every index when there is no array.
+template <typename Visit>
+static auto visitElements(const NumberArray* array, double scalar, Visit visit) {
+    if (array == nullptr) return visit([scalar](size_t) { return scalar; });
+    if (array->integer) return visit([data = array->integers.data()](size_t i) { return data[i]; });
+    return visit([data = array->reals.data()](size_t i) { return data[i]; });
+}
+
+// The same for integer operands: a numeric array or a whole number.
+template <typename Visit>
+static auto visitIntegers(const NumberArray* array, long long scalar, Visit visit) {
+    if (array == nullptr) return visit([scalar](size_t) { return scalar; });
+    return visit([data = array->integers.data()](size_t i) { return data[i]; });
+}
+
+// out[i] = left(i) <op> right(i). Each operator gets a loop of its own,
+// simple enough to vectorise; a division by zero gives 0, as it does for
+// single values. `out` may be the storage of either operand.
+template <typename Left, typename Right>
+static void combineReals(CondOp op, double* out, size_t count, Left left, Right right) {
+    auto each = [&](auto apply) {
+        for (size_t i = 0; i < count; i++) out[i] = apply(left(i), right(i));
+    };
+    switch (op) {
+        case CondOp::Add: each([](double a, double b) { return a + b; }); break;
+        case CondOp::Sub: each([](double a, double b) { return a - b; }); break;
+        case CondOp::Mul: each([](double a, double b) { return a * b; }); break;
+        case CondOp::Div: each([](double a, double b) { return b != 0 ? a / b : 0; }); break;
+        case CondOp::Mod: each([](double a, double b) { return std::fmod(a, b); }); break;
+        default: each([](double a, double b) { return std::pow(a, b); }); break;
+    }
+}
+
+// out[i] = left(i) <op> right(i) for +, -, * and % on integers, exact
+// beyond the 2^53 a double holds. A first pass estimates every result in
+// floating point; if one leaves the range isRepresentable() allows, or a
+// remainder divides by zero, nothing is written and false is returned, so
+// the caller can compute in floating point instead.
+template <typename Left, typename Right>
+static bool combineIntegers(CondOp op, long long* out, size_t count, Left left, Right right) {
+    bool exact = true;
+    auto check = [&](auto fits) {
+        for (size_t i = 0; i < count; i++) exact &= fits(static_cast<double>(left(i)), static_cast<double>(right(i)));
+        return exact;
+    };
+    auto each = [&](auto apply) {
+        for (size_t i = 0; i < count; i++) out[i] = apply(left(i), right(i));
+    };
+    switch (op) {
+        case CondOp::Add:
+            if (!check([](double a, double b) { return isRepresentable(a + b, true); })) return false;
+            each([](long long a, long long b) { return a + b; });
+            return true;
+        case CondOp::Sub:
+            if (!check([](double a, double b) { return isRepresentable(a - b, true); })) return false;
+            each([](long long a, long long b) { return a - b; });
+            return true;
+        case CondOp::Mul:
+            if (!check([](double a, double b) { return isRepresentable(a * b, true); })) return false;
+            each([](long long a, long long b) { return a * b; });
+            return true;
+        case CondOp::Mod:
+            if (!check([](double, double b) { return b != 0; })) return false;
+            each([](long long a, long long b) { return a % b; });
+            return true;
+        default:
+            return false;
+    }
+}
+
+// `[1, 2, 3]`, as an array is printed.
+static void formatArray(const NumberArray& array, std::string& text) {
+    std::string element;
+    char buffer[24];
+    text = "[";
+    for (size_t i = 0; i < array.size(); i++) {
+        if (i > 0) text += ", ";
+        if (array.integer) {
+            text.append(buffer, std::to_chars(buffer, buffer + sizeof(buffer), array.integers[i]).ptr);
+        } else {
+            formatNumber(array.reals[i], false, element);
+            text += element;
+        }
+    }
+    text += "]";
+}
+
+static bool checkVariableValue(std::string_view varType, std::string_view varValue, int lineNum, std::string& message) {
+    std::string_view trimmedValue = trimSpaces(varValue);
+    double number;
+    
+    // What a function returns is checked when it returns.
+    if (trimmedValue.find('(') != std::string_view::npos && isFunctionCall(trimmedValue)) {
+        return true;
+    }
+    if (isArrayType(varType)) {
+        std::string source(trimmedValue);
+        CompiledCondition compiled;
+        if (!ConditionCompiler(source).compileValue(compiled) || isLiteralNode(compiled.nodes[compiled.root])) {
+            message = "Invalid array value '" + source + "' on line " + std::to_string(lineNum) + ".";
+            return false;
+        }
+    } else if (varType == "string") {
+        if (trimmedValue.length() < 2 || trimmedValue.front() != '"' || trimmedValue.back() != '"') {
+            message = "String value must be enclosed in quotes on line " + std::to_string(lineNum) + ".";
+            return false;
+        }
+    } else if (varType == "numeric") {
+        if (parseNumber(trimmedValue, number) != NumberForm::Integer && !isArithmeticExpression(trimmedValue)) {
+            message = "Invalid numeric value '" + std::string(trimmedValue) + "' on line " + std::to_string(lineNum) + ".";
+            return false;
+        }
+    } else if (varType == "floating") {
+        if (parseNumber(trimmedValue, number) != NumberForm::Decimal && !isArithmeticExpression(trimmedValue)) {
+            message = "Invalid floating value '" + std::string(trimmedValue) + "' on line " + std::to_string(lineNum) + ". Must contain decimal point.";
+            return false;
+        }
+    } else if (varType == "boolean") {
+        if (trimmedValue != "TRUE" && trimmedValue != "FALSE") {
+            message = "Boolean value must be TRUE or FALSE on line " + std::to_string(lineNum) + ".";
+            return false;
+        }
+    }
+    return true;
+}
+
+// Parsed form of one statement, or of a whole if-block. Statements are cached
+// by their source text, so running an edited script again only parses the
+// statements whose text changed. Statements, their containers and the text
+// they point into are allocated in the interpreter's program arena and are
+// never destroyed one by one.
+enum class StmtKind { None, Import, Declare, DeclareNull, Rename, Print, If, InvalidIf, Function, InvalidFunction, Return, Call };
+
+// Literal text or a variable reference, used for Print output and for string
+// concatenation. The text points into the statement's source.
+struct TextPart {
+    bool isVariable;
+    std::string_view text;         // literal text or variable name
+    int local = -1;                // frame slot, for a variable local to a function
+};
+
+struct Parameter {
+    std::string_view name;
+    std::string_view type;
+};
+
+// Splits the text of a Print argument into literal and `$[name]` parts.
+static void parsePrintText(std::string_view text, std::pmr::vector<TextPart>& parts) {
+    bool interpolated = text.length() > 2 && text.compare(0, 2, "f\"") == 0;
+    std::string_view body = interpolated ? text.substr(2, text.length() - 3) : text.substr(1, text.length() - 2);
+    if (!interpolated) {
+        parts.push_back({false, body});
+        return;
+    }
+
+    // Text that is not a well-formed `$[name]` stays literal, so a literal
+    // part always runs from `literal` up to the next reference.
+    size_t pos = 0;
+    size_t literal = 0;
+    while (pos < body.length()) {
+        size_t open = body.find("$[", pos);
+        if (open == std::string_view::npos) break;
+        size_t nameEnd = open + 2;
+        while (nameEnd < body.length() && (std::isalnum(static_cast<unsigned char>(body[nameEnd])) || body[nameEnd] == '_')) {
+            nameEnd++;
+        }
+        if (nameEnd == open + 2 || nameEnd >= body.length() || body[nameEnd] != ']') {
+            pos = nameEnd;
+            continue;
+        }
+        if (open > literal) parts.push_back({false, body.substr(literal, open - literal)});
+        parts.push_back({true, body.substr(open + 2, nameEnd - open - 2)});
+        pos = literal = nameEnd + 1;
+    }
+    if (literal < body.length()) parts.push_back({false, body.substr(literal)});
+}
+
+static bool isIdentifier(std::string_view text) {
+    return !text.empty() && (std::isalpha(static_cast<unsigned char>(text[0])) || text[0] == '_') &&
+           std::all_of(text.begin(), text.end(), [](char c) { return std::isalnum(static_cast<unsigned char>(c)) || c == '_'; });
+}
+
+// Splits `a + "text" + b` at the '+' signs outside string literals. A lone
+// variable name counts as a one-part concatenation (a copy). Returns false
+// when the value is neither; `valid` is false when one of the operands is
+// not a string literal, a number or a variable name.
+static bool splitConcatenation(std::string_view value, std::pmr::vector<TextPart>& parts, bool& valid) {
+    parts.clear();
+    valid = true;
+    size_t start = 0;
+    size_t operands = 0;
+    bool inString = false;
+    for (size_t i = 0; i <= value.length(); i++) {
+        if (i < value.length() && value[i] == '"') inString = !inString;
+        if (i < value.length() && (inString || value[i] != '+')) continue;
+
+        std::string_view operand = trimSpaces(value.substr(start, i - start));
+        double number;
+        operands++;
+        start = i + 1;
+        if (operand.length() >= 2 && operand.front() == '"' && operand.back() == '"') {
+            parts.push_back({false, operand.substr(1, operand.length() - 2)});
+        } else if (isIdentifier(operand)) {
+            parts.push_back({true, operand});
+        } else if (parseNumber(operand, number) != NumberForm::None) {
+            parts.push_back({false, operand});
+        } else {
+            valid = false;
+        }
+    }
+    if (operands < 2 && (parts.empty() || !parts[0].isVariable)) {
+        parts.clear();
+        valid = true;
+        return false;
+    }
+    return true;
+}
+
+struct Statement;
+
+// Both are allocator-aware, so a statement copied into another arena takes
+// its branches and their bodies along.
+struct Branch {
+    using allocator_type = std::pmr::polymorphic_allocator<std::byte>;
+    explicit Branch(const allocator_type& arena) : body(arena) {}
+    Branch(const Branch& other, const allocator_type& arena);
+    Branch(Branch&& other, const allocator_type& arena);
+    Branch(const Branch&) = default;
+    Branch(Branch&&) = default;
+    Branch& operator=(const Branch&) = default;
+    Branch& operator=(Branch&&) = default;
+    CompiledCondition* condition = nullptr;  // null for "else perform:"
+    std::string_view conditionText;
+    std::pmr::vector<Statement> body;
+};
+
+struct Statement {
+    using allocator_type = std::pmr::polymorphic_allocator<std::byte>;
+    explicit Statement(const allocator_type& arena)
+        : parts(arena), concat(arena), branches(arena), imports(arena), parameters(arena), calls(arena) {}
+    // Assignment keeps this statement's allocator for every container.
+    Statement(const Statement& other, const allocator_type& arena) : Statement(arena) { *this = other; }
+    Statement(Statement&& other, const allocator_type& arena) : Statement(arena) { *this = std::move(other); }
+    Statement(const Statement&) = default;
+    Statement(Statement&&) = default;
+    Statement& operator=(const Statement&) = default;
+    Statement& operator=(Statement&&) = default;
+    StmtKind kind = StmtKind::None;
+    std::string_view name;              // Declare, DeclareNull, Rename; function name for Function and Call
+    std::string_view type;              // also the return type of a Function, empty if it returns nothing
+    std::string_view value;             // initialiser as written; `name(parameters)` of a Function
+    std::string_view literal;           // value without spaces and string quotes; value of a Return
+    int local = -1;                     // frame slot of a variable local to a function
+    CompiledCondition* expression = nullptr;  // arithmetic initialiser, function call, array or returned value
+    CompiledCondition* index = nullptr;       // element of a Rename of `name[index]`
+    bool validValue = false;            // literal passes checkVariableValue or was computed by the optimiser
+    bool isInput = false;
+    std::string_view prompt;            // input() prompt without quotes
+    std::pmr::vector<TextPart> parts;   // Print output
+    std::pmr::vector<TextPart> concat;  // string initialiser built with '+'
+    bool invalidValue = false;
+    std::pmr::vector<Branch> branches;  // If
+    bool importsPrint = false;
+    bool importsInput = false;
+    std::pmr::vector<std::string_view> imports;  // module paths outside terminal
+    std::pmr::vector<Parameter> parameters;      // Function
+    bool usesInput = false;
+    std::pmr::vector<std::string_view> calls;    // functions called other than Print and input
+};
+
+inline Branch::Branch(const Branch& other, const allocator_type& arena)
+    : condition(other.condition), conditionText(other.conditionText), body(other.body, arena) {}
+
+inline Branch::Branch(Branch&& other, const allocator_type& arena)
+    : condition(other.condition), conditionText(other.conditionText), body(std::move(other.body), arena) {}
+
+// True for the first line of an if-block: its first keyword is `if (`.
+// Lines that print or import are dispatched as such.
+static bool startsIfBlock(std::string_view line) {
+    KeywordMatch first = firstKeyword(line);
+    return first.keyword == Keyword::If && findKeyword(line, Keyword::If, first.begin, '(') &&
+           line.find("import ") == std::string::npos && line.find("Print(") == std::string::npos;
+}
+
+// True for the line that closes an if-block.
+static bool endsIfBlock(std::string_view line) {
+    return static_cast<bool>(findKeyword(line, Keyword::Endif, 0, ';'));
+}
+
+// True for the line that closes a function.
+static bool endsFunction(std::string_view line) {
+    return static_cast<bool>(findKeyword(line, Keyword::Endfunction, 0, ';'));
+}
+
+// How the last run ended. Runs stopped by a limit exit with their own code.
+enum class RunStatus { Completed, MemoryLimit, StepLimit, Timeout, InputLimit };
+
+static int exitStatus(RunStatus status) {
+    switch (status) {
+        case RunStatus::MemoryLimit: return 3;
+        case RunStatus::StepLimit: return 4;
+        case RunStatus::Timeout: return 5;
+        case RunStatus::InputLimit: return 6;
+        default: return 0;
+    }
+}
+
+// Hardware and kernel counters behind `--stats=cpu`, read with
+// perf_event_open on Linux. All counters are opened as one group, so one
+// read() gives all of them at the same instant. A counter the kernel or the
+// machine does not offer (containers and virtual machines often have no
+// hardware counters) is left out of the group and reported as unavailable.
+enum class CpuCounter : uint8_t { Cycles, Instructions, BranchMisses, CacheMisses, PageFaults, Count };
+static constexpr size_t cpuCounterCount = static_cast<size_t>(CpuCounter::Count);
+
+// Parts of a run that `--stats=cpu` reports apart. A streamed script reads,
+// checks and parses a line at a time, so its front end is one phase.
+enum class RunPhase : uint8_t { Load, Preprocess, SyntaxCheck, Parse, FrontEnd, Execute, Count };
+static constexpr size_t runPhaseCount = static_cast<size_t>(RunPhase::Count);
+
+struct CpuSample {
+    std::array<uint64_t, cpuCounterCount> counts{};
+    bool measured = false;
+};
+
+class CpuCounters {
+public:
+    static constexpr const char* names[cpuCounterCount] = {
+        "cycles", "instructions", "branch-misses", "cache-misses", "page-faults"
+    };
+    
+    CpuCounters() {
+        position.fill(-1);
+#ifdef __linux__
+        static const std::pair<uint32_t, uint64_t> events[cpuCounterCount] = {
+            {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+            {PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+            {PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES},
+            {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES},
+            {PERF_TYPE_SOFTWARE, PERF_COUNT_SW_PAGE_FAULTS}
+        };
+        for (size_t i = 0; i < cpuCounterCount; i++) {
+            perf_event_attr attr;
+            std::memset(&attr, 0, sizeof(attr));
+            attr.size = sizeof(attr);
+            attr.type = events[i].first;
+            attr.config = events[i].second;
+            attr.read_format = PERF_FORMAT_GROUP;
+            // User space only, which unprivileged processes may count.
+            attr.exclude_kernel = 1;
+            attr.exclude_hv = 1;
+            int fd = static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, leader, 0));
+            if (fd < 0) {
+                if (error.empty()) {
+                    error = std::string("perf_event_open: ") + std::strerror(errno);
+                    if (errno == EACCES || errno == EPERM) error += ", see /proc/sys/kernel/perf_event_paranoid";
+                }
+                continue;
+            }
+            if (leader < 0) leader = fd;
+            position[i] = static_cast<int>(fds.size());
+            fds.push_back(fd);
+        }
+#else
+        error = "not supported on this platform";
+#endif
+    }
+    
+    ~CpuCounters() {
+#ifdef __linux__
+        for (int fd : fds) close(fd);
+#endif
+    }
+    
+    CpuCounters(const CpuCounters&) = delete;
+    CpuCounters& operator=(const CpuCounters&) = delete;
+    
+    bool available() const { return !fds.empty(); }
+    bool has(CpuCounter counter) const { return position[static_cast<size_t>(counter)] >= 0; }
+    const std::string& failure() const { return error; }
+    
+    // Totals since the counters were opened; zero for counters not available.
+    std::array<uint64_t, cpuCounterCount> read() const {
+        std::array<uint64_t, cpuCounterCount> totals{};
+#ifdef __linux__
+        uint64_t buffer[1 + cpuCounterCount];
+        if (leader < 0 || ::read(leader, buffer, sizeof(buffer)) < static_cast<ssize_t>(sizeof(uint64_t))) return totals;
+        for (size_t i = 0; i < cpuCounterCount; i++) {
+            if (position[i] >= 0 && static_cast<uint64_t>(position[i]) < buffer[0]) totals[i] = buffer[1 + position[i]];
+        }
+#endif
+        return totals;
+    }
+    
+private:
+    std::vector<int> fds;
+    int leader = -1;
+    std::array<int, cpuCounterCount> position;   // index in the group's read buffer, -1 if not open
+    std::string error;                           // why the first counter that failed could not be opened
+};
+
+// Timings, cache figures and memory use of the last interpret() call.
+struct RunStats {
+    RunStatus status = RunStatus::Completed;
+    int abortLine = 0;                 // statement that went over a limit, 0 while loading
+    size_t statements = 0;
+    size_t parsedStatements = 0;
+    double frontEndMs = 0;
+    double executeMs = 0;
+    size_t frontEndAllocations = 0;
+    size_t executeAllocations = 0;
+    size_t frontEndAllocatedBytes = 0;
+    size_t executeAllocatedBytes = 0;
+    size_t programArenaBytes = 0;
+    size_t runArenaBytes = 0;
+    size_t memoryPeak = 0;
+    size_t memoryCurrent = 0;
+    size_t programMemory = 0;          // bytes held by parsed program data
+    size_t variableMemory = 0;         // bytes held by what execution left behind
+    size_t executedStatements = 0;     // including those in if blocks, functions and modules
+    std::array<CpuSample, runPhaseCount> cpu{};  // --stats=cpu
+};
+
+// Command-line switches that change how scripts are run or reported.
+struct InterpreterOptions {
+    bool allocStats = false;       // --stats=alloc
+    bool optReport = false;        // --opt-report
+    bool memStats = false;         // --stats=mem
+    bool cpuStats = false;         // --stats=cpu
+    size_t maxMemory = 0;          // --max-memory, 0 for no limit
+    size_t maxSteps = 0;           // --max-steps, 0 for no limit
+    size_t timeoutMs = 0;          // --timeout, 0 for no limit
+    size_t maxInputs = 0;          // --max-inputs, 0 for no limit
+    bool cachePrograms = false;    // keep whole programs by source, for --serve
+};
+
+// Longest line input() accepts; a longer one ends the run like the end of input.
+static constexpr size_t maxInputLineLength = 16 << 20;
+
+// Limits of one run behind `--max-steps`, `--timeout` and `--max-inputs`.
+// Like the memory account, the budget of the run in progress belongs to the
+// thread, so statements of imported modules are charged to it as well. It is
+// checked at safe points only: before every statement and before and while
+// reading input. A budget also ends the run when input runs out.
+class ExecutionBudget {
+public:
+    explicit ExecutionBudget(const InterpreterOptions& options)
+        : maxSteps(options.maxSteps ? options.maxSteps : SIZE_MAX),
+          maxInputs(options.maxInputs ? options.maxInputs : SIZE_MAX),
+          timeoutMs(options.timeoutMs), saved(active) {
+        if (timeoutMs) deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeoutMs);
+        active = this;
+    }
+    ~ExecutionBudget() { active = saved; }
+    ExecutionBudget(const ExecutionBudget&) = delete;
+    ExecutionBudget& operator=(const ExecutionBudget&) = delete;
+    
+    static ExecutionBudget* current() { return active; }
+    
+    // One statement. The clock is read every 64 statements only.
+    bool step() {
+        if (stopped != RunStatus::Completed) return false;
+        if (++steps > maxSteps) return stop(RunStatus::StepLimit);
+        if (timeoutMs && (steps & 63) == 0 && std::chrono::steady_clock::now() >= deadline) return stop(RunStatus::Timeout);
+        return true;
+    }
+    
+    // One attempt to read a line of input, counting prompts repeated after
+    // invalid data.
+    bool read() {
+        if (stopped != RunStatus::Completed) return false;
+        if (++inputs > maxInputs) return stop(RunStatus::InputLimit);
+        if (timeoutMs && std::chrono::steady_clock::now() >= deadline) return stop(RunStatus::Timeout);
+        return true;
+    }
+    
+    // Milliseconds a read may still wait, -1 for no limit.
+    int remainingMs() const {
+        if (!timeoutMs) return -1;
+        auto left = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now()).count();
+        return static_cast<int>(std::clamp<long long>(left, 0, INT_MAX));
+    }
+    
+    bool stop(RunStatus status) {
+        if (stopped == RunStatus::Completed) stopped = status;
+        return false;
+    }
+    
+    bool exhausted() const { return stopped != RunStatus::Completed; }
+    
+    const size_t maxSteps;
+    const size_t maxInputs;
+    const size_t timeoutMs;
+    size_t steps = 0;
+    size_t inputs = 0;
+    bool inputEnded = false;           // stopped because input ran out
+    bool lineTooLong = false;          // stopped by a line of input over the length limit
+    RunStatus stopped = RunStatus::Completed;
+    
+private:
+    std::chrono::steady_clock::time_point deadline;
+    ExecutionBudget* saved;
+    static inline thread_local ExecutionBudget* active = nullptr;
+};
+
+#ifndef _WIN32
+// Script input, read straight from the file descriptor so that waiting for a
+// line can give up at the run's deadline; std::cin would read ahead of what
+// poll() sees.
+class InputReader {
+public:
+    enum class Result { Line, End, TimedOut, TooLong };
+    
+    explicit InputReader(int fd) : fd(fd) {}
+    // Input given up front, as `iorn --serve` requests carry it.
+    explicit InputReader(std::string text) : fd(-1), buffer(std::move(text)), ended(true) {}
+    
+    Result readLine(std::string& line, const ExecutionBudget& budget) {
+        while (true) {
+            size_t newline = buffer.find('\n', scanned);
+            if (newline != std::string::npos) {
+                line.assign(buffer, 0, newline);
+                buffer.erase(0, newline + 1);
+                scanned = 0;
+                return Result::Line;
+            }
+            scanned = buffer.length();
+            if (scanned > maxInputLineLength) return Result::TooLong;
+            if (ended) {
+                if (buffer.empty()) return Result::End;
+                line.swap(buffer);
+                buffer.clear();
+                scanned = 0;
+                return Result::Line;
+            }
+            
+            int waitMs = budget.remainingMs();
+            if (waitMs >= 0) {
+                pollfd ready{fd, POLLIN, 0};
+                int count = poll(&ready, 1, waitMs);
+                if (count < 0 && errno == EINTR) continue;
+                if (count == 0) return Result::TimedOut;
+            }
+            char chunk[4096];
+            ssize_t length = ::read(fd, chunk, sizeof(chunk));
+            if (length < 0 && errno == EINTR) continue;
+            if (length <= 0) {
+                ended = true;
+            } else {
+                buffer.append(chunk, static_cast<size_t>(length));
+            }
+            // Input that never pauses would never let poll() time out.
+            if (budget.remainingMs() == 0) return Result::TimedOut;
+        }
+    }
+    
+private:
+    int fd;
+    std::string buffer;
+    size_t scanned = 0;                // bytes of buffer known to hold no newline
+    bool ended = false;
+};
+
+static InputReader standardInput(STDIN_FILENO);
+#endif
+
+// Where a run's output goes and its input comes from. They belong to the
+// thread, so each worker of `iorn --serve` talks to its own client.
+static thread_local std::ostream* scriptOut = &std::cout;
+static thread_local std::ostream* scriptErr = &std::cerr;
+#ifndef _WIN32
+static thread_local InputReader* scriptInput = &standardInput;
+#endif
+
+struct ProgramEntry {
+    int line;
+    const Statement* statement;
+    const Branch* branch = nullptr;     // the one branch of an if that the optimiser knows will run
+};
+
+struct ImportEntry {
+    int line;
+    std::string_view path;              // e.g. "mylib.*" or "mylib.greeting"
+};
+
+// A function defined with `new function`. Its frame holds the parameters
+// followed by the variables its body declares; the body's statements are
+// copies that address them by slot.
+struct Function {
+    std::string_view name;
+    std::string_view signature;         // `name(parameters)` as written
+    std::string_view returnType;        // empty if it returns nothing
+    std::vector<Parameter> parameters;
+    size_t frameSize = 0;
+    std::vector<ProgramEntry> body;
+    int line = 0;
+};
+
+// A parameter or local variable in the frame of a running function. Numbers
+// stay numbers while the function runs; their text is only written when it
+// is needed, e.g. to print it.
+struct FrameSlot {
+    Value text;
+    double number = 0;
+    bool isNumber = false;
+    bool integer = false;
+
+    void setNumber(double value, bool isInteger) {
+        number = value;
+        integer = isInteger;
+        isNumber = true;
+        text = Value();
+    }
+
+    void setText(Value value) {
+        text = std::move(value);
+        isNumber = false;
+    }
+
+    const Value& value() {
+        if (isNumber && text.view().empty()) {
+            std::string formatted;
+            formatNumber(number, integer, formatted);
+            text = Value(std::move(formatted));
+        }
+        return text;
+    }
+};
+
+// The functions of a program, with the rewritten statements and conditions
+// of their bodies. Like OptimizedCode, these are copies owned by the program.
+struct FunctionCode {
+    Arena arena;
+    std::deque<Function> functions;
+    std::deque<CompiledCondition> conditions;
+    std::unordered_map<std::string_view, const Function*> byName;
+};
+
+// A definition as compileProgram() collects it, before its body is rewritten.
+struct FunctionSource {
+    int line;
+    const Statement* header;
+    std::vector<ProgramEntry> body;
+    bool closed = false;  // endfunction; was found
+};
+
+// Statements and conditions rewritten by optimizeProgram(). Parsed statements
+// are shared through the statement cache, so the rewritten ones are copies
+// owned by the program.
+struct OptimizedCode {
+    Arena arena;
+    std::deque<CompiledCondition> conditions;
+};
+
+struct Program {
+    std::vector<ProgramEntry> statements;
+    std::unique_ptr<OptimizedCode> optimized;
+    std::unique_ptr<FunctionCode> functions;
+    std::vector<ImportEntry> imports;
+    bool importsPrint = false;
+    bool importsInput = false;
+    bool usesPrint = false;
+    bool usesInput = false;
+    std::vector<std::string_view> unknownFunctions;   // called but not defined, in order
+    size_t sourceStatements = 0;
+    size_t parsedStatements = 0;   // statements that missed the cache
+};
+
+struct Module;
+
+class IornInterpreter {
+    friend class ModuleCache;
+private:
+    // Everything derived from source text. The caches are keyed by text copied
+    // into the arena and survive reset(); the whole block is dropped at once
+    // when it holds mostly statements the current script no longer has.
+    struct ProgramData {
+        Arena arena;
+        // Keyed by condition source text. Slot pointers point into
+        // `variables`, whose nodes are only erased by reset(), which also
+        // clears the slots.
+        std::pmr::unordered_map<std::string_view, CompiledCondition> conditions{&arena};
+        std::pmr::unordered_map<std::string_view, CompiledCondition> expressions{&arena};
+        std::pmr::unordered_map<std::string_view, CompiledCondition> values{&arena};
+        std::pmr::unordered_map<std::string_view, const Statement*> statements{&arena};
+        std::pmr::unordered_map<std::string_view, bool> syntax{&arena};
+    };
+    std::unique_ptr<ProgramData> programData = std::make_unique<ProgramData>();
+    // Variables of the current run; map nodes and names live in runArena,
+    // which reset() releases in one go.
+    Arena runArena;
+    std::pmr::map<std::pmr::string, Value, std::less<>> variables{&runArena};
+    // Array variables, kept apart from the text values. Like those, their
+    // nodes are only erased by reset(), so conditions can keep pointers.
+    std::pmr::map<std::pmr::string, NumberArray, std::less<>> arrays{&runArena};
+    std::string blockText;             // reused buffer for joining if-block lines
+    // Symbols bound by `import mylib.*;`. A module's body runs the first time
+    // one of its symbols is used in a run; its values are then copied in.
+    std::map<std::string, std::shared_ptr<Module>, std::less<>> imports;
+    // Bumped by every interpret(), so each module runs at most once per run
+    // however many files import it.
+    static inline thread_local unsigned long runGeneration = 0;
+    std::string scriptDir;             // searched first for imported modules
+    std::string rootDir;               // directory of the script that started the run
+    // Everything allocated by this interpreter is charged to `memory`: the
+    // front end through programMemory, execution through runMemory.
+    MemoryAccount* memory = MemoryAccount::create();
+    MemoryAccount* programMemory = MemoryAccount::create(memory);
+    MemoryAccount* runMemory = MemoryAccount::create(memory);
+    RunStats lastRun;
+    InterpreterOptions options;
+    // Open while --stats=cpu is given. Each phase is charged what the
+    // counters advanced from the previous mark to the end of the phase.
+    std::unique_ptr<CpuCounters> cpuCounters;
+    std::array<uint64_t, cpuCounterCount> cpuMark{};
+    // Whole programs by hash of their source, when options.cachePrograms is
+    // set: a script sent again skips the front end. The programs point into
+    // programData and are dropped with it. Programs importing user modules
+    // are not kept, since the modules may change between runs.
+    struct CachedProgram {
+        std::string source;
+        Program program;
+    };
+    std::unordered_map<size_t, CachedProgram> programCache;
+    // Calls of user-defined functions. The frames of running functions lie
+    // one after another in `frames`, innermost last, so a call allocates
+    // nothing once the vector has grown; `frameBase` is where the innermost
+    // frame starts.
+    static constexpr size_t maxCallDepth = 1000;
+    const FunctionCode* functionCode = nullptr;  // functions of the program being run
+    std::vector<FrameSlot> frames;
+    size_t frameBase = 0;
+    size_t callDepth = 0;
+    const Function* currentFunction = nullptr;
+    bool returning = false;            // a return statement ran; its function stops
+    FrameSlot returnValue;
+    // First failed call of the statement being run. Calls inside conditions
+    // have no result to fail through, so executeStatement() reports it.
+    Diagnostic callFailure;
+    std::vector<std::string> unknownReported;   // unknown functions already reported with their line
+    size_t errorCount = 0;             // printError() calls; a function stops at its first error
+
+    void setRedColor() {
+#ifdef _WIN32
+        HANDLE hConsole = GetStdHandle(STD_ERROR_HANDLE);
+        if (hConsole != INVALID_HANDLE_VALUE) {
+            SetConsoleTextAttribute(hConsole, FOREGROUND_RED | FOREGROUND_INTENSITY);
+        }
+#else
+        if (scriptErr == &std::cerr) std::cerr << "\033[31m";
+#endif
+    }
+    
+    void resetColor() {
+#ifdef _WIN32
+        HANDLE hConsole = GetStdHandle(STD_ERROR_HANDLE);
+        if (hConsole != INVALID_HANDLE_VALUE) {
+            SetConsoleTextAttribute(hConsole, FOREGROUND_RED | FOREGROUND_GREEN | FOREGROUND_BLUE);
+        }
+#else
+        if (scriptErr == &std::cerr) std::cerr << "\033[0m";
+#endif
+    }
+    
+    void printError(const std::string& message) {
+        errorCount++;
+        setRedColor();
+        *scriptErr << message << std::endl;
+        resetColor();
+    }
+    
+    bool checkSyntax(const std::string& code) {
+        int lineNum = 0;
+        std::string message;
+        
+        for (std::string_view line : splitLines(code)) {
+            lineNum++;
+            if (line.empty()) continue;
+            
+            // Whether a line passes does not depend on where it is, so the
+            // result is cached by text and only new lines are checked.
+            auto cached = programData->syntax.find(line);
+            if (cached != programData->syntax.end() && cached->second) continue;
+            
+            bool ok = checkLineEnding(line, lineNum, message);
+            programData->syntax.emplace(programData->arena.copy(line), ok);
+            if (!ok) {
+                printError(message);
+                return false;
+            }
+        }
+        return true;
+    }
+    
+    std::string removeComments(const std::string& code) {
+        return stripComments(code);
+    }
+    
+    void startPhases() {
+        if (cpuCounters) cpuMark = cpuCounters->read();
+    }
+    
+    void markPhase(RunPhase phase) {
+        if (!cpuCounters) return;
+        std::array<uint64_t, cpuCounterCount> now = cpuCounters->read();
+        CpuSample& sample = lastRun.cpu[static_cast<size_t>(phase)];
+        for (size_t i = 0; i < cpuCounterCount; i++) {
+            sample.counts[i] += now[i] - cpuMark[i];
+        }
+        sample.measured = true;
+        cpuMark = now;
+    }
+    
+    bool validateVariable(std::string_view varName, std::string_view varType, std::string_view varValue, int lineNum,
+                          bool checkValue = true, bool local = false) {
+        std::string message;
+        if (!checkVariableName(varName, lineNum, message)) {
+            printError(message);
+            return false;
+        }
+        
+        if (!local && (variables.find(varName) != variables.end() || arrays.find(varName) != arrays.end() ||
+                       imports.find(varName) != imports.end())) {
+            printError("Variable '" + std::string(varName) + "' is already declared on line " + std::to_string(lineNum) + ".");
+            return false;
+        }
+        
+        if (checkValue && !checkVariableValue(varType, varValue, lineNum, message)) {
+            printError(message);
+            return false;
+        }
+        return true;
+    }
+    
+    const Value* resolveSlot(CondNode& node) {
+        if (node.slot == nullptr) {
+            node.slot = lookup(node.text);
+        }
+        return node.slot;
+    }
+    
+    EvalResult<double> evaluateNumber(CompiledCondition& cond, int idx);
+    EvalResult<ExactNumber> evaluateExact(CompiledCondition& cond, int idx);
+    CondValue evaluateOperand(CompiledCondition& cond, int idx);
+    bool evaluateBool(CompiledCondition& cond, int idx);
+    EvalResult<FrameSlot> evaluateAs(std::string_view type, CompiledCondition& cond, int idx);
+    EvalError callFunction(CompiledCondition& cond, int idx, FrameSlot& result, bool needValue);
+    EvalResult<NumberArray> evaluateArray(CompiledCondition& cond, int idx, bool floating);
+    EvalResult<ExactNumber> evaluateAggregate(CompiledCondition& cond, int idx);
+    bool isArrayValued(CompiledCondition& cond, int idx);
+    
+    NumberArray* resolveArray(CondNode& node) {
+        if (node.array == nullptr) {
+            auto it = arrays.find(std::string_view(node.text));
+            if (it != arrays.end()) node.array = &it->second;
+        }
+        return node.array;
+    }
+    
+    // Array failures are kept like failed calls, so that one found while a
+    // condition compares its operands is still reported.
+    EvalError recordFailure(EvalError kind, std::string_view operand, std::string_view source = {},
+                            std::string_view expected = {}) {
+        if (callFailure.kind == EvalError::None) {
+            callFailure = {kind, 0, source, operand, expected};
+        }
+        return kind;
+    }
+    
+    FrameSlot& frameSlot(int local) {
+        return frames[frameBase + static_cast<size_t>(local)];
+    }
+    
+    enum class CompileMode { Condition, Expression, Value };
+    
+    // Compiled once per distinct text; statements keep the pointer.
+    CompiledCondition* compileCondition(std::string_view condition, CompileMode mode = CompileMode::Condition) {
+        auto& cache = mode == CompileMode::Condition ? programData->conditions
+                    : mode == CompileMode::Expression ? programData->expressions : programData->values;
+        auto it = cache.find(condition);
+        if (it == cache.end()) {
+            CompiledCondition compiled;
+            std::string source(condition);
+            ConditionCompiler compiler(source);
+            bool compiledOk = mode == CompileMode::Condition ? compiler.compile(compiled)
+                            : mode == CompileMode::Expression ? compiler.compileExpression(compiled) : compiler.compileValue(compiled);
+            if (!compiledOk) {
+                compiled.nodes.clear();
+                compiled.root = -1;
+            }
+            it = cache.emplace(programData->arena.copy(condition), std::move(compiled)).first;
+        }
+        return &it->second;
+    }
+    
+    EvalResult<bool> evaluateCondition(CompiledCondition& condition) {
+        if (condition.root < 0) {
+            return {false, EvalError::InvalidCondition};
+        }
+        bool taken = evaluateBool(condition, condition.root);
+        return {taken, callFailure.kind};
+    }
+    
+    // A failure caused by a failed call is left to reportCallFailure().
+    void reportDiagnostic(const Diagnostic& diagnostic) {
+        if (callFailure.kind != EvalError::None) return;
+        std::string line = std::to_string(diagnostic.line);
+        std::string operand(diagnostic.operand);
+        switch (diagnostic.kind) {
+            case EvalError::InvalidCondition:
+                printError("Error: Invalid condition or expression in if statement on line " + line + ".");
+                break;
+            case EvalError::UndeclaredVariable:
+                printError("Variable '" + operand + "' is not declared on line " + line + ".");
+                break;
+            case EvalError::NotBoolean:
+                printError("Boolean value must be TRUE or FALSE on line " + line + ".");
+                break;
+            case EvalError::UnknownFunction:
+                printError("Unknown function '" + operand + "()' on line " + line + ". Function is not defined or imported.");
+                unknownReported.push_back(operand);
+                break;
+            case EvalError::ArgumentCount:
+                printError("Wrong number of arguments for '" + operand + "()' on line " + line + ", expected " +
+                           std::string(diagnostic.expected) + ".");
+                break;
+            case EvalError::ArgumentType:
+                printError("Argument '" + operand + "' of '" + std::string(diagnostic.source) + "()' must be " +
+                           std::string(diagnostic.expected) + " on line " + line + ".");
+                break;
+            case EvalError::NoValue:
+                printError("Function '" + operand + "()' does not return a value on line " + line + ".");
+                break;
+            case EvalError::MissingReturn:
+                printError("Function '" + operand + "()' called on line " + line + " ended without returning a value.");
+                break;
+            case EvalError::ReturnType:
+                printError("Invalid return value '" + std::string(diagnostic.source) + "' of '" + operand + "()' on line " +
+                           line + ". Must be " + std::string(diagnostic.expected) + ".");
+                break;
+            case EvalError::CallDepth:
+                printError("Error: Call depth limit of " + std::to_string(maxCallDepth) + " reached in '" + operand +
+                           "()' on line " + line + ".");
+                break;
+            case EvalError::Reported:
+                break;
+            case EvalError::ArrayValue:
+                printError("Array '" + operand + "' cannot be used as a single value on line " + line + ".");
+                break;
+            case EvalError::NotArray:
+                printError("'" + operand + "' is not an array on line " + line + ".");
+                break;
+            case EvalError::IndexOutOfRange:
+                printError("Index out of range for array '" + operand + "' on line " + line + ".");
+                break;
+            case EvalError::LengthMismatch:
+                printError("Arrays of different lengths in '" + operand + "' on line " + line + ".");
+                break;
+            case EvalError::EmptyArray:
+                printError("'" + operand + "' of an empty array on line " + line + ".");
+                break;
+            default:
+                printError(diagnostic.expected == "numeric"
+                    ? "Invalid numeric value '" + std::string(diagnostic.source) + "' on line " + line + "."
+                    : "Invalid floating value '" + std::string(diagnostic.source) + "' on line " + line + ". Must contain decimal point.");
+                break;
+        }
+    }
+    
+    // Variable by name, running the module that provides it if it is an
+    // imported symbol not used yet in this run.
+    Value* lookup(std::string_view name) {
+        auto it = variables.find(name);
+        if (it != variables.end()) return &it->second;
+        auto imported = imports.find(name);
+        if (imported == imports.end() || !runModule(imported->second)) return nullptr;
+        it = variables.find(name);
+        return it != variables.end() ? &it->second : nullptr;
+    }
+    
+    bool runModule(const std::shared_ptr<Module>& module);
+    bool bindImports(const Program& program);
+    
+    // Known values of constants, by variable name.
+    using ConstantMap = std::pmr::unordered_map<std::string_view, std::string_view>;
+    void optimizeProgram(Program& program);
+    void foldNode(CompiledCondition& cond, int idx, const ConstantMap& constants, bool& changed);
+    bool hasSideEffects(const CompiledCondition& cond, int idx) const;
+    bool foldParts(const std::pmr::vector<TextPart>& parts, std::pmr::vector<TextPart>& folded, const ConstantMap& constants);
+    template <typename... Parts>
+    void reportOptimization(int line, const Parts&... parts) const {
+        if (!options.optReport) return;
+        *scriptErr << "[opt] line " << line << ": ";
+        (*scriptErr << ... << parts) << std::endl;
+    }
+    bool compileSource(const std::string& code, Program& program);
+    
+    Value& variable(std::string_view name) {
+        auto it = variables.find(name);
+        if (it == variables.end()) {
+            it = variables.emplace(std::piecewise_construct, std::forward_as_tuple(name), std::forward_as_tuple()).first;
+        }
+        return it->second;
+    }
+    
+    bool executeInput(std::string_view prompt, std::string_view expectedType, std::string& input);
+    bool executeArrayInput(std::string_view prompt, NumberArray& array);
+    void executePrint(const std::pmr::vector<TextPart>& parts);
+    Value evaluateConcatenation(const Statement& stmt);
+    const Value* partValue(const TextPart& part);
+    void assign(const Statement& stmt, Value value);
+    void assignArray(const Statement& stmt, int lineNum);
+    void assignElement(const Statement& stmt, int lineNum);
+    void parseBlock(std::string_view block, std::pmr::vector<Statement>& body);
+    void parseIfStatement(std::string_view cleanCode, Statement& stmt);
+    size_t parseReturn(std::string_view text, size_t from, Statement& stmt);
+    const Statement* parseStatement(std::string_view text);
+    void defineFunctions(Program& program, const std::vector<FunctionSource>& sources);
+    void executeStatement(const Statement& stmt, int lineNum);
+    void runStatement(const Statement& stmt, int lineNum);
+    void reportCallFailure(int lineNum);
+    bool executeProgram(const Program& program);
+    void beginExecution(const Program& program);
+    const Statement& addStatement(std::string_view text, int lineNum, Program& program);
+    
+public:
+    IornInterpreter() {
+#ifdef _WIN32
+        SetConsoleOutputCP(65001);
+        SetConsoleCP(65001);
+#endif
+    }
+    
+    // Memory still held is credited back as the members are destroyed.
+    ~IornInterpreter() {
+        runMemory->release();
+        programMemory->release();
+        memory->release();
+    }
+    
+    IornInterpreter(const IornInterpreter&) = delete;
+    IornInterpreter& operator=(const IornInterpreter&) = delete;
+    
+    // Clears run-time state so the same interpreter can run a script again
+    // while keeping its parsed statements and compiled conditions.
+    void reset() {
+        variables.clear();
+        arrays.clear();
+        runArena.release();
+        for (auto* cache : {&programData->conditions, &programData->expressions, &programData->values}) {
+            for (auto& entry : *cache) {
+                for (CondNode& node : entry.second.nodes) {
+                    node.slot = nullptr;
+                    node.callee = nullptr;
+                    node.array = nullptr;
+                }
+            }
+        }
+    }
+    
+    Program compileProgram(const std::string& cleanCode);
+    
+    const RunStats& lastRunStats() const {
+        return lastRun;
+    }
+    
+    void setOptions(const InterpreterOptions& newOptions) {
+        options = newOptions;
+        memory->limit = options.maxMemory;
+        if (options.maxMemory || options.memStats) memoryAccounting.store(true, std::memory_order_relaxed);
+        if (options.allocStats) allocationCounting.store(true, std::memory_order_relaxed);
+        if (options.cpuStats && !cpuCounters) cpuCounters = std::make_unique<CpuCounters>();
+    }
+    
+    void printStats() {
+        if (options.allocStats) {
+            size_t statements = std::max<size_t>(lastRun.statements, 1);
+            std::cerr << "[stats] front end: " << lastRun.frontEndAllocations << " allocations ("
+                      << lastRun.frontEndAllocatedBytes << " bytes), "
+                      << static_cast<double>(lastRun.frontEndAllocations) / statements << " per statement" << std::endl;
+            std::cerr << "[stats] execution: " << lastRun.executeAllocations << " allocations ("
+                      << lastRun.executeAllocatedBytes << " bytes), "
+                      << static_cast<double>(lastRun.executeAllocations) / statements << " per statement" << std::endl;
+            std::cerr << "[stats] arenas: program " << lastRun.programArenaBytes << " bytes, variables "
+                      << lastRun.runArenaBytes << " bytes" << std::endl;
+        }
+        if (options.memStats) {
+            std::cerr << "[stats] memory: peak " << lastRun.memoryPeak << " bytes, current " << lastRun.memoryCurrent
+                      << " bytes (program data " << lastRun.programMemory << ", variables " << lastRun.variableMemory << ")";
+            if (options.maxMemory) std::cerr << ", limit " << options.maxMemory << " bytes";
+            std::cerr << std::endl;
+        }
+        if (options.cpuStats) {
+            printCpuStats();
+        }
+    }
+    
+    // One line per phase, with each counter per statement: front-end phases
+    // per statement of the script, execution per statement executed.
+    void printCpuStats() {
+        static const char* phaseNames[runPhaseCount] = {"load", "preprocess", "syntax check", "parse", "front end", "execute"};
+        const CpuCounters& counters = *cpuCounters;
+        if (!counters.available()) {
+            std::cerr << "[stats] cpu: counters unavailable (" << counters.failure() << ")" << std::endl;
+            return;
+        }
+        std::string missing;
+        for (size_t i = 0; i < cpuCounterCount; i++) {
+            if (counters.has(static_cast<CpuCounter>(i))) continue;
+            missing += missing.empty() ? "" : ", ";
+            missing += CpuCounters::names[i];
+        }
+        if (!missing.empty()) {
+            std::cerr << "[stats] cpu: " << missing << " unavailable (" << counters.failure() << ")" << std::endl;
+        }
+        for (size_t phase = 0; phase < runPhaseCount; phase++) {
+            const CpuSample& sample = lastRun.cpu[phase];
+            if (!sample.measured) continue;
+            bool execute = static_cast<RunPhase>(phase) == RunPhase::Execute;
+            double statements = static_cast<double>(std::max<size_t>(execute ? lastRun.executedStatements : lastRun.statements, 1));
+            std::string totals, perStatement;
+            for (size_t i = 0; i < cpuCounterCount; i++) {
+                if (!counters.has(static_cast<CpuCounter>(i))) continue;
+                std::string separator = totals.empty() ? "" : ", ";
+                totals += separator + std::to_string(sample.counts[i]) + " " + CpuCounters::names[i];
+                std::ostringstream figure;
+                figure << static_cast<double>(sample.counts[i]) / statements;
+                perStatement += separator + figure.str() + " " + CpuCounters::names[i];
+            }
+            std::cerr << "[stats] cpu " << phaseNames[phase] << ": " << totals;
+            uint64_t cycles = sample.counts[static_cast<size_t>(CpuCounter::Cycles)];
+            if (counters.has(CpuCounter::Cycles) && counters.has(CpuCounter::Instructions) && cycles > 0) {
+                std::cerr << ", IPC " << static_cast<double>(sample.counts[static_cast<size_t>(CpuCounter::Instructions)]) / cycles;
+            }
+            std::cerr << "; per " << (execute ? "executed statement" : "statement") << ": " << perStatement << std::endl;
+        }
+    }
+    
+    // A refused allocation that a statement did not catch ends the run here,
+    // wherever it was made.
+    void interpret(const std::string& code) {
+        try {
+            interpretSource(code);
+        } catch (const std::bad_alloc&) {
+            if (!memory->overLimit()) throw;
+            recordMemory();
+            checkMemory();
+        }
+    }
+    
+    void interpretSource(const std::string& code) {
+        auto start = std::chrono::steady_clock::now();
+        ExecutionBudget budget(options);
+        size_t startAllocations = allocationCount.load(std::memory_order_relaxed);
+        size_t startBytes = allocationBytes.load(std::memory_order_relaxed);
+        lastRun = RunStats();
+        startPhases();
+        runGeneration++;
+        MemoryScope memoryScope(programMemory);
+        memory->resetPeak();
+        size_t hash = options.cachePrograms ? std::hash<std::string_view>()(code) : 0;
+        auto cached = options.cachePrograms ? programCache.find(hash) : programCache.end();
+        bool reused = cached != programCache.end() && cached->second.source == code;
+        Program compiledProgram;
+        if (!reused && !compileSource(code, compiledProgram)) {
+            recordMemory();
+            return;
+        }
+        recordMemory();
+        Program& program = reused ? cached->second.program : compiledProgram;
+        auto compiledAt = std::chrono::steady_clock::now();
+        lastRun.statements = program.sourceStatements;
+        lastRun.parsedStatements = reused ? 0 : program.parsedStatements;
+        lastRun.frontEndMs = std::chrono::duration<double, std::milli>(compiledAt - start).count();
+        size_t compiledAllocations = allocationCount.load(std::memory_order_relaxed);
+        size_t compiledBytes = allocationBytes.load(std::memory_order_relaxed);
+        lastRun.frontEndAllocations = compiledAllocations - startAllocations;
+        lastRun.frontEndAllocatedBytes = compiledBytes - startBytes;
+        
+        if (!program.importsPrint) {
+            printError("I do not know what Print is! Write its import");
+            return;
+        }
+        
+        if (program.usesInput && !program.importsInput) {
+            printError("I do not know what input is! Write its import");
+            return;
+        }
+        
+        if (!bindImports(program) || !checkMemory()) {
+            return;
+        }
+        Program* toRun = &program;
+        if (!reused) {
+            optimizeProgram(program);
+            if (options.cachePrograms && program.imports.empty()) {
+                if (programCache.size() >= 256) programCache.clear();
+                CachedProgram& entry = programCache[hash];
+                entry.source = code;
+                entry.program = std::move(program);
+                toRun = &entry.program;
+            }
+        }
+        markPhase(RunPhase::Parse);
+        
+        // Execute code statement by statement
+        memoryScope.switchTo(runMemory);
+        bool completed = executeProgram(*toRun);
+        markPhase(RunPhase::Execute);
+        lastRun.executedStatements = budget.steps;
+        recordMemory();
+        lastRun.executeMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - compiledAt).count();
+        lastRun.executeAllocations = allocationCount.load(std::memory_order_relaxed) - compiledAllocations;
+        lastRun.executeAllocatedBytes = allocationBytes.load(std::memory_order_relaxed) - compiledBytes;
+        lastRun.programArenaBytes = programData->arena.bytesUsed();
+        lastRun.runArenaBytes = runArena.bytesUsed();
+        if (!completed) {
+            if (checkMemory()) reportBudget(budget);
+            return;
+        }
+        
+        // The first one not already reported while the script ran.
+        for (std::string_view name : toRun->unknownFunctions) {
+            if (std::find(unknownReported.begin(), unknownReported.end(), name) != unknownReported.end()) continue;
+            printError("Unknown function '" + std::string(name) + "()'. Function is not defined or imported.");
+            break;
+        }
+    }
+    
+    void recordMemory() {
+        lastRun.memoryPeak = memory->peak.load(std::memory_order_relaxed);
+        lastRun.memoryCurrent = memory->current();
+        lastRun.programMemory = programMemory->current();
+        lastRun.variableMemory = runMemory->current();
+    }
+    
+    // Reports a run that went over --max-memory; false if it did.
+    bool checkMemory() {
+        if (!memory->overLimit()) return true;
+        MemoryScope unaccounted(nullptr);
+        lastRun.status = RunStatus::MemoryLimit;
+        std::string where = lastRun.abortLine ? "on line " + std::to_string(lastRun.abortLine)
+                                              : std::string("while loading the script");
+        printError("Error: Memory limit of " + std::to_string(memory->limit) + " bytes exceeded " + where +
+                   " (allocation of " + std::to_string(memory->refused.load(std::memory_order_relaxed)) +
+                   " bytes refused, peak " + std::to_string(lastRun.memoryPeak) + " bytes).");
+        return false;
+    }
+    
+    // Reports a run its budget stopped.
+    void reportBudget(const ExecutionBudget& budget) {
+        lastRun.status = budget.stopped;
+        std::string line = std::to_string(lastRun.abortLine);
+        switch (budget.stopped) {
+            case RunStatus::StepLimit:
+                printError("Error: Step limit of " + std::to_string(budget.maxSteps) + " statements reached on line " + line + ".");
+                break;
+            case RunStatus::Timeout:
+                printError("Error: Time limit of " + std::to_string(budget.timeoutMs) + " ms reached on line " + line + ".");
+                break;
+            case RunStatus::InputLimit:
+                if (budget.lineTooLong) {
+                    printError("Error: Input line read on line " + line + " is longer than " + std::to_string(maxInputLineLength) + " bytes.");
+                } else {
+                    printError(budget.inputEnded ? "Error: Input ended before line " + line + " could read a value."
+                                                 : "Error: Input limit of " + std::to_string(budget.maxInputs) + " reads reached on line " + line + ".");
+                }
+                break;
+            default:
+                break;
+        }
+    }
+    
+    void interpretFile(const std::string& filename) {
+        std::ifstream file(filename);
+        if (!file.is_open()) {
+            setRedColor();
+            std::cerr << "Error: Cannot open file " << filename << std::endl;
+            resetColor();
+            return;
+        }
+        
+        startPhases();
+        std::string code((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+        lastRun.cpu = {};
+        markPhase(RunPhase::Load);
+        CpuSample load = lastRun.cpu[static_cast<size_t>(RunPhase::Load)];
+        setScriptPath(filename);
+        interpret(code);
+        lastRun.cpu[static_cast<size_t>(RunPhase::Load)] = load;
+        printStats();
+    }
+    
+    // Runs statements as soon as they have been read.
+    void interpretStream(std::istream& in) {
+        try {
+            interpretLines(in);
+        } catch (const std::bad_alloc&) {
+            if (!memory->overLimit()) throw;
+            recordMemory();
+            checkMemory();
+        }
+    }
+    
+    void interpretLines(std::istream& in);
+    
+    // `iorn --stream file.iorn`, or `iorn -` for a script piped to stdin.
+    void streamFile(const std::string& filename) {
+        if (filename == "-") {
+            setScriptPath(std::string());
+#ifndef _WIN32
+            // stdin carries the script, so input() has nothing to read.
+            InputReader noInput{std::string()};
+            scriptInput = &noInput;
+            interpretStream(std::cin);
+            scriptInput = &standardInput;
+#else
+            interpretStream(std::cin);
+#endif
+        } else {
+            std::ifstream file(filename);
+            if (!file.is_open()) {
+                setRedColor();
+                std::cerr << "Error: Cannot open file " << filename << std::endl;
+                resetColor();
+                return;
+            }
+            setScriptPath(filename);
+            interpretStream(file);
+        }
+        printStats();
+    }
+    
+    void setScriptPath(const std::string& filename) {
+        size_t slash = filename.find_last_of("/\\");
+        scriptDir = rootDir = (slash == std::string::npos) ? std::string() : filename.substr(0, slash);
+    }
+};
+
+// A user module: an .iorn file imported with `import mylib.*;`. Modules are
+// parsed once per process (once per worker under `iorn --serve`) and kept by ModuleCache while their file (and the
+// files they import) are unchanged. Each module runs in an interpreter of
+// its own, so importers only see the symbols they bind.
+struct Module {
+    std::string name;                  // as written in the import, e.g. "lib.util"
+    std::string path;
+    std::string source;                // text the module was parsed from
+    std::unique_ptr<IornInterpreter> interpreter;
+    Program program;
+    std::set<std::string, std::less<>> symbols;  // top-level variables
+    std::vector<std::shared_ptr<Module>> dependencies;
+    bool loading = false;
+    unsigned long generation = 0;      // run in which the body last ran
+};
+
+class ModuleCache {
+public:
+    // One per thread: the workers of `iorn --serve` never share a module
+    // or the interpreter its body runs in.
+    static ModuleCache& instance() {
+        static thread_local ModuleCache cache;
+        return cache;
+    }
+
+    // Finds `name` (dots separate directories) next to the importing file,
+    // next to the script being run, in the IORN_PATH directories and
+    // finally in the working directory.
+    static std::string resolve(const std::string& name, const std::string& importerDir, const std::string& rootDir) {
+        std::string relative = name;
+        std::replace(relative.begin(), relative.end(), '.', '/');
+        relative += ".iorn";
+
+        std::vector<std::string> dirs;
+        if (!importerDir.empty()) dirs.push_back(importerDir);
+        if (!rootDir.empty() && rootDir != importerDir) dirs.push_back(rootDir);
+        if (const char* env = std::getenv("IORN_PATH")) {
+#ifdef _WIN32
+            const char separator = ';';
+#else
+            const char separator = ':';
+#endif
+            std::stringstream entries(env);
+            std::string dir;
+            while (std::getline(entries, dir, separator)) {
+                if (!dir.empty()) dirs.push_back(dir);
+            }
+        }
+        dirs.push_back(".");
+
+        for (const std::string& dir : dirs) {
+            std::string candidate = dir + "/" + relative;
+            if (std::ifstream(candidate).good()) return candidate;
+        }
+        return std::string();
+    }
+
+    // Returns the parsed module, parsing it only if the file is new or has
+    // changed since. Errors are printed and give nullptr; `circular` is set
+    // when the module is already being loaded further up the import chain.
+    std::shared_ptr<Module> load(const std::string& name, const std::string& path, const std::string& rootDir, bool& circular) {
+        circular = false;
+        std::string source;
+        if (!readFile(path, source)) return nullptr;
+
+        auto cached = modules.find(path);
+        if (cached != modules.end()) {
+            if (cached->second->loading) {
+                circular = true;
+                return nullptr;
+            }
+            if (isCurrent(*cached->second, source)) return cached->second;
+        }
+
+        auto module = std::make_shared<Module>();
+        module->name = name;
+        module->path = path;
+        module->source = std::move(source);
+        module->interpreter = std::make_unique<IornInterpreter>();
+        module->interpreter->setScriptPath(path);
+        module->interpreter->rootDir = rootDir;
+        modules[path] = module;
+
+        module->loading = true;
+        bool ok = module->interpreter->compileSource(module->source, module->program);
+        if (ok && module->program.usesPrint && !module->program.importsPrint) {
+            module->interpreter->printError("I do not know what Print is! Write its import");
+            ok = false;
+        } else if (ok && module->program.usesInput && !module->program.importsInput) {
+            module->interpreter->printError("I do not know what input is! Write its import");
+            ok = false;
+        }
+        ok = ok && module->interpreter->bindImports(module->program);
+        if (ok) module->interpreter->optimizeProgram(module->program);
+        module->loading = false;
+
+        if (!ok) {
+            modules.erase(path);
+            return nullptr;
+        }
+        for (const auto& entry : module->interpreter->imports) {
+            if (std::find(module->dependencies.begin(), module->dependencies.end(), entry.second) == module->dependencies.end()) {
+                module->dependencies.push_back(entry.second);
+            }
+        }
+        for (const ProgramEntry& entry : module->program.statements) {
+            const Statement& stmt = *entry.statement;
+            if (stmt.kind == StmtKind::Declare || stmt.kind == StmtKind::DeclareNull) {
+                module->symbols.emplace(stmt.name);
+            }
+        }
+        return module;
+    }
+
+private:
+    static bool readFile(const std::string& path, std::string& text) {
+        std::ifstream file(path);
+        if (!file.is_open()) return false;
+        text.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+        return true;
+    }
+
+    // A module is current when neither its file nor any file it imports changed.
+    bool isCurrent(const Module& module, const std::string& source) {
+        if (module.source != source) return false;
+        for (const auto& dependency : module.dependencies) {
+            std::string text;
+            if (!readFile(dependency->path, text) || !isCurrent(*dependency, text)) return false;
+        }
+        return true;
+    }
+
+    std::map<std::string, std::shared_ptr<Module>> modules;
+};
+
+bool IornInterpreter::compileSource(const std::string& code, Program& program) {
+    std::string cleanCode = removeComments(code);
+    std::string translated;
+    if (translateKeywords(cleanCode, translated)) {
+        cleanCode.swap(translated);
+    }
+    markPhase(RunPhase::Preprocess);
+    bool valid = checkSyntax(cleanCode);
+    markPhase(RunPhase::SyntaxCheck);
+    if (!valid) {
+        return false;
+    }
+    program = compileProgram(cleanCode);
+    markPhase(RunPhase::Parse);
+    return true;
+}
+
+// Resolves every `import module.symbol;` and `import module.*;` of the
+// program. Modules are parsed here if needed but not run.
+bool IornInterpreter::bindImports(const Program& program) {
+    imports.clear();
+    for (const ImportEntry& entry : program.imports) {
+        size_t dot = entry.path.rfind('.');
+        std::string name(entry.path.substr(0, dot));
+        std::string symbol(entry.path.substr(dot + 1));
+        std::string path = ModuleCache::resolve(name, scriptDir, rootDir);
+        if (path.empty()) {
+            printError("Cannot find module '" + name + "' imported on line " + std::to_string(entry.line) + ".");
+            return false;
+        }
+
+        bool circular;
+        std::shared_ptr<Module> module = ModuleCache::instance().load(name, path, rootDir, circular);
+        if (!module) {
+            printError(circular ? "Circular import of module '" + name + "' on line " + std::to_string(entry.line) + "."
+                                : "Module '" + name + "' could not be loaded.");
+            return false;
+        }
+
+        if (symbol == "*") {
+            for (const std::string& exported : module->symbols) {
+                imports[exported] = module;
+            }
+        } else if (module->symbols.count(symbol)) {
+            imports[symbol] = module;
+        } else {
+            printError("Module '" + name + "' has no variable '" + symbol + "' on line " + std::to_string(entry.line) + ".");
+            return false;
+        }
+    }
+    return true;
+}
+
+// Runs the module body unless it already ran in this run, then copies the
+// values of the symbols bound from it. Copies share the text buffers.
+bool IornInterpreter::runModule(const std::shared_ptr<Module>& module) {
+    IornInterpreter& runner = *module->interpreter;
+    if (module->generation != runGeneration) {
+        module->generation = runGeneration;
+        runner.reset();
+        runner.executeProgram(module->program);
+    }
+    for (const auto& entry : imports) {
+        std::string_view name = entry.first;
+        if (entry.second != module || variables.find(name) != variables.end()) continue;
+        auto value = runner.variables.find(name);
+        if (value != runner.variables.end()) {
+            variable(name) = value->second;
+        }
+    }
+    return true;
+}
+
+static bool isLogicNode(const CondNode& node) {
+    return node.op == CondOp::BoolLit || node.op == CondOp::Not || node.op == CondOp::And || node.op == CondOp::Or ||
+           (node.op >= CondOp::Eq && node.op <= CondOp::Lt);
+}
+
+bool IornInterpreter::hasSideEffects(const CompiledCondition& cond, int idx) const {
+    const CondNode& node = cond.nodes[idx];
+    if (node.calls) return true;
+    if (node.op == CondOp::Slot) return imports.find(node.text) != imports.end();
+    return (node.lhs >= 0 && hasSideEffects(cond, node.lhs)) || (node.rhs >= 0 && hasSideEffects(cond, node.rhs));
+}
+
+// Replaces constants by their values and subtrees with literal operands only
+// by literal nodes that evaluate the same way in every context: numbers keep
+// their source text for string comparisons, logic results become TRUE/FALSE.
+// Subtrees that would run an imported module or call a function are never
+// dropped; calls and array operations are not folded, only their operands.
+void IornInterpreter::foldNode(CompiledCondition& cond, int idx, const ConstantMap& constants, bool& changed) {
+    CondNode& node = cond.nodes[idx];
+    if (isLiteralNode(node)) return;
+    if (node.op == CondOp::Call || node.op == CondOp::Arg || node.op >= CondOp::Index) {
+        if (node.lhs >= 0) foldNode(cond, node.lhs, constants, changed);
+        if (node.op == CondOp::Arg && node.rhs >= 0) foldNode(cond, node.rhs, constants, changed);
+        return;
+    }
+    if (node.op == CondOp::Slot) {
+        auto it = constants.find(node.text);
+        if (it == constants.end()) return;
+        node.text = std::string(it->second);
+        if (node.text == "TRUE" || node.text == "FALSE") {
+            node.op = CondOp::BoolLit;
+            node.number = (node.text == "TRUE") ? 1 : 0;
+        } else {
+            node.op = CondOp::StringLit;
+            node.numericText = parseNumber(node.text, node.number) != NumberForm::None;
+        }
+        changed = true;
+        return;
+    }
+
+    foldNode(cond, node.lhs, constants, changed);
+    if (node.rhs >= 0) foldNode(cond, node.rhs, constants, changed);
+    bool lhsLiteral = isLiteralNode(cond.nodes[node.lhs]);
+    bool rhsLiteral = node.rhs < 0 || isLiteralNode(cond.nodes[node.rhs]);
+
+    if (lhsLiteral && rhsLiteral) {
+        if (node.op >= CondOp::Neg && node.op <= CondOp::Pow) {
+            EvalResult<double> number = evaluateNumber(cond, idx);
+            node.numericText = static_cast<bool>(number);
+            node.number = number.value;
+            node.op = CondOp::StringLit;
+        } else {
+            bool value = evaluateBool(cond, idx);
+            node.op = CondOp::BoolLit;
+            node.number = value ? 1 : 0;
+            node.text = value ? "TRUE" : "FALSE";
+        }
+        node.lhs = node.rhs = -1;
+        changed = true;
+        return;
+    }
+
+    // `x and FALSE` is FALSE, `x and TRUE` is x; likewise for or. The
+    // remaining side only replaces the node if it is itself a logic node, so
+    // the node still reads as TRUE/FALSE when compared.
+    if (node.op == CondOp::And || node.op == CondOp::Or) {
+        bool isAnd = node.op == CondOp::And;
+        int literal = lhsLiteral ? node.lhs : (rhsLiteral ? node.rhs : -1);
+        if (literal < 0) return;
+        int other = (literal == node.lhs) ? node.rhs : node.lhs;
+        if (evaluateBool(cond, literal) != isAnd) {
+            // A left-hand literal already skips the other side when run.
+            if (literal == node.rhs && hasSideEffects(cond, other)) return;
+            node.op = CondOp::BoolLit;
+            node.number = isAnd ? 0 : 1;
+            node.text = isAnd ? "FALSE" : "TRUE";
+            node.lhs = node.rhs = -1;
+            changed = true;
+        } else if (isLogicNode(cond.nodes[other])) {
+            cond.nodes[idx] = cond.nodes[other];
+            changed = true;
+        }
+    }
+}
+
+// Print and concatenation parts with constants replaced by their text.
+bool IornInterpreter::foldParts(const std::pmr::vector<TextPart>& parts, std::pmr::vector<TextPart>& folded, const ConstantMap& constants) {
+    bool changed = false;
+    folded.clear();
+    for (const TextPart& part : parts) {
+        auto it = part.isVariable ? constants.find(part.text) : constants.end();
+        if (it != constants.end()) {
+            folded.push_back({false, it->second});
+            changed = true;
+        } else {
+            folded.push_back(part);
+        }
+    }
+    return changed;
+}
+
+// Constant propagation and folding. A constant is a variable declared once,
+// never renamed or read from input, whose value is known before the run;
+// from its declaration on its uses are replaced by the value. Expressions
+// left with literal operands are computed here, and if-branches whose
+// condition is known are dropped or made unconditional.
+void IornInterpreter::optimizeProgram(Program& program) {
+    Arena scratch;
+    std::pmr::unordered_map<std::string_view, int> assignments{&scratch};
+    for (const ProgramEntry& entry : program.statements) {
+        const Statement& stmt = *entry.statement;
+        if (stmt.kind == StmtKind::Declare || stmt.kind == StmtKind::DeclareNull || stmt.kind == StmtKind::Rename) {
+            assignments[stmt.name] += (stmt.kind == StmtKind::Rename || stmt.isInput) ? 2 : 1;
+        }
+    }
+    // Variables a function renames change whenever it is called.
+    if (program.functions) {
+        for (const Function& function : program.functions->functions) {
+            for (const ProgramEntry& entry : function.body) {
+                if (entry.statement->kind == StmtKind::Rename && entry.statement->local < 0) {
+                    assignments[entry.statement->name] += 2;
+                }
+            }
+        }
+    }
+
+    auto code = std::make_unique<OptimizedCode>();
+    ConstantMap constants{&scratch};
+    std::vector<ProgramEntry> statements;
+    statements.reserve(program.statements.size());
+    size_t foldedExpressions = 0, removedBranches = 0, removedStatements = 0;
+    std::string message;
+
+    auto isConstant = [&](const Statement& stmt) {
+        return assignments[stmt.name] == 1 && imports.find(stmt.name) == imports.end() &&
+               checkVariableName(stmt.name, 0, message);
+    };
+    // Working copy reused for every expression and condition; it is only
+    // kept if something was replaced.
+    CompiledCondition folded;
+    struct KeptBranch {
+        const Branch* branch;
+        CompiledCondition* condition;
+    };
+    std::pmr::vector<KeptBranch> kept(&scratch);
+    auto fold = [&](const CompiledCondition& source) {
+        folded = source;
+        for (CondNode& node : folded.nodes) {
+            node.slot = nullptr;
+            node.callee = nullptr;
+            node.array = nullptr;
+        }
+        bool changed = false;
+        if (folded.root >= 0) foldNode(folded, folded.root, constants, changed);
+        return changed;
+    };
+
+    for (const ProgramEntry& entry : program.statements) {
+        const Statement* stmt = entry.statement;
+        Statement* copy = nullptr;
+        auto rewrite = [&]() -> Statement& {
+            if (copy == nullptr) copy = code->arena.create<Statement>(*stmt, &code->arena);
+            return *copy;
+        };
+
+        switch (stmt->kind) {
+            case StmtKind::DeclareNull:
+                if (isConstant(*stmt)) constants[stmt->name] = "null";
+                break;
+
+            case StmtKind::Declare:
+            case StmtKind::Rename: {
+                if (stmt->isInput || stmt->invalidValue || stmt->index || isArrayType(stmt->type)) break;
+                std::string_view value;
+                bool known = false;
+                if (stmt->expression) {
+                    bool changed = fold(*stmt->expression);
+                    std::string result;
+                    if (folded.root >= 0 && isLiteralNode(folded.nodes[folded.root])) {
+                        // An expression that cannot be computed is left to report its error when run.
+                        EvalResult<double> number = evaluateNumber(folded, folded.root);
+                        if (number && formatNumber(number.value, stmt->type == "numeric", result)) {
+                            value = code->arena.copy(result);
+                            Statement& rewritten = rewrite();
+                            rewritten.expression = nullptr;
+                            rewritten.validValue = true;
+                            rewritten.literal = value;
+                            known = true;
+                            foldedExpressions++;
+                            reportOptimization(entry.line, "folded '", stmt->literal, "' to ", value);
+                        }
+                    } else if (changed) {
+                        rewrite().expression = &code->conditions.emplace_back(folded);
+                        reportOptimization(entry.line, "propagated constants into '", stmt->literal, "'");
+                    }
+                } else if (!stmt->concat.empty()) {
+                    std::pmr::vector<TextPart> parts(&code->arena);
+                    if (!foldParts(stmt->concat, parts, constants)) break;
+                    if (std::none_of(parts.begin(), parts.end(), [](const TextPart& part) { return part.isVariable; })) {
+                        std::string result;
+                        for (const TextPart& part : parts) result.append(part.text);
+                        value = code->arena.copy(result);
+                        Statement& rewritten = rewrite();
+                        rewritten.concat.clear();
+                        rewritten.validValue = true;
+                        rewritten.literal = value;
+                        known = true;
+                        foldedExpressions++;
+                        reportOptimization(entry.line, "folded '", stmt->literal, "' to \"", value, "\"");
+                    } else {
+                        rewrite().concat = std::move(parts);
+                        reportOptimization(entry.line, "propagated constants into '", stmt->literal, "'");
+                    }
+                } else {
+                    value = stmt->literal;
+                    known = stmt->validValue;
+                }
+                if (known && stmt->kind == StmtKind::Declare && isConstant(*stmt)) {
+                    constants[stmt->name] = value;
+                }
+                break;
+            }
+
+            case StmtKind::If: {
+                // Arms after one that fails to compile stay as they are; that
+                // arm reports the error when it is reached.
+                kept.clear();
+                bool changed = false;
+                for (size_t i = 0; i < stmt->branches.size(); i++) {
+                    const Branch& branch = stmt->branches[i];
+                    if (branch.condition == nullptr || branch.condition->root < 0) {
+                        for (; i < stmt->branches.size(); i++) {
+                            kept.push_back({&stmt->branches[i], stmt->branches[i].condition});
+                        }
+                        break;
+                    }
+
+                    bool conditionChanged = fold(*branch.condition);
+                    if (isLiteralNode(folded.nodes[folded.root])) {
+                        changed = true;
+                        if (!evaluateBool(folded, folded.root)) {
+                            removedBranches++;
+                            reportOptimization(entry.line, "condition '", branch.conditionText, "' is always false, branch removed");
+                            continue;
+                        }
+                        size_t later = stmt->branches.size() - i - 1;
+                        removedBranches += later;
+                        reportOptimization(entry.line, "condition '", branch.conditionText, "' is always true",
+                                           later ? ", later branches removed" : "");
+                        kept.push_back({&branch, nullptr});
+                        break;
+                    }
+                    if (conditionChanged) {
+                        changed = true;
+                        kept.push_back({&branch, &code->conditions.emplace_back(folded)});
+                        reportOptimization(entry.line, "propagated constants into condition '", branch.conditionText, "'");
+                    } else {
+                        kept.push_back({&branch, branch.condition});
+                    }
+                }
+                if (!changed) break;
+                if (kept.empty()) {
+                    removedStatements++;
+                    reportOptimization(entry.line, "if statement removed, no branch can run");
+                    continue;
+                }
+                // A branch known to run is run straight from the cached statement.
+                if (kept.size() == 1 && kept[0].condition == nullptr) {
+                    statements.push_back({entry.line, stmt, kept[0].branch});
+                    continue;
+                }
+                Statement& rewritten = rewrite();
+                rewritten.branches.clear();
+                for (const KeptBranch& branch : kept) {
+                    rewritten.branches.push_back(*branch.branch);
+                    rewritten.branches.back().condition = branch.condition;
+                }
+                break;
+            }
+
+            default:
+                break;
+        }
+        statements.push_back({entry.line, copy ? copy : stmt, nullptr});
+    }
+
+    if (options.optReport) {
+        *scriptErr << "[opt] " << constants.size() << " constants, " << foldedExpressions << " expressions folded, "
+                  << removedBranches << " branches and " << removedStatements << " statements removed" << std::endl;
+    }
+    program.statements = std::move(statements);
+    program.optimized = std::move(code);
+}
+
+// Writes the text of a number held by a function, for comparing it as text.
+static void formatOperand(CondValue& value) {
+    if (!value.unformatted) return;
+    std::string text;
+    formatNumber(value.number, value.integer, text);
+    value.owner = Value(std::move(text));
+    value.text = value.owner.view();
+    value.unformatted = false;
+}
+
+template <typename T>
+static bool applyComparison(CondOp op, const T& left, const T& right) {
+    switch (op) {
+        case CondOp::Eq: return left == right;
+        case CondOp::Ne: return left != right;
+        case CondOp::Ge: return left >= right;
+        case CondOp::Le: return left <= right;
+        case CondOp::Gt: return left > right;
+        case CondOp::Lt: return left < right;
+        default: return false;
+    }
+}
+
+static double arithmetic(CondOp op, double left, double right) {
+    switch (op) {
+        case CondOp::Add: return left + right;
+        case CondOp::Sub: return left - right;
+        case CondOp::Mul: return left * right;
+        case CondOp::Div: return (right != 0) ? left / right : 0;
+        case CondOp::Mod: return std::fmod(left, right);
+        default: return std::pow(left, right);
+    }
+}
+
+EvalResult<double> IornInterpreter::evaluateNumber(CompiledCondition& cond, int idx) {
+    CondNode& node = cond.nodes[idx];
+    
+    switch (node.op) {
+        case CondOp::IntLit:
+        case CondOp::FloatLit:
+            return {node.number};
+        case CondOp::StringLit:
+            if (!node.numericText) return {0, EvalError::NotNumeric, idx};
+            return {node.number};
+        case CondOp::Slot: {
+            const Value* value = resolveSlot(node);
+            double number = 0;
+            if (value == nullptr && resolveArray(node) != nullptr) return {0, recordFailure(EvalError::ArrayValue, node.text), idx};
+            if (value == nullptr) return {0, EvalError::UndeclaredVariable, idx};
+            if (parseNumber(value->view(), number) == NumberForm::None) return {0, EvalError::NotNumeric, idx};
+            return {number};
+        }
+        case CondOp::Local: {
+            const FrameSlot& local = frameSlot(node.local);
+            double number = 0;
+            if (local.isNumber) return {local.number};
+            if (parseNumber(local.text.view(), number) == NumberForm::None) return {0, EvalError::NotNumeric, idx};
+            return {number};
+        }
+        case CondOp::Call: {
+            FrameSlot result;
+            double number = 0;
+            EvalError error = callFunction(cond, idx, result, true);
+            if (error != EvalError::None) return {0, error, idx};
+            if (result.isNumber) return {result.number};
+            if (parseNumber(result.text.view(), number) == NumberForm::None) return {0, EvalError::NotNumeric, idx};
+            return {number};
+        }
+        case CondOp::Neg: {
+            EvalResult<double> operand = evaluateNumber(cond, node.lhs);
+            operand.value = -operand.value;
+            return operand;
+        }
+        case CondOp::Add: case CondOp::Sub: case CondOp::Mul:
+        case CondOp::Div: case CondOp::Mod: case CondOp::Pow: {
+            EvalResult<double> left = evaluateNumber(cond, node.lhs);
+            if (!left) return left;
+            EvalResult<double> right = evaluateNumber(cond, node.rhs);
+            if (!right) return right;
+            return {arithmetic(node.op, left.value, right.value)};
+        }
+        case CondOp::Index:
+        case CondOp::Length: case CondOp::Sum: case CondOp::Min: case CondOp::Max: {
+            EvalResult<ExactNumber> element = evaluateExact(cond, idx);
+            return {element.value.real, element.error, element.node};
+        }
+        case CondOp::List: case CondOp::Range:
+            return {0, recordFailure(EvalError::ArrayValue, node.text), idx};
+        default:
+            return {0, EvalError::InvalidExpression, idx};
+    }
+}
+
+// evaluateNumber() for expressions that read arrays: whole values of
+// numeric elements and integer arithmetic on them stay exact, and only turn
+// into doubles where they meet floating values, division or a power.
+EvalResult<ExactNumber> IornInterpreter::evaluateExact(CompiledCondition& cond, int idx) {
+    CondNode& node = cond.nodes[idx];
+    EvalResult<ExactNumber> result;
+    switch (node.op) {
+        case CondOp::Neg:
+            result = evaluateExact(cond, node.lhs);
+            result.value.real = -result.value.real;
+            result.value.integer = -result.value.integer;
+            return result;
+        case CondOp::Add: case CondOp::Sub: case CondOp::Mul:
+        case CondOp::Div: case CondOp::Mod: case CondOp::Pow: {
+            EvalResult<ExactNumber> left = evaluateExact(cond, node.lhs);
+            if (!left) return left;
+            EvalResult<ExactNumber> right = evaluateExact(cond, node.rhs);
+            if (!right) return right;
+            long long exact = 0;
+            if (left.value.whole && right.value.whole &&
+                combineIntegers(node.op, &exact, 1, [&left](size_t) { return left.value.integer; },
+                                [&right](size_t) { return right.value.integer; })) {
+                result.value = exactNumber(exact);
+            } else {
+                result.value = exactNumber(arithmetic(node.op, left.value.real, right.value.real));
+            }
+            return result;
+        }
+        case CondOp::Index: {
+            NumberArray* array = resolveArray(node);
+            if (array == nullptr) {
+                return {{}, recordFailure(lookup(node.text) ? EvalError::NotArray : EvalError::UndeclaredVariable, node.text), idx};
+            }
+            EvalResult<double> index = evaluateNumber(cond, node.lhs);
+            if (!index) return {{}, index.error, index.node};
+            // The index may call a function that changes the array.
+            if (!(index.value >= 0 && index.value < static_cast<double>(array->size())) || index.value != std::trunc(index.value)) {
+                return {{}, recordFailure(EvalError::IndexOutOfRange, node.text), idx};
+            }
+            size_t position = static_cast<size_t>(index.value);
+            if (array->integer) return {exactNumber(array->integers[position])};
+            return {exactNumber(array->reals[position])};
+        }
+        case CondOp::Length: case CondOp::Sum: case CondOp::Min: case CondOp::Max:
+            return evaluateAggregate(cond, idx);
+        default:
+            break;
+    }
+    // Integer operands of the arithmetic above keep their 64 bits too.
+    FrameSlot called;
+    const FrameSlot* slot = nullptr;
+    switch (node.op) {
+        case CondOp::IntLit:
+            if (parseExact(node.text, result.value) == NumberForm::Integer) return result;
+            break;
+        case CondOp::Slot:
+            if (const Value* value = resolveSlot(node)) {
+                if (parseExact(value->view(), result.value) != NumberForm::None) return result;
+            }
+            break;
+        case CondOp::Local:
+            slot = &frameSlot(node.local);
+            break;
+        case CondOp::Call: {
+            EvalError error = callFunction(cond, idx, called, true);
+            if (error != EvalError::None) return {{}, error, idx};
+            slot = &called;
+            break;
+        }
+        default:
+            break;
+    }
+    if (slot == nullptr) {
+        EvalResult<double> number = evaluateNumber(cond, idx);
+        return {exactNumber(number.value), number.error, number.node};
+    }
+    if (slot->isNumber) {
+        result.value = slot->integer && isRepresentable(slot->number, true) ? exactNumber(static_cast<long long>(slot->number))
+                                                                            : exactNumber(slot->number);
+        return result;
+    }
+    if (parseExact(slot->text.view(), result.value) == NumberForm::None) return {{}, EvalError::NotNumeric, idx};
+    return result;
+}
+
+CondValue IornInterpreter::evaluateOperand(CompiledCondition& cond, int idx) {
+    CondNode& node = cond.nodes[idx];
+    CondValue value{false, 0, node.text, Value(), false, false};
+    
+    switch (node.op) {
+        case CondOp::Slot: {
+            // An undeclared name compares as its own text, as it always has.
+            const Value* slot = resolveSlot(node);
+            if (slot != nullptr) {
+                value.text = slot->view();
+                value.numeric = parseNumber(value.text, value.number) != NumberForm::None;
+            } else if (resolveArray(node) != nullptr) {
+                recordFailure(EvalError::ArrayValue, node.text);
+            }
+            return value;
+        }
+        case CondOp::Local:
+        case CondOp::Call: {
+            FrameSlot result;
+            if (node.op == CondOp::Call && callFunction(cond, idx, result, true) != EvalError::None) {
+                value.text = std::string_view();
+                return value;
+            }
+            // A local's text stays valid: only statements of its own frame change it.
+            const FrameSlot& source = (node.op == CondOp::Local) ? frameSlot(node.local) : result;
+            if (source.isNumber) {
+                value.numeric = value.unformatted = true;
+                value.number = source.number;
+                value.integer = source.integer;
+                return value;
+            }
+            if (node.op == CondOp::Call) value.owner = std::move(result.text);
+            value.text = (node.op == CondOp::Call) ? value.owner.view() : source.text.view();
+            value.numeric = parseNumber(value.text, value.number) != NumberForm::None;
+            return value;
+        }
+        case CondOp::BoolLit:
+            return value;
+        case CondOp::Eq: case CondOp::Ne: case CondOp::Ge: case CondOp::Le:
+        case CondOp::Gt: case CondOp::Lt: case CondOp::And: case CondOp::Or: case CondOp::Not:
+            value.text = evaluateBool(cond, idx) ? "TRUE" : "FALSE";
+            return value;
+        default: {
+            EvalResult<double> number = evaluateNumber(cond, idx);
+            value.numeric = static_cast<bool>(number);
+            value.number = number.value;
+            return value;
+        }
+    }
+}
+
+bool IornInterpreter::evaluateBool(CompiledCondition& cond, int idx) {
+    CondNode& node = cond.nodes[idx];
+    
+    switch (node.op) {
+        case CondOp::BoolLit:
+            return node.number != 0;
+        case CondOp::Slot: {
+            const Value* value = resolveSlot(node);
+            return value != nullptr && *value == "TRUE";
+        }
+        case CondOp::Local: {
+            const FrameSlot& local = frameSlot(node.local);
+            return !local.isNumber && local.text == "TRUE";
+        }
+        case CondOp::Call: {
+            FrameSlot result;
+            return callFunction(cond, idx, result, true) == EvalError::None && !result.isNumber && result.text == "TRUE";
+        }
+        case CondOp::Not:
+            return !evaluateBool(cond, node.lhs);
+        case CondOp::And:
+            return evaluateBool(cond, node.lhs) && evaluateBool(cond, node.rhs);
+        case CondOp::Or:
+            return evaluateBool(cond, node.lhs) || evaluateBool(cond, node.rhs);
+        case CondOp::Eq: case CondOp::Ne: case CondOp::Ge:
+        case CondOp::Le: case CondOp::Gt: case CondOp::Lt: {
+            const CondNode& lhs = cond.nodes[node.lhs];
+            const CondNode& rhs = cond.nodes[node.rhs];
+            // Array elements are compared exactly; without calls, a side that
+            // is not a number is simply evaluated again below.
+            if ((lhs.arrays || rhs.arrays) && !lhs.calls && !rhs.calls) {
+                EvalResult<ExactNumber> left = evaluateExact(cond, node.lhs);
+                EvalResult<ExactNumber> right = left ? evaluateExact(cond, node.rhs) : left;
+                if (left && right && left.value.whole && right.value.whole) {
+                    return applyComparison(node.op, left.value.integer, right.value.integer);
+                }
+                if (left && right) return applyComparison(node.op, left.value.real, right.value.real);
+            }
+            CondValue left = evaluateOperand(cond, node.lhs);
+            // A function called on the right may rename the variable on the left.
+            if (cond.nodes[node.rhs].calls && !left.numeric && !left.owner.view().data()) {
+                left.owner = Value(left.text);
+                left.text = left.owner.view();
+            }
+            CondValue right = evaluateOperand(cond, node.rhs);
+            if (left.numeric && right.numeric) {
+                return applyComparison(node.op, left.number, right.number);
+            }
+            formatOperand(left);
+            formatOperand(right);
+            return applyComparison(node.op, left.text, right.text);
+        }
+        default:
+            return false;
+    }
+}
+
+// Evaluates a value of a declared type: an argument, a return value or the
+// initialiser of a variable. Numbers are truncated for `numeric`.
+EvalResult<FrameSlot> IornInterpreter::evaluateAs(std::string_view type, CompiledCondition& cond, int idx) {
+    EvalResult<FrameSlot> result;
+    CondNode& node = cond.nodes[idx];
+    if (type == "numeric" || type == "floating") {
+        bool integer = type == "numeric";
+        if (integer && node.arrays) {
+            // Kept as text past 2^53, where the double would round it.
+            EvalResult<ExactNumber> exact = evaluateExact(cond, idx);
+            if (exact && exact.value.whole && static_cast<long long>(exact.value.real) != exact.value.integer) {
+                result.value.setText(Value(std::to_string(exact.value.integer)));
+                return result;
+            }
+            if (exact && !isRepresentable(exact.value.real, true)) exact.error = EvalError::OutOfRange;
+            if (!exact) {
+                result.error = exact.error;
+                result.node = exact.node;
+                return result;
+            }
+            result.value.setNumber(std::trunc(exact.value.real), true);
+            return result;
+        }
+        EvalResult<double> number = evaluateNumber(cond, idx);
+        if (number && !isRepresentable(number.value, integer)) {
+            number.error = EvalError::OutOfRange;
+        }
+        if (!number) {
+            result.error = number.error;
+            result.node = number.node;
+            return result;
+        }
+        result.value.setNumber(integer ? std::trunc(number.value) : number.value, integer);
+        return result;
+    }
+
+    if (node.op == CondOp::Local) {
+        result.value = frameSlot(node.local);
+    } else if (node.op == CondOp::Slot) {
+        const Value* value = resolveSlot(node);
+        if (value == nullptr) {
+            result.error = EvalError::UndeclaredVariable;
+            result.node = idx;
+            return result;
+        }
+        result.value.setText(*value);
+    } else {
+        CondValue value = evaluateOperand(cond, idx);
+        if (callFailure.kind != EvalError::None) {
+            result.error = callFailure.kind;
+            result.node = idx;
+            return result;
+        }
+        formatOperand(value);
+        result.value.setText(value.owner.view().data() == value.text.data() ? std::move(value.owner) : Value(value.text));
+    }
+    if (type == "boolean" && (result.value.isNumber || (result.value.text != "TRUE" && result.value.text != "FALSE"))) {
+        result.error = EvalError::NotBoolean;
+        result.node = idx;
+    }
+    return result;
+}
+
+// Calls the function of the Call node `idx`. The arguments are evaluated in
+// the caller's frame straight into the callee's, which is pushed first so
+// that calls made by the arguments push their frames above it. A failure is
+// also kept in callFailure for executeStatement() to report.
+EvalError IornInterpreter::callFunction(CompiledCondition& cond, int idx, FrameSlot& result, bool needValue) {
+    CondNode& node = cond.nodes[idx];
+    auto fail = [&](EvalError kind, std::string_view source = {}, std::string_view operand = {}, std::string_view expected = {}) {
+        if (callFailure.kind == EvalError::None) {
+            callFailure = {kind, 0, source, operand, expected};
+        }
+        return kind;
+    };
+    if (node.callee == nullptr && functionCode != nullptr) {
+        auto it = functionCode->byName.find(node.text);
+        if (it != functionCode->byName.end()) node.callee = it->second;
+    }
+    const Function* function = node.callee;
+    if (function == nullptr) return fail(EvalError::UnknownFunction, {}, node.text);
+    if (needValue && function->returnType.empty()) return fail(EvalError::NoValue, {}, function->name);
+    if (callDepth >= maxCallDepth) return fail(EvalError::CallDepth, {}, function->name);
+
+    size_t base = frames.size();
+    frames.resize(base + function->frameSize);
+    size_t count = 0;
+    int arg = node.lhs;
+    EvalError error = EvalError::None;
+    for (; arg >= 0 && count < function->parameters.size(); arg = cond.nodes[arg].rhs, count++) {
+        const Parameter& parameter = function->parameters[count];
+        EvalResult<FrameSlot> value = evaluateAs(parameter.type, cond, cond.nodes[arg].lhs);
+        if (value) {
+            frames[base + count] = std::move(value.value);
+            continue;
+        }
+        error = (callFailure.kind != EvalError::None) ? callFailure.kind
+              : (value.error == EvalError::UndeclaredVariable) ? fail(value.error, {}, cond.nodes[value.node].text)
+              : fail(EvalError::ArgumentType, function->name, parameter.name, parameter.type);
+        break;
+    }
+    if (error == EvalError::None && (arg >= 0 || count != function->parameters.size())) {
+        error = fail(EvalError::ArgumentCount, {}, function->name, function->signature);
+    }
+    if (error != EvalError::None) {
+        frames.resize(base);
+        return error;
+    }
+
+    size_t callerBase = frameBase;
+    const Function* caller = currentFunction;
+    frameBase = base;
+    currentFunction = function;
+    callDepth++;
+    size_t errors = errorCount;
+    ExecutionBudget& budget = *ExecutionBudget::current();
+    for (const ProgramEntry& entry : function->body) {
+        executeStatement(*entry.statement, entry.line);
+        if (returning || errorCount != errors || budget.exhausted() || memoryLimitExceeded()) break;
+    }
+    bool returned = returning;
+    returning = false;
+    callDepth--;
+    currentFunction = caller;
+    frameBase = callerBase;
+    frames.resize(base);
+
+    if (errorCount != errors || budget.exhausted() || memoryLimitExceeded()) return fail(EvalError::Reported);
+    if (!returned) {
+        return needValue ? fail(EvalError::MissingReturn, {}, function->name) : EvalError::None;
+    }
+    result = std::move(returnValue);
+    return EvalError::None;
+}
+
+bool IornInterpreter::isArrayValued(CompiledCondition& cond, int idx) {
+    CondNode& node = cond.nodes[idx];
+    switch (node.op) {
+        case CondOp::Slot:
+            return resolveArray(node) != nullptr;
+        case CondOp::List: case CondOp::Range:
+            return true;
+        case CondOp::Neg:
+            return isArrayValued(cond, node.lhs);
+        case CondOp::Add: case CondOp::Sub: case CondOp::Mul:
+        case CondOp::Div: case CondOp::Mod: case CondOp::Pow:
+            return isArrayValued(cond, node.lhs) || isArrayValued(cond, node.rhs);
+        default:
+            return false;
+    }
+}
+
+// Evaluates an array-valued expression a whole array at a time. Arithmetic
+// on two arrays pairs their elements, which needs equal lengths; a single
+// value on either side applies to every element. Numeric elements stay
+// integers through negation, +, -, * and % unless a result overflows; other
+// operators and floating operands give floating elements, and so does
+// everything when `floating` is set, for a `floating[]` destination.
+EvalResult<NumberArray> IornInterpreter::evaluateArray(CompiledCondition& cond, int idx, bool floating) {
+    static constexpr double maxRangeLength = 1 << 26;   // 512 MB of numeric elements
+    CondNode& node = cond.nodes[idx];
+    EvalResult<NumberArray> result;
+    auto fail = [&](EvalError kind, int at) {
+        result.error = kind;
+        result.node = at;
+        return std::move(result);
+    };
+    NumberArray& values = result.value;
+    if (floating) values.toReals();
+
+    switch (node.op) {
+        case CondOp::Slot: {
+            const NumberArray* array = resolveArray(node);
+            if (array == nullptr) {
+                return fail(recordFailure(lookup(node.text) ? EvalError::NotArray : EvalError::UndeclaredVariable, node.text), idx);
+            }
+            if (floating && array->integer) {
+                values.reals.assign(array->integers.begin(), array->integers.end());
+            } else {
+                values = *array;
+            }
+            return result;
+        }
+        case CondOp::List:
+            for (int arg = node.lhs; arg >= 0; arg = cond.nodes[arg].rhs) {
+                // Whole elements are read exactly rather than through a double.
+                EvalResult<ExactNumber> element = evaluateExact(cond, cond.nodes[arg].lhs);
+                if (!element) return fail(element.error, element.node);
+                double real = element.value.real;
+                if (values.integer && element.value.whole) {
+                    values.integers.push_back(element.value.integer);
+                } else if (values.integer && real == std::trunc(real) && isRepresentable(real, true)) {
+                    values.integers.push_back(static_cast<long long>(real));
+                } else {
+                    values.toReals();
+                    values.reals.push_back(real);
+                }
+            }
+            return result;
+        case CondOp::Range: {
+            EvalResult<double> count = evaluateNumber(cond, node.lhs);
+            if (!count) return fail(count.error, count.node);
+            if (!(count.value >= 0 && count.value <= maxRangeLength) || count.value != std::trunc(count.value)) {
+                return fail(recordFailure(EvalError::OutOfRange, {}, node.text, "numeric"), idx);
+            }
+            if (floating) {
+                values.reals.resize(static_cast<size_t>(count.value));
+                std::iota(values.reals.begin(), values.reals.end(), 0.0);
+            } else {
+                values.integers.resize(static_cast<size_t>(count.value));
+                std::iota(values.integers.begin(), values.integers.end(), 0ll);
+            }
+            return result;
+        }
+        case CondOp::Neg:
+            result = evaluateArray(cond, node.lhs, floating);
+            for (long long& value : values.integers) value = -value;
+            for (double& value : values.reals) value = -value;
+            return result;
+        case CondOp::Add: case CondOp::Sub: case CondOp::Mul:
+        case CondOp::Div: case CondOp::Mod: case CondOp::Pow: {
+            if (!isArrayValued(cond, node.lhs) && !isArrayValued(cond, node.rhs)) {
+                return fail(recordFailure(EvalError::NotArray, node.text), idx);
+            }
+            // Array variables are read in place; the left one is copied when
+            // the right side calls a function, which may change it.
+            NumberArray computed[2];
+            const NumberArray* operands[2] = {nullptr, nullptr};
+            double scalars[2] = {0, 0};
+            long long integerScalars[2] = {0, 0};
+            bool wholeScalars[2] = {false, false};
+            int sides[2] = {node.lhs, node.rhs};
+            for (int side = 0; side < 2; side++) {
+                CondNode& operand = cond.nodes[sides[side]];
+                if (!isArrayValued(cond, sides[side])) {
+                    EvalResult<ExactNumber> number = evaluateExact(cond, sides[side]);
+                    if (!number) return fail(number.error, number.node);
+                    double real = number.value.real;
+                    scalars[side] = real;
+                    wholeScalars[side] = number.value.whole || (real == std::trunc(real) && isRepresentable(real, true));
+                    integerScalars[side] = number.value.whole ? number.value.integer : wholeScalars[side] ? static_cast<long long>(real) : 0;
+                } else if (operand.op == CondOp::Slot && (side == 1 || !cond.nodes[node.rhs].calls)) {
+                    operands[side] = resolveArray(operand);
+                } else {
+                    EvalResult<NumberArray> array = evaluateArray(cond, sides[side], floating);
+                    if (!array) {
+                        // A failure in an unnamed inner link of a chain is named after the chain.
+                        if (callFailure.kind == EvalError::LengthMismatch && callFailure.operand.empty()) {
+                            callFailure.operand = node.text;
+                        }
+                        return array;
+                    }
+                    computed[side] = std::move(array.value);
+                    operands[side] = &computed[side];
+                }
+            }
+            if (operands[0] && operands[1] && operands[0]->size() != operands[1]->size()) {
+                return fail(recordFailure(EvalError::LengthMismatch, node.text), idx);
+            }
+
+            // A computed operand is overwritten with the result.
+            size_t count = (operands[0] ? operands[0] : operands[1])->size();
+            NumberArray* reuse = operands[0] == &computed[0] ? &computed[0] : operands[1] == &computed[1] ? &computed[1] : nullptr;
+            auto whole = [&](int side) { return operands[side] ? operands[side]->integer : wholeScalars[side]; };
+            bool integer = !floating && whole(0) && whole(1) &&
+                           (node.op == CondOp::Add || node.op == CondOp::Sub || node.op == CondOp::Mul || node.op == CondOp::Mod);
+            if (integer) {
+                NumberArray& out = reuse ? *reuse : values;
+                out.integers.resize(count);
+                bool exact = visitIntegers(operands[0], integerScalars[0], [&](auto left) {
+                    return visitIntegers(operands[1], integerScalars[1], [&](auto right) {
+                        return combineIntegers(node.op, out.integers.data(), count, left, right);
+                    });
+                });
+                if (exact) {
+                    if (reuse) values = std::move(*reuse);
+                    return result;
+                }
+            }
+            if (reuse && reuse->integer) reuse = nullptr;
+            NumberArray& out = reuse ? *reuse : values;
+            out.integer = false;
+            out.reals.resize(count);
+            visitElements(operands[0], scalars[0], [&](auto left) {
+                visitElements(operands[1], scalars[1], [&](auto right) {
+                    combineReals(node.op, out.reals.data(), count, left, right);
+                });
+            });
+            if (reuse) values = std::move(*reuse);
+            values.integers.clear();
+            values.integers.shrink_to_fit();
+            return result;
+        }
+        default:
+            return fail(recordFailure(EvalError::NotArray, node.text), idx);
+    }
+}
+
+// length, sum, min and max. An array variable is read in place, anything
+// else is computed first; either way the elements keep their own type. Results from numeric elements
+// are exact, with a floating sum alongside to catch overflow.
+EvalResult<ExactNumber> IornInterpreter::evaluateAggregate(CompiledCondition& cond, int idx) {
+    CondNode& node = cond.nodes[idx];
+    CondNode& argument = cond.nodes[node.lhs];
+    const NumberArray* array = argument.op == CondOp::Slot ? resolveArray(argument) : nullptr;
+    EvalResult<NumberArray> computed;
+    if (array == nullptr) {
+        computed = evaluateArray(cond, node.lhs, false);
+        if (!computed) return {{}, computed.error, computed.node};
+        array = &computed.value;
+    }
+    size_t count = array->size();
+    if (node.op == CondOp::Length) return {exactNumber(static_cast<long long>(count))};
+    if (node.op != CondOp::Sum && count == 0) return {{}, recordFailure(EvalError::EmptyArray, node.text), idx};
+
+    auto add = [](auto a, auto b) { return a + b; };
+    auto lower = [](auto a, auto b) { return b < a ? b : a; };
+    auto higher = [](auto a, auto b) { return a < b ? b : a; };
+    if (array->integer) {
+        const long long* data = array->integers.data();
+        if (node.op == CondOp::Min) return {exactNumber(reduceLanes(data, count, data[0], lower))};
+        if (node.op == CondOp::Max) return {exactNumber(reduceLanes(data, count, data[0], higher))};
+        // Unsigned lanes wrap around instead of overflowing.
+        unsigned long long exact = reduceLanes(reinterpret_cast<const unsigned long long*>(data), count, 0ull, add);
+        if (!isRepresentable(reduceLanes(data, count, 0.0, add), true)) {
+            return {{}, recordFailure(EvalError::OutOfRange, {}, node.text, "numeric"), idx};
+        }
+        return {exactNumber(static_cast<long long>(exact))};
+    }
+    const double* data = array->reals.data();
+    switch (node.op) {
+        case CondOp::Min: return {exactNumber(reduceLanes(data, count, data[0], lower))};
+        case CondOp::Max: return {exactNumber(reduceLanes(data, count, data[0], higher))};
+        default: return {exactNumber(reduceLanes(data, count, 0.0, add))};
+    }
+}
+
+// Reads a whole array from one line of input: numbers separated by spaces or
+// commas. Like executeInput(), asks again while the line is not valid.
+bool IornInterpreter::executeArrayInput(std::string_view prompt, NumberArray& array) {
+    std::string input;
+    while (executeInput(prompt, "string", input)) {
+        std::string_view text = input;
+        array.integers.clear();
+        array.reals.clear();
+        bool valid = true;
+        for (size_t pos = text.find_first_not_of(" \t,"); valid && pos != std::string_view::npos;
+             pos = text.find_first_not_of(" \t,", pos)) {
+            size_t end = std::min(text.find_first_of(" \t,", pos), text.length());
+            double number = 0;
+            NumberForm form = parseNumber(text.substr(pos, end - pos), number);
+            valid = (form == NumberForm::Integer || (form == NumberForm::Decimal && !array.integer)) &&
+                    isRepresentable(number, array.integer);
+            if (array.integer) {
+                // Read again as an integer, exact beyond the 2^53 a double holds.
+                long long exact = 0;
+                if (valid) std::from_chars(text.data() + pos, text.data() + end, exact);
+                array.integers.push_back(exact);
+            } else {
+                array.reals.push_back(number);
+            }
+            pos = end;
+        }
+        if (valid) return true;
+        setRedColor();
+        *scriptErr << (array.integer ? "Error: Please enter integer numbers separated by spaces or commas."
+                                     : "Error: Please enter numbers separated by spaces or commas.") << std::endl;
+        resetColor();
+    }
+    return false;
+}
+
+// False when the run's budget stops it before a valid value is read: input
+// ran out, the read limit was reached or the deadline passed while waiting.
+bool IornInterpreter::executeInput(std::string_view prompt, std::string_view expectedType, std::string& input) {
+    ExecutionBudget& budget = *ExecutionBudget::current();
+    while (true) {
+        if (!budget.read()) {
+            return false;
+        }
+        if (!prompt.empty()) {
+            *scriptOut << prompt << std::flush;
+        }
+        
+#ifdef _WIN32
+        // Для Windows читаем через широкие символы
+        wchar_t wbuffer[1024];
+        DWORD charsRead;
+        HANDLE hStdin = GetStdHandle(STD_INPUT_HANDLE);
+        DWORD consoleMode;
+        int waitMs = budget.remainingMs();
+        if (!GetConsoleMode(hStdin, &consoleMode)) {
+            // Redirected input is read as bytes; the deadline cannot end a read that is waiting.
+            if (!std::getline(std::cin, input)) {
+                budget.inputEnded = true;
+                return budget.stop(RunStatus::InputLimit);
+            }
+        } else if (waitMs >= 0 && WaitForSingleObject(hStdin, static_cast<DWORD>(waitMs)) == WAIT_TIMEOUT) {
+            return budget.stop(RunStatus::Timeout);
+        } else if (ReadConsoleW(hStdin, wbuffer, sizeof(wbuffer)/sizeof(wchar_t) - 1, &charsRead, NULL)) {
+            wbuffer[charsRead] = L'\0';
+            // Убираем \r\n в конце
+            std::wstring winput(wbuffer);
+            while (!winput.empty() && (winput.back() == L'\r' || winput.back() == L'\n')) {
+                winput.pop_back();
+            }
+            // Преобразуем в UTF-8
+            if (!winput.empty()) {
+                int size_needed = WideCharToMultiByte(CP_UTF8, 0, winput.c_str(), (int)winput.size(), NULL, 0, NULL, NULL);
+                input.resize(size_needed);
+                WideCharToMultiByte(CP_UTF8, 0, winput.c_str(), (int)winput.size(), &input[0], size_needed, NULL, NULL);
+            } else {
+                input = "";
+            }
+        } else {
+            // A console that cannot be read ends input like the end of a file.
+            budget.inputEnded = true;
+            return budget.stop(RunStatus::InputLimit);
+        }
+#else
+        InputReader::Result result = scriptInput->readLine(input, budget);
+        if (result == InputReader::Result::TimedOut) {
+            return budget.stop(RunStatus::Timeout);
+        }
+        if (result == InputReader::Result::End) {
+            budget.inputEnded = true;
+            return budget.stop(RunStatus::InputLimit);
+        }
+        if (result == InputReader::Result::TooLong) {
+            budget.lineTooLong = true;
+            return budget.stop(RunStatus::InputLimit);
+        }
+#endif
+        
+        // Убираем возможные символы \r в конце строки
+        if (!input.empty() && input.back() == '\r') {
+            input.pop_back();
+        }
+        
+        // Для строкового типа принимаем любой ввод
+        if (expectedType == "string") {
+            break;
+        }
+        
+        double number;
+        if (expectedType == "numeric") {
+            if (parseNumber(input, number) == NumberForm::Integer) {
+                break;
+            } else {
+                setRedColor();
+                *scriptErr << "Error: Please enter a valid integer number." << std::endl;
+                resetColor();
+            }
+        } else if (expectedType == "floating") {
+            if (parseNumber(input, number) == NumberForm::Decimal) {
+                break;
+            } else {
+                setRedColor();
+                *scriptErr << "Error: Please enter a valid floating point number (e.g., 1.5)." << std::endl;
+                resetColor();
+            }
+        } else if (expectedType == "boolean") {
+            if (input == "TRUE" || input == "FALSE" || input == "true" || input == "false") {
+                if (input == "true") input = "TRUE";
+                if (input == "false") input = "FALSE";
+                break;
+            } else {
+                setRedColor();
+                *scriptErr << "Error: Please enter TRUE/FALSE or true/false." << std::endl;
+                resetColor();
+            }
+        } else {
+            // Для всех остальных типов тоже принимаем ввод
+            break;
+        }
+    }
+    return true;
+}
+
+void IornInterpreter::executePrint(const std::pmr::vector<TextPart>& parts) {
+    // Modules providing imported symbols run first, so their output does not
+    // land in the middle of this line.
+    if (!imports.empty()) {
+        for (const TextPart& part : parts) {
+            if (part.isVariable && part.local < 0) lookup(part.text);
+        }
+    }
+    // Parts are written straight to the stream; no output string is built.
+    for (const TextPart& part : parts) {
+        if (part.isVariable) {
+            if (const Value* found = partValue(part)) {
+                std::string_view value = found->view();
+                scriptOut->write(value.data(), static_cast<std::streamsize>(value.length()));
+                continue;
+            }
+            if (auto array = arrays.find(part.text); part.local < 0 && array != arrays.end()) {
+                std::string text;
+                formatArray(array->second, text);
+                *scriptOut << text;
+                continue;
+            }
+            *scriptOut << "$[" << part.text << "]";
+        } else {
+            *scriptOut << part.text;
+        }
+    }
+    *scriptOut << std::endl;
+}
+
+// Value of a variable part, local to the running function or not.
+const Value* IornInterpreter::partValue(const TextPart& part) {
+    return part.local >= 0 ? &frameSlot(part.local).value() : lookup(part.text);
+}
+
+// Stores the value of a declaration or rename.
+void IornInterpreter::assign(const Statement& stmt, Value value) {
+    if (stmt.local >= 0) {
+        frameSlot(stmt.local).setText(std::move(value));
+    } else {
+        variable(stmt.name) = std::move(value);
+    }
+}
+
+// Converts computed elements to the type of `array`; floating elements
+// stored as numeric ones are truncated. False if an element cannot be stored.
+static bool storeElements(NumberArray& values, NumberArray& array) {
+    bool representable = true;
+    if (!array.integer) {
+        values.toReals();
+        for (double value : values.reals) representable &= isRepresentable(value, false);
+        array.reals = std::move(values.reals);
+        return representable;
+    }
+    if (values.integer) {
+        array.integers = std::move(values.integers);
+        return true;
+    }
+    array.integers.resize(values.reals.size());
+    for (size_t i = 0; i < values.reals.size(); i++) {
+        bool fits = isRepresentable(values.reals[i], true);
+        representable &= fits;
+        array.integers[i] = fits ? static_cast<long long>(values.reals[i]) : 0;
+    }
+    return representable;
+}
+
+// Declaration or rename of a whole array. Arrays belong to the script, so
+// functions can change them but not declare them.
+void IornInterpreter::assignArray(const Statement& stmt, int lineNum) {
+    std::string line = std::to_string(lineNum);
+    if (stmt.kind == StmtKind::Declare) {
+        if (currentFunction != nullptr) {
+            printError("Error: Arrays cannot be declared inside a function on line " + line + ".");
+            return;
+        }
+        if (!validateVariable(stmt.name, stmt.type, stmt.value, lineNum, false)) {
+            return;
+        }
+    } else if (arrays.find(stmt.name) == arrays.end()) {
+        printError("Variable '" + std::string(stmt.name) + "' does not exist for rename on line " + line + ".");
+        return;
+    }
+
+    NumberArray result;
+    result.integer = stmt.type == "numeric[]";
+    if (stmt.isInput) {
+        if (!executeArrayInput(stmt.prompt, result)) return;
+    } else {
+        CompiledCondition& expression = *stmt.expression;
+        if (expression.root < 0) {
+            printError("Invalid array value '" + std::string(stmt.literal) + "' on line " + line + ".");
+            return;
+        }
+        std::string_view elementType = result.integer ? "numeric" : "floating";
+        EvalResult<NumberArray> values = evaluateArray(expression, expression.root, !result.integer);
+        if (!values) {
+            std::string_view operand = values.node >= 0 ? std::string_view(expression.nodes[values.node].text) : std::string_view();
+            reportDiagnostic({values.error, lineNum, stmt.literal, operand, elementType});
+            return;
+        }
+        if (!storeElements(values.value, result)) {
+            reportDiagnostic({EvalError::OutOfRange, lineNum, stmt.literal, {}, elementType});
+            return;
+        }
+    }
+    auto it = arrays.find(stmt.name);
+    if (it == arrays.end()) {
+        it = arrays.emplace(std::piecewise_construct, std::forward_as_tuple(stmt.name), std::forward_as_tuple()).first;
+    }
+    it->second = std::move(result);
+}
+
+// rename variable name[index] type = value;  -- the type is the element type.
+void IornInterpreter::assignElement(const Statement& stmt, int lineNum) {
+    std::string line = std::to_string(lineNum);
+    auto it = arrays.find(stmt.name);
+    if (it == arrays.end()) {
+        printError(lookup(stmt.name) ? "'" + std::string(stmt.name) + "' is not an array on line " + line + "."
+                                     : "Variable '" + std::string(stmt.name) + "' does not exist for rename on line " + line + ".");
+        return;
+    }
+    std::string_view elementType = it->second.integer ? "numeric" : "floating";
+    if (stmt.type != elementType) {
+        printError("Array '" + std::string(stmt.name) + "' holds " + std::string(elementType) + " values on line " + line + ".");
+        return;
+    }
+
+    CompiledCondition& indexExpression = *stmt.index;
+    EvalResult<double> index = indexExpression.root < 0 ? EvalResult<double>{0, EvalError::InvalidExpression}
+                                                        : evaluateNumber(indexExpression, indexExpression.root);
+    if (!index) {
+        if (callFailure.kind == EvalError::None) printError("Error: Invalid array index on line " + line + ".");
+        return;
+    }
+
+    ExactNumber value;
+    if (stmt.isInput) {
+        std::string input;
+        if (!executeInput(stmt.prompt, stmt.type, input)) return;
+        parseExact(input, value);
+    } else if (stmt.expression) {
+        CompiledCondition& expression = *stmt.expression;
+        EvalResult<FrameSlot> result = expression.root < 0 ? EvalResult<FrameSlot>{{}, EvalError::InvalidExpression}
+                                                           : evaluateAs(stmt.type, expression, expression.root);
+        if (!result) {
+            std::string_view operand = result.node >= 0 ? std::string_view(expression.nodes[result.node].text) : std::string_view();
+            reportDiagnostic({result.error, lineNum, stmt.literal, operand, stmt.type});
+            return;
+        }
+        if (result.value.isNumber) {
+            value = exactNumber(result.value.number);
+        } else {
+            parseExact(result.value.text.view(), value);
+        }
+    } else {
+        std::string message;
+        if (!checkVariableValue(stmt.type, stmt.value, lineNum, message)) {
+            printError(message);
+            return;
+        }
+        parseExact(stmt.literal, value);
+    }
+
+    // Checked last: computing the value may have resized the array.
+    NumberArray& array = it->second;
+    if (!(index.value >= 0 && index.value < static_cast<double>(array.size())) || index.value != std::trunc(index.value)) {
+        reportDiagnostic({EvalError::IndexOutOfRange, lineNum, stmt.literal, stmt.name, {}});
+        return;
+    }
+    size_t position = static_cast<size_t>(index.value);
+    if (array.integer) {
+        array.integers[position] = value.whole ? value.integer : static_cast<long long>(value.real);
+    } else {
+        array.reals[position] = value.real;
+    }
+}
+
+// Every variable operand must exist; executeStatement checks that first.
+Value IornInterpreter::evaluateConcatenation(const Statement& stmt) {
+    auto operand = [&](const TextPart& part) -> std::string_view {
+        return part.isVariable ? partValue(part)->view() : part.text;
+    };
+    
+    // Copying a variable's value shares its buffer, so appending to the copy
+    // extends that buffer in place instead of copying the text.
+    Value result = stmt.concat.front().isVariable ? *partValue(stmt.concat.front())
+                                                  : Value(stmt.concat.front().text);
+    for (size_t i = 1; i < stmt.concat.size(); i++) {
+        result.append(operand(stmt.concat[i]));
+    }
+    return result;
+}
+
+// Print\((f?"[^"]*")\);  -- the argument at `pos`, or empty.
+static std::string_view matchPrintCall(std::string_view text, size_t& pos) {
+    for (; (pos = text.find("Print(", pos)) != std::string_view::npos; pos++) {
+        size_t arg = pos + 6;
+        size_t quote = (arg < text.length() && text[arg] == 'f') ? arg + 1 : arg;
+        if (quote >= text.length() || text[quote] != '"') continue;
+        size_t close = text.find('"', quote + 1);
+        if (close == std::string_view::npos || text.compare(close + 1, 2, ");") != 0) continue;
+        pos = close + 3;
+        return text.substr(arg, close + 1 - arg);
+    }
+    return std::string_view();
+}
+
+// ([a-zA-Z_]\w*)\(([^)]*)\);  -- every called name that is not built in.
+static void findCalls(std::string_view text, std::pmr::vector<std::string_view>& calls) {
+    size_t searchFrom = 0;
+    for (size_t open = text.find('('); open != std::string_view::npos; open = text.find('(', open + 1)) {
+        size_t nameStart = open;
+        while (nameStart > searchFrom && isWordChar(text[nameStart - 1])) nameStart--;
+        while (nameStart < open && !std::isalpha(static_cast<unsigned char>(text[nameStart])) && text[nameStart] != '_') nameStart++;
+        if (nameStart == open) continue;
+        size_t close = text.find(')', open + 1);
+        if (close == std::string_view::npos || close + 1 >= text.length() || text[close + 1] != ';') continue;
+        std::string_view name = text.substr(nameStart, open - nameStart);
+        if (name != "Print" && name != "input" && !isArrayBuiltin(name)) calls.push_back(name);
+        searchFrom = close + 2;
+        open = close + 1;
+    }
+}
+
+// input\(("[^"]*"|[^)]*)\)  -- the prompt as written, or false.
+static bool matchInputCall(std::string_view text, std::string_view& prompt) {
+    for (size_t pos = 0; (pos = text.find("input(", pos)) != std::string_view::npos; pos++) {
+        size_t arg = pos + 6;
+        if (arg < text.length() && text[arg] == '"') {
+            size_t close = text.find('"', arg + 1);
+            if (close != std::string_view::npos && close + 1 < text.length() && text[close + 1] == ')') {
+                prompt = text.substr(arg, close + 1 - arg);
+                return true;
+            }
+        }
+        size_t close = text.find(')', arg);
+        if (close != std::string_view::npos) {
+            prompt = text.substr(arg, close - arg);
+            return true;
+        }
+    }
+    return false;
+}
+
+// <keyword>\s+(\w+)\s+NULL;  or, when `type` is non-null,
+// <keyword>\s+(\w+)\s+(string|numeric|floating|boolean|numeric\[\]|floating\[\])\s*=\s*([^;]+);
+// When `index` is non-null the name may be followed by `[index]`.
+static bool matchDeclaration(std::string_view text, std::string_view keyword, std::string_view& name,
+                             std::string_view* type, std::string_view* value, std::string_view* index = nullptr) {
+    static const std::string_view types[] = {"string", "numeric[]", "numeric", "floating[]", "floating", "boolean"};
+    for (size_t pos = 0; (pos = text.find(keyword, pos)) != std::string_view::npos; pos++) {
+        size_t nameStart = skipSpaces(text, pos + keyword.length());
+        size_t nameEnd = skipWord(text, nameStart);
+        size_t typeStart = nameEnd;
+        if (index != nullptr) {
+            *index = std::string_view();
+            size_t close = text.find(']', nameEnd);
+            if (nameEnd < text.length() && text[nameEnd] == '[' && close != std::string_view::npos) {
+                *index = trimSpaces(text.substr(nameEnd + 1, close - nameEnd - 1));
+                if (index->empty()) continue;
+                typeStart = close + 1;
+            }
+        }
+        size_t next = skipSpaces(text, typeStart);
+        if (nameStart == pos + keyword.length() || nameEnd == nameStart || next == typeStart) continue;
+        name = text.substr(nameStart, nameEnd - nameStart);
+
+        if (type == nullptr) {
+            if (text.compare(next, 5, "NULL;") == 0) return true;
+            continue;
+        }
+        for (std::string_view candidate : types) {
+            if (text.compare(next, candidate.length(), candidate) != 0) continue;
+            size_t equals = skipSpaces(text, next + candidate.length());
+            if (equals >= text.length() || text[equals] != '=') break;
+            size_t valueStart = skipSpaces(text, equals + 1);
+            size_t semicolon = text.find(';', valueStart);
+            if (semicolon == std::string_view::npos) break;
+            // "= ;" still matches: \s* gives its last space back to [^;]+.
+            if (semicolon == valueStart) {
+                if (valueStart == equals + 1) break;
+                valueStart--;
+            }
+            *type = candidate;
+            *value = text.substr(valueStart, semicolon - valueStart);
+            return true;
+        }
+    }
+    return false;
+}
+
+static bool isValueType(std::string_view word) {
+    return word == "string" || word == "numeric" || word == "floating" || word == "boolean";
+}
+
+// \s+(\w+)\s*\((\w+\s+TYPE(\s*,\s*\w+\s+TYPE)*)?\)\s*(TYPE)?\s*:  -- from just
+// after `new function`, where TYPE is one of the four value types.
+static bool matchFunctionHeader(std::string_view text, size_t from, std::string_view& name, std::string_view& signature,
+                                std::pmr::vector<Parameter>& parameters, std::string_view& returnType) {
+    size_t nameStart = skipSpaces(text, from);
+    size_t nameEnd = skipWord(text, nameStart);
+    size_t open = skipSpaces(text, nameEnd);
+    size_t close = text.find(')', open);
+    if (nameStart == from || nameEnd == nameStart || !std::isalpha(static_cast<unsigned char>(text[nameStart])) ||
+        open >= text.length() || text[open] != '(' || close == std::string_view::npos) {
+        return false;
+    }
+    name = text.substr(nameStart, nameEnd - nameStart);
+    signature = text.substr(nameStart, close + 1 - nameStart);
+    if (isArrayBuiltin(name)) return false;
+
+    parameters.clear();
+    std::string_view list = trimSpaces(text.substr(open + 1, close - open - 1));
+    while (!list.empty()) {
+        size_t comma = list.find(',');
+        std::string_view item = trimSpaces(list.substr(0, comma));
+        size_t nameLength = skipWord(item, 0);
+        size_t typeStart = skipSpaces(item, nameLength);
+        Parameter parameter{item.substr(0, nameLength), item.substr(typeStart)};
+        if (nameLength == 0 || typeStart == nameLength || !std::isalpha(static_cast<unsigned char>(item[0])) ||
+            !isValueType(parameter.type)) {
+            return false;
+        }
+        for (const Parameter& other : parameters) {
+            if (other.name == parameter.name) return false;
+        }
+        parameters.push_back(parameter);
+        if (comma == std::string_view::npos) break;
+        list = trimSpaces(list.substr(comma + 1));
+        if (list.empty()) return false;
+    }
+
+    size_t typeStart = skipSpaces(text, close + 1);
+    size_t typeEnd = skipWord(text, typeStart);
+    returnType = text.substr(typeStart, typeEnd - typeStart);
+    size_t colon = skipSpaces(text, typeEnd);
+    return (returnType.empty() || isValueType(returnType)) && colon < text.length() && text[colon] == ':' &&
+           skipSpaces(text, colon + 1) == text.length();
+}
+
+void IornInterpreter::parseBlock(std::string_view block, std::pmr::vector<Statement>& body) {
+    std::string_view trimmedBlock = block;
+    size_t first = trimmedBlock.find_first_not_of(" \t\n\r");
+    trimmedBlock = (first == std::string_view::npos) ? std::string_view()
+                 : trimmedBlock.substr(first, trimmedBlock.find_last_not_of(" \t\n\r") - first + 1);
+
+    if (trimmedBlock == "ignore" || trimmedBlock.empty() || trimmedBlock == "ignore;") {
+        return;
+    }
+
+    // Prints and returns, in the order they are written.
+    size_t pos = 0;
+    KeywordMatch ret = findKeyword(block, Keyword::Return);
+    while (true) {
+        size_t printEnd = pos;
+        std::string_view text = matchPrintCall(block, printEnd);
+        size_t printStart = text.empty() ? std::string_view::npos : static_cast<size_t>(text.data() - block.data()) - 6;
+        if (ret && ret.begin < printStart) {
+            body.emplace_back();
+            pos = parseReturn(block, ret.end, body.back());
+            if (pos == std::string_view::npos) {
+                body.pop_back();
+                return;
+            }
+            ret = findKeyword(block, Keyword::Return, pos);
+            continue;
+        }
+        if (text.empty()) return;
+        body.emplace_back();
+        body.back().kind = StmtKind::Print;
+        parsePrintText(text, body.back().parts);
+        pos = printEnd;
+    }
+}
+
+// return\s*([^;]*);  -- from just after the keyword; the value ends at the
+// first ';' outside string literals. Returns the position after the ';', or
+// npos without one.
+size_t IornInterpreter::parseReturn(std::string_view text, size_t from, Statement& stmt) {
+    size_t end = from;
+    for (bool inString = false; end < text.length() && (inString || text[end] != ';'); end++) {
+        if (text[end] == '"') inString = !inString;
+    }
+    if (end >= text.length()) return std::string_view::npos;
+    stmt.kind = StmtKind::Return;
+    stmt.literal = trimSpaces(text.substr(from, end - from));
+    if (!stmt.literal.empty()) {
+        // Which one is used depends on the return type of the function.
+        bool valid;
+        if (splitConcatenation(stmt.literal, stmt.concat, valid) && !valid) stmt.concat.clear();
+        stmt.expression = compileCondition(stmt.literal, CompileMode::Value);
+    }
+    return end + 1;
+}
+
+void IornInterpreter::parseIfStatement(std::string_view cleanCode, Statement& stmt) {
+    // Keywords are only looked for outside string literals, so a Print of
+    // "endif;" does not end the block.
+    KeywordMatch ifWord = findKeyword(cleanCode, Keyword::If, 0, '(');
+    KeywordMatch thenWord = findKeyword(cleanCode, Keyword::Then, 0, ':');
+    KeywordMatch elsePerform = findKeyword(cleanCode, Keyword::ElsePerform, 0, ':');
+    KeywordMatch endif = findKeyword(cleanCode, Keyword::Endif, 0, ';');
+
+    stmt.kind = StmtKind::InvalidIf;
+    if (!ifWord || !thenWord || !endif) {
+        return;
+    }
+
+    // The condition runs up to the last ')' before "then:", so it may contain
+    // parentheses of its own.
+    size_t closeParenPos = cleanCode.rfind(")", thenWord.begin);
+    if (closeParenPos == std::string::npos || closeParenPos < ifWord.end) {
+        return;
+    }
+    stmt.kind = StmtKind::If;
+
+    size_t thenStart = thenWord.end;
+    KeywordMatch firstElse = findKeyword(cleanCode, Keyword::ElseToIf, thenStart, '(');
+    size_t thenEnd = firstElse ? firstElse.begin : elsePerform ? elsePerform.begin : endif.begin;
+
+    stmt.branches.emplace_back();
+    stmt.branches.back().conditionText = cleanCode.substr(ifWord.end, closeParenPos - ifWord.end);
+    stmt.branches.back().condition = compileCondition(stmt.branches.back().conditionText);
+    parseBlock(cleanCode.substr(thenStart, thenEnd - thenStart), stmt.branches.back().body);
+
+    size_t searchPos = thenEnd;
+    while (searchPos < endif.begin) {
+        KeywordMatch elseToIf = findKeyword(cleanCode, Keyword::ElseToIf, searchPos, '(');
+        if (!elseToIf || elseToIf.begin >= endif.begin) break;
+
+        KeywordMatch resume = findKeyword(cleanCode, Keyword::Resume, elseToIf.end, ':');
+        size_t closePos = resume ? cleanCode.rfind(')', resume.begin) : std::string::npos;
+        if (closePos == std::string::npos || closePos < elseToIf.end) break;
+
+        size_t blockStart = resume.end;
+        KeywordMatch nextElse = findKeyword(cleanCode, Keyword::ElseToIf, blockStart, '(');
+        size_t blockEnd = (nextElse && nextElse.begin < endif.begin) ? nextElse.begin :
+                         (elsePerform && elsePerform.begin > blockStart) ? elsePerform.begin : endif.begin;
+
+        stmt.branches.emplace_back();
+        stmt.branches.back().conditionText = cleanCode.substr(elseToIf.end, closePos - elseToIf.end);
+        stmt.branches.back().condition = compileCondition(stmt.branches.back().conditionText);
+        parseBlock(cleanCode.substr(blockStart, blockEnd - blockStart), stmt.branches.back().body);
+
+        searchPos = blockEnd;
+    }
+
+    if (elsePerform) {
+        size_t elseStart = elsePerform.end;
+        stmt.branches.emplace_back();
+        parseBlock(cleanCode.substr(elseStart, endif.begin - elseStart), stmt.branches.back().body);
+        if (stmt.branches.back().body.empty()) {
+            stmt.branches.pop_back();
+        }
+    }
+}
+
+// `text` must live in the program arena: the statement points into it.
+const Statement* IornInterpreter::parseStatement(std::string_view text) {
+    Statement* stmt = programData->arena.create<Statement>(&programData->arena);
+
+    stmt->usesInput = text.find("input(") != std::string::npos;
+    findCalls(text, stmt->calls);
+
+    if (startsIfBlock(text.substr(0, text.find('\n')))) {
+        parseIfStatement(text, *stmt);
+        return stmt;
+    }
+
+    if (text.find("import ") != std::string::npos) {
+        // import\s+([\w\.]+\*?);?
+        stmt->kind = StmtKind::Import;
+        for (size_t pos = 0; (pos = text.find("import", pos)) != std::string::npos; pos++) {
+            size_t pathStart = skipSpaces(text, pos + 6);
+            size_t pathEnd = pathStart;
+            while (pathEnd < text.length() && (isWordChar(text[pathEnd]) || text[pathEnd] == '.')) pathEnd++;
+            if (pathStart == pos + 6 || pathEnd == pathStart) continue;
+            if (pathEnd < text.length() && text[pathEnd] == '*') pathEnd++;
+            std::string_view importPath = text.substr(pathStart, pathEnd - pathStart);
+            bool wildcard = importPath.compare(0, 9, "terminal.") == 0 && importPath.back() == '*';
+            stmt->importsPrint = stmt->importsPrint || wildcard || importPath == "terminal.Print";
+            stmt->importsInput = stmt->importsInput || wildcard || importPath == "terminal.input";
+            if (importPath.compare(0, 9, "terminal.") != 0 && importPath.find('.') != std::string_view::npos) {
+                stmt->imports.push_back(importPath);
+            }
+            pos = pathEnd - 1;
+        }
+        return stmt;
+    }
+
+    // Lines still holding a comment marker are only markers inside strings.
+    if (text.find("@rem") != std::string::npos || text.find("##") != std::string::npos) {
+        return stmt;
+    }
+
+    KeywordMatch head = firstKeyword(text);
+    Keyword leading = head.keyword;
+    if (leading == Keyword::NewFunction) {
+        stmt->kind = matchFunctionHeader(text, head.end, stmt->name, stmt->value, stmt->parameters, stmt->type)
+                   ? StmtKind::Function : StmtKind::InvalidFunction;
+    } else if (leading == Keyword::Return) {
+        parseReturn(text, head.end, *stmt);
+    } else if (leading == Keyword::NewVariable || leading == Keyword::RenameVariable) {
+        bool isRename = leading == Keyword::RenameVariable;
+        if (!isRename && matchDeclaration(text, "new variable", stmt->name, nullptr, nullptr)) {
+            stmt->kind = StmtKind::DeclareNull;
+        } else if (std::string_view index;
+                   matchDeclaration(text, isRename ? "rename variable" : "new variable", stmt->name, &stmt->type, &stmt->value,
+                                    isRename ? &index : nullptr)) {
+            stmt->kind = isRename ? StmtKind::Rename : StmtKind::Declare;
+            if (!index.empty()) {
+                stmt->index = compileCondition(index, CompileMode::Expression);
+            }
+            stmt->literal = trimSpaces(stmt->value);
+            if (stmt->type == "string" && stmt->literal.length() >= 2 &&
+                stmt->literal.front() == '"' && stmt->literal.back() == '"') {
+                stmt->literal = stmt->literal.substr(1, stmt->literal.length() - 2);
+            }
+
+            if (stmt->value.find("input(") != std::string::npos) {
+                if (matchInputCall(stmt->value, stmt->prompt)) {
+                    stmt->isInput = true;
+                    if (stmt->prompt.length() >= 2 && stmt->prompt.front() == '"' && stmt->prompt.back() == '"') {
+                        stmt->prompt = stmt->prompt.substr(1, stmt->prompt.length() - 2);
+                    }
+                } else {
+                    stmt->kind = StmtKind::None;
+                }
+            } else if (isArrayType(stmt->type)) {
+                stmt->expression = compileCondition(stmt->literal, CompileMode::Value);
+            } else if (stmt->literal.find('(') != std::string_view::npos && isFunctionCall(stmt->literal)) {
+                stmt->expression = compileCondition(stmt->literal,
+                    (stmt->type == "numeric" || stmt->type == "floating") ? CompileMode::Expression : CompileMode::Value);
+            } else if (stmt->type == "string") {
+                bool valid;
+                if (splitConcatenation(stmt->value, stmt->concat, valid) && !valid) {
+                    stmt->invalidValue = true;
+                }
+            } else if ((stmt->type == "numeric" || stmt->type == "floating") && isArithmeticExpression(stmt->literal)) {
+                stmt->expression = compileCondition(stmt->literal, CompileMode::Expression);
+            }
+            std::string message;
+            stmt->validValue = !stmt->isInput && !stmt->expression && stmt->concat.empty() &&
+                               checkVariableValue(stmt->type, stmt->value, 0, message);
+        }
+    } else if (text.find("Print(") != std::string::npos) {
+        size_t pos = 0;
+        std::string_view argument = matchPrintCall(text, pos);
+        if (!argument.empty()) {
+            stmt->kind = StmtKind::Print;
+            parsePrintText(argument, stmt->parts);
+        }
+    } else if (!stmt->calls.empty() && text.back() == ';') {
+        // name(arguments);  -- a call whose result, if any, is not used.
+        std::string_view call = trimSpaces(text.substr(0, text.length() - 1));
+        if (isFunctionCall(call)) {
+            stmt->kind = StmtKind::Call;
+            stmt->name = call.substr(0, call.find('('));
+            stmt->expression = compileCondition(call, CompileMode::Value);
+        }
+    }
+    return stmt;
+}
+
+// The parsed statement for `text`, parsed only if the cache does not have it
+// yet, with what it imports and uses added to `program`.
+const Statement& IornInterpreter::addStatement(std::string_view text, int lineNum, Program& program) {
+    auto cached = programData->statements.find(text);
+    if (cached == programData->statements.end()) {
+        std::string_view key = programData->arena.copy(text);
+        cached = programData->statements.emplace(key, parseStatement(key)).first;
+        program.parsedStatements++;
+    }
+    const Statement& stmt = *cached->second;
+    program.sourceStatements++;
+    program.importsPrint = program.importsPrint || stmt.importsPrint;
+    program.importsInput = program.importsInput || stmt.importsInput;
+    program.usesInput = program.usesInput || stmt.usesInput;
+    program.usesPrint = program.usesPrint || stmt.kind == StmtKind::Print || stmt.kind == StmtKind::If;
+    for (std::string_view path : stmt.imports) {
+        program.imports.push_back({lineNum, path});
+    }
+    return stmt;
+}
+
+Program IornInterpreter::compileProgram(const std::string& cleanCode) {
+    Program program;
+    std::vector<std::string_view> lines = splitLines(cleanCode);
+    program.statements.reserve(lines.size());
+
+    // Edited scripts leave statements behind in the cache. Once those
+    // outnumber the live ones, drop the arena and parse afresh.
+    if (programData->statements.size() > 2 * lines.size() + 1024) {
+        programCache.clear();
+        programData = std::make_unique<ProgramData>();
+    }
+
+    std::vector<std::string_view> calls;
+    auto add = [&](std::string_view text, int lineNum) -> const Statement& {
+        const Statement& stmt = addStatement(text, lineNum, program);
+        calls.insert(calls.end(), stmt.calls.begin(), stmt.calls.end());
+        return stmt;
+    };
+
+    // An if statement runs up to its endif; line and is parsed as one unit.
+    auto addLine = [&](size_t& i) -> const Statement& {
+        int lineNum = static_cast<int>(i) + 1;
+        if (!startsIfBlock(lines[i])) return add(lines[i], lineNum);
+        blockText.assign(lines[i]);
+        size_t j = i + 1;
+        while (j < lines.size() && !endsIfBlock(lines[j])) {
+            if (!lines[j].empty()) {
+                blockText += '\n';
+                blockText.append(lines[j]);
+            }
+            j++;
+        }
+        if (j < lines.size()) {
+            blockText += '\n';
+            blockText.append(lines[j]);
+        }
+        i = j;
+        return add(blockText, lineNum);
+    };
+    auto runs = [](const Statement& stmt) {
+        return stmt.kind != StmtKind::None && stmt.kind != StmtKind::Import;
+    };
+
+    // A function runs up to its endfunction; line. Its body is kept apart and
+    // the definition stays in the program, where it only reports problems
+    // with the definition itself.
+    std::vector<FunctionSource> sources;
+    for (size_t i = 0; i < lines.size(); i++) {
+        if (lines[i].empty()) continue;
+        int lineNum = static_cast<int>(i) + 1;
+        const Statement& stmt = addLine(i);
+        if (runs(stmt)) program.statements.push_back({lineNum, &stmt});
+        if (stmt.kind != StmtKind::Function && stmt.kind != StmtKind::InvalidFunction) continue;
+
+        sources.push_back({lineNum, &stmt, {}});
+        while (++i < lines.size() && !endsFunction(lines[i])) {
+            if (lines[i].empty()) continue;
+            int bodyLine = static_cast<int>(i) + 1;
+            const Statement& inner = addLine(i);
+            if (runs(inner)) sources.back().body.push_back({bodyLine, &inner});
+        }
+        sources.back().closed = i < lines.size();
+    }
+    if (!sources.empty()) {
+        defineFunctions(program, sources);
+    }
+
+    // Calls of functions the program does not define are reported after the
+    // run, as they always have been, and do nothing.
+    auto defined = [&](std::string_view name) {
+        return program.functions && program.functions->byName.count(name) != 0;
+    };
+    for (std::string_view name : calls) {
+        if (!defined(name)) program.unknownFunctions.push_back(name);
+    }
+    if (!program.unknownFunctions.empty()) {
+        auto undefinedCall = [&](const ProgramEntry& entry) {
+            return entry.statement->kind == StmtKind::Call && !defined(entry.statement->name);
+        };
+        program.statements.erase(std::remove_if(program.statements.begin(), program.statements.end(), undefinedCall),
+                                 program.statements.end());
+        if (program.functions) {
+            for (Function& function : program.functions->functions) {
+                function.body.erase(std::remove_if(function.body.begin(), function.body.end(), undefinedCall), function.body.end());
+            }
+        }
+    }
+    return program;
+}
+
+// Gives every function its own copy of its body, in which parameters and
+// the variables the body declares are read and written by frame slot
+// instead of by name. A name is local from its declaration on; before that,
+// and if the body never declares it, it is a variable of the script.
+// Functions already defined in the program are kept.
+void IornInterpreter::defineFunctions(Program& program, const std::vector<FunctionSource>& sources) {
+    if (!program.functions) program.functions = std::make_unique<FunctionCode>();
+    FunctionCode* code = program.functions.get();
+    std::vector<std::string_view> frame;
+    auto slotOf = [&](std::string_view name) {
+        auto it = std::find(frame.begin(), frame.end(), name);
+        return it == frame.end() ? -1 : static_cast<int>(it - frame.begin());
+    };
+    auto localize = [&](CompiledCondition*& condition) {
+        if (condition == nullptr) return;
+        condition = &code->conditions.emplace_back(*condition);
+        for (CondNode& node : condition->nodes) {
+            node.slot = nullptr;
+            node.callee = nullptr;
+            node.array = nullptr;
+            if (node.op == CondOp::Slot && (node.local = slotOf(node.text)) >= 0) {
+                node.op = CondOp::Local;
+            }
+        }
+    };
+    auto localizeParts = [&](std::pmr::vector<TextPart>& parts) {
+        for (TextPart& part : parts) {
+            if (part.isVariable) part.local = slotOf(part.text);
+        }
+    };
+
+    for (const FunctionSource& source : sources) {
+        const Statement& header = *source.header;
+        if (header.kind != StmtKind::Function || !source.closed || code->byName.count(header.name)) continue;
+        Function& function = code->functions.emplace_back();
+        function.name = header.name;
+        function.signature = header.value;
+        function.returnType = header.type;
+        function.parameters.assign(header.parameters.begin(), header.parameters.end());
+        function.line = source.line;
+
+        frame.clear();
+        for (const Parameter& parameter : function.parameters) {
+            frame.push_back(parameter.name);
+        }
+        for (const ProgramEntry& entry : source.body) {
+            Statement& stmt = *code->arena.create<Statement>(*entry.statement, &code->arena);
+            // The initialiser is read before the variable it declares exists.
+            localize(stmt.expression);
+            localizeParts(stmt.parts);
+            localizeParts(stmt.concat);
+            for (Branch& branch : stmt.branches) {
+                localize(branch.condition);
+                for (Statement& inner : branch.body) {
+                    localize(inner.expression);
+                    localizeParts(inner.parts);
+                }
+            }
+            if ((stmt.kind == StmtKind::Declare && !isArrayType(stmt.type)) || stmt.kind == StmtKind::DeclareNull) {
+                if ((stmt.local = slotOf(stmt.name)) < 0) {
+                    stmt.local = static_cast<int>(frame.size());
+                    frame.push_back(stmt.name);
+                }
+            } else if (stmt.kind == StmtKind::Rename && !stmt.index) {
+                stmt.local = slotOf(stmt.name);
+            }
+            function.body.push_back({entry.line, &stmt});
+        }
+        function.frameSize = frame.size();
+        code->byName.emplace(function.name, &function);
+    }
+}
+
+// A failed call is reported once the statement that made it is done.
+void IornInterpreter::executeStatement(const Statement& stmt, int lineNum) {
+    if (!ExecutionBudget::current()->step()) {
+        return;
+    }
+    runStatement(stmt, lineNum);
+    if (callFailure.kind != EvalError::None) {
+        reportCallFailure(lineNum);
+    }
+}
+
+void IornInterpreter::reportCallFailure(int lineNum) {
+    Diagnostic failure = callFailure;
+    callFailure = Diagnostic();
+    failure.line = lineNum;
+    reportDiagnostic(failure);
+}
+
+void IornInterpreter::runStatement(const Statement& stmt, int lineNum) {
+    switch (stmt.kind) {
+        case StmtKind::DeclareNull:
+            assign(stmt, "null");
+            break;
+
+        case StmtKind::Declare:
+        case StmtKind::Rename: {
+            if (stmt.index != nullptr) {
+                assignElement(stmt, lineNum);
+                return;
+            }
+            if (isArrayType(stmt.type)) {
+                assignArray(stmt, lineNum);
+                return;
+            }
+            if (stmt.kind == StmtKind::Rename && stmt.local < 0 && lookup(stmt.name) == nullptr) {
+                printError("Variable '" + std::string(stmt.name) + "' does not exist for rename on line " + std::to_string(lineNum) + ".");
+                return;
+            }
+
+            if (stmt.isInput) {
+                std::string input;
+                if (executeInput(stmt.prompt, stmt.type, input)) {
+                    assign(stmt, std::move(input));
+                }
+                return;
+            }
+
+            if (stmt.invalidValue) {
+                printError("Invalid string expression on line " + std::to_string(lineNum) + ".");
+                return;
+            }
+            
+            if (stmt.kind == StmtKind::Declare &&
+                !validateVariable(stmt.name, stmt.type, stmt.value, lineNum, stmt.concat.empty() && !stmt.expression && !stmt.validValue,
+                                  stmt.local >= 0)) {
+                return;
+            }
+            
+            if (stmt.expression) {
+                CompiledCondition& expression = *stmt.expression;
+                EvalResult<FrameSlot> value = expression.root < 0 ? EvalResult<FrameSlot>{{}, EvalError::InvalidExpression}
+                                                                   : evaluateAs(stmt.type, expression, expression.root);
+                if (!value) {
+                    std::string_view operand = value.node >= 0 ? std::string_view(expression.nodes[value.node].text) : std::string_view();
+                    reportDiagnostic({value.error, lineNum, stmt.literal, operand, stmt.type});
+                    return;
+                }
+                if (stmt.local >= 0) {
+                    frameSlot(stmt.local) = std::move(value.value);
+                } else {
+                    variable(stmt.name) = value.value.value();
+                }
+                return;
+            }
+            
+            if (!stmt.concat.empty()) {
+                for (const TextPart& part : stmt.concat) {
+                    if (part.isVariable && part.local < 0 && lookup(part.text) == nullptr) {
+                        printError("Variable '" + std::string(part.text) + "' is not declared on line " + std::to_string(lineNum) + ".");
+                        return;
+                    }
+                }
+                assign(stmt, evaluateConcatenation(stmt));
+                return;
+            }
+
+            assign(stmt, Value(stmt.literal));
+            break;
+        }
+
+        case StmtKind::Print:
+            executePrint(stmt.parts);
+            break;
+
+        case StmtKind::If:
+            for (const Branch& branch : stmt.branches) {
+                if (branch.condition != nullptr) {
+                    EvalResult<bool> taken = evaluateCondition(*branch.condition);
+                    if (!taken) {
+                        reportDiagnostic({taken.error, lineNum, branch.conditionText, {}, {}});
+                        return;
+                    }
+                    if (!taken.value) continue;
+                }
+                for (const Statement& inner : branch.body) {
+                    executeStatement(inner, lineNum);
+                    if (returning) break;
+                }
+                return;
+            }
+            break;
+
+        case StmtKind::InvalidIf:
+            printError("Error: Invalid if statement structure.");
+            break;
+
+        case StmtKind::Function:
+            if (currentFunction != nullptr) {
+                printError("Error: Function '" + std::string(stmt.name) + "' cannot be defined inside a function on line " +
+                           std::to_string(lineNum) + ".");
+                break;
+            }
+            if (auto function = functionCode->byName.find(stmt.name); function == functionCode->byName.end()) {
+                printError("Error: Invalid function definition. Missing endfunction; on line " + std::to_string(lineNum) + ".");
+            } else if (function->second->line != lineNum) {
+                printError("Function '" + std::string(stmt.name) + "' is already defined on line " + std::to_string(lineNum) + ".");
+            }
+            break;
+
+        case StmtKind::InvalidFunction:
+            printError("Error: Invalid function definition on line " + std::to_string(lineNum) + ".");
+            break;
+
+        case StmtKind::Return: {
+            if (currentFunction == nullptr) {
+                printError("Error: return outside of a function on line " + std::to_string(lineNum) + ".");
+                return;
+            }
+            std::string_view type = currentFunction->returnType;
+            if (type.empty() != (stmt.expression == nullptr)) {
+                printError(type.empty() ? "Function '" + std::string(currentFunction->name) + "()' returns no value on line " + std::to_string(lineNum) + "."
+                                        : "Function '" + std::string(currentFunction->name) + "()' must return a value on line " + std::to_string(lineNum) + ".");
+                return;
+            }
+            if (type == "string" && !stmt.concat.empty()) {
+                for (const TextPart& part : stmt.concat) {
+                    if (part.isVariable && part.local < 0 && lookup(part.text) == nullptr) {
+                        printError("Variable '" + std::string(part.text) + "' is not declared on line " + std::to_string(lineNum) + ".");
+                        return;
+                    }
+                }
+                returnValue.setText(evaluateConcatenation(stmt));
+            } else if (stmt.expression != nullptr) {
+                CompiledCondition& expression = *stmt.expression;
+                EvalResult<FrameSlot> value = expression.root < 0 ? EvalResult<FrameSlot>{{}, EvalError::InvalidExpression}
+                                                                   : evaluateAs(type, expression, expression.root);
+                if (!value) {
+                    bool named = value.error == EvalError::UndeclaredVariable;
+                    reportDiagnostic({named ? value.error : EvalError::ReturnType, lineNum, stmt.literal,
+                                      named ? std::string_view(expression.nodes[value.node].text) : currentFunction->name, type});
+                    return;
+                }
+                returnValue = std::move(value.value);
+            }
+            returning = true;
+            break;
+        }
+
+        case StmtKind::Call: {
+            FrameSlot ignored;
+            callFunction(*stmt.expression, stmt.expression->root, ignored, false);
+            break;
+        }
+
+        default:
+            break;
+    }
+}
+
+// Stops at the allocation that would take the run over its memory limit, or
+// after the statement that exhausts its budget.
+bool IornInterpreter::executeProgram(const Program& program) {
+    beginExecution(program);
+    for (const ProgramEntry& entry : program.statements) {
+        try {
+            if (entry.branch != nullptr) {
+                for (const Statement& inner : entry.branch->body) {
+                    executeStatement(inner, entry.line);
+                }
+            } else {
+                executeStatement(*entry.statement, entry.line);
+            }
+        } catch (const std::bad_alloc&) {
+            if (!memoryLimitExceeded()) throw;
+        }
+        if (memoryLimitExceeded() || ExecutionBudget::current()->exhausted()) {
+            lastRun.abortLine = entry.line;
+            return false;
+        }
+    }
+    return true;
+}
+
+void IornInterpreter::beginExecution(const Program& program) {
+    // Rewritten conditions are not in the caches reset() clears.
+    for (auto* conditions : {program.optimized ? &program.optimized->conditions : nullptr,
+                             program.functions ? &program.functions->conditions : nullptr}) {
+        if (conditions == nullptr) continue;
+        for (CompiledCondition& cond : *conditions) {
+            for (CondNode& node : cond.nodes) {
+                node.slot = nullptr;
+                node.callee = nullptr;
+                node.array = nullptr;
+            }
+        }
+    }
+    functionCode = program.functions.get();
+    frames.clear();
+    unknownReported.clear();
+    frameBase = 0;
+    callDepth = 0;
+    currentFunction = nullptr;
+    returning = false;
+    callFailure = Diagnostic();
+}
+
+// Runs a script while it is still being read. A statement runs as soon as
+// its last line is in: an if-block at its endif; line, a function definition
+// at its endfunction; line. Only such an open block is buffered. Statements
+// are parsed into a window of program data that is dropped whenever it fills
+// up; imports and functions, which later statements refer to, are parsed
+// into data kept for the whole run. What interpret() does with the whole
+// program is left out: the optimiser does not run, a statement needs its
+// imports above it, and a function must be defined before it is called.
+void IornInterpreter::interpretLines(std::istream& in) {
+    static constexpr size_t windowStatements = 4096;
+    ExecutionBudget budget(options);
+    lastRun = RunStats();
+    runGeneration++;
+    MemoryScope memoryScope(programMemory);
+    memory->resetPeak();
+    programCache.clear();
+
+    // Declared first, so the program whose functions point into it goes first.
+    std::unique_ptr<ProgramData> kept = std::make_unique<ProgramData>();
+    Program program;
+    program.functions = std::make_unique<FunctionCode>();
+    beginExecution(program);
+
+    // Reading and running alternate; time and allocations go to the front end
+    // or to execution as the run switches between them.
+    bool executing = false;
+    auto phaseStart = std::chrono::steady_clock::now();
+    size_t phaseAllocations = allocationCount.load(std::memory_order_relaxed);
+    size_t phaseBytes = allocationBytes.load(std::memory_order_relaxed);
+    startPhases();
+    auto chargePhase = [&] {
+        markPhase(executing ? RunPhase::Execute : RunPhase::FrontEnd);
+        auto now = std::chrono::steady_clock::now();
+        size_t allocations = allocationCount.load(std::memory_order_relaxed);
+        size_t bytes = allocationBytes.load(std::memory_order_relaxed);
+        (executing ? lastRun.executeMs : lastRun.frontEndMs) += std::chrono::duration<double, std::milli>(now - phaseStart).count();
+        (executing ? lastRun.executeAllocations : lastRun.frontEndAllocations) += allocations - phaseAllocations;
+        (executing ? lastRun.executeAllocatedBytes : lastRun.frontEndAllocatedBytes) += bytes - phaseBytes;
+        phaseStart = now;
+        phaseAllocations = allocations;
+        phaseBytes = bytes;
+    };
+    auto enterPhase = [&](bool execute) {
+        if (execute == executing) return;
+        chargePhase();
+        memoryScope.switchTo(execute ? runMemory : programMemory);
+        executing = execute;
+    };
+
+    bool limited = false;              // stopped by --max-memory or the budget
+    auto overLimit = [&](int lineNum) {
+        if (!memoryLimitExceeded() && !budget.exhausted()) return false;
+        lastRun.abortLine = lineNum;
+        limited = true;
+        return true;
+    };
+    auto keep = [&](std::string_view text, int lineNum) -> const Statement& {
+        programData.swap(kept);
+        const Statement& stmt = addStatement(text, lineNum, program);
+        programData.swap(kept);
+        return stmt;
+    };
+
+    // Modules are bound as their imports come in.
+    size_t boundImports = 0;
+    auto bindNewImports = [&] {
+        if (boundImports == program.imports.size()) return true;
+        boundImports = program.imports.size();
+        return bindImports(program);
+    };
+    auto run = [&](const Statement& stmt, int lineNum) {
+        if (!program.importsPrint) {
+            printError("I do not know what Print is! Write its import");
+            return false;
+        }
+        if (program.usesInput && !program.importsInput) {
+            printError("I do not know what input is! Write its import");
+            return false;
+        }
+        if (!bindNewImports()) return false;
+        enterPhase(true);
+        try {
+            executeStatement(stmt, lineNum);
+        } catch (const std::bad_alloc&) {
+            if (!memoryLimitExceeded()) throw;
+        }
+        return !overLimit(lineNum);
+    };
+
+    std::vector<FunctionSource> definition;   // the function being read, if any
+    auto defineFunction = [&](bool closed) {
+        definition.back().closed = closed;
+        defineFunctions(program, definition);
+        FunctionSource header = std::move(definition.back());
+        definition.clear();
+        return run(*header.header, header.line);
+    };
+
+    // One statement or block, complete.
+    auto complete = [&](std::string_view text, int lineNum) {
+        if (!definition.empty()) {
+            const Statement& inner = keep(text, lineNum);
+            if (inner.kind != StmtKind::None && inner.kind != StmtKind::Import) {
+                definition.back().body.push_back({lineNum, &inner});
+            }
+            return !overLimit(lineNum);
+        }
+        if (programData->statements.size() > windowStatements) {
+            programData = std::make_unique<ProgramData>();
+        }
+        bool lasting = !startsIfBlock(text.substr(0, text.find('\n'))) &&
+                       (text.find("import ") != std::string_view::npos || firstKeyword(text).keyword == Keyword::NewFunction);
+        const Statement& stmt = lasting ? keep(text, lineNum) : addStatement(text, lineNum, program);
+        if (overLimit(lineNum) || !bindNewImports()) return false;
+        if (stmt.kind == StmtKind::Function || stmt.kind == StmtKind::InvalidFunction) {
+            definition.push_back({lineNum, &stmt, {}});
+            return true;
+        }
+        return stmt.kind == StmtKind::None || stmt.kind == StmtKind::Import || run(stmt, lineNum);
+    };
+
+    CommentState comments;
+    std::string raw, line, translated, message;
+    int lineNum = 0;
+    int blockLine = 0;                 // first line of the open if-block, 0 if none
+    bool ok = true;
+    try {
+        while (ok && std::getline(in, raw)) {
+            lineNum++;
+            enterPhase(false);
+            line = stripComments(raw, comments);
+            if (translateKeywords(line, translated)) line.swap(translated);
+            if (!checkLineEnding(line, lineNum, message)) {
+                printError(message);
+                ok = false;
+            } else if (blockLine != 0) {
+                if (!line.empty()) {
+                    blockText += '\n';
+                    blockText += line;
+                }
+                if (endsIfBlock(line)) {
+                    int first = blockLine;
+                    blockLine = 0;
+                    ok = complete(blockText, first);
+                }
+            } else if (line.empty()) {
+                continue;
+            } else if (!definition.empty() && endsFunction(line)) {
+                ok = defineFunction(true);
+            } else if (startsIfBlock(line)) {
+                blockText = line;
+                blockLine = lineNum;
+            } else {
+                ok = complete(line, lineNum);
+            }
+        }
+        enterPhase(false);
+        if (ok && blockLine != 0) ok = complete(blockText, blockLine);
+        if (ok && !definition.empty()) ok = defineFunction(false);
+    } catch (const std::bad_alloc&) {
+        // Refused while reading; statements catch their own.
+        if (!memoryLimitExceeded()) throw;
+        limited = true;
+        lastRun.abortLine = lineNum;
+        ok = false;
+    }
+    memoryScope.switchTo(nullptr);     // only reporting is left
+    if (ok && !program.importsPrint) printError("I do not know what Print is! Write its import");
+
+    chargePhase();
+    recordMemory();
+    lastRun.statements = program.sourceStatements;
+    lastRun.parsedStatements = program.parsedStatements;
+    lastRun.executedStatements = budget.steps;
+    lastRun.programArenaBytes = programData->arena.bytesUsed() + kept->arena.bytesUsed();
+    lastRun.runArenaBytes = runArena.bytesUsed();
+    if (limited && checkMemory()) reportBudget(budget);
+}
+
+// Minimal JSON support for the language server protocol.
+struct JsonValue {
+    enum class Type { Null, Bool, Number, String, Array, Object };
+    Type type = Type::Null;
+    bool boolean = false;
+    double number = 0;
+    std::string string;
+    std::vector<JsonValue> array;
+    std::vector<std::pair<std::string, JsonValue>> object;
+
+    const JsonValue& operator[](const std::string& key) const {
+        static const JsonValue null;
+        for (const auto& member : object) {
+            if (member.first == key) return member.second;
+        }
+        return null;
+    }
+
+    bool isNull() const { return type == Type::Null; }
+    int asInt(int fallback = 0) const { return type == Type::Number ? static_cast<int>(number) : fallback; }
+};
+
+class JsonParser {
+public:
+    explicit JsonParser(const std::string& source) : src(source) {}
+
+    bool parse(JsonValue& out) {
+        return parseValue(out) && (skipSpaces(), pos == src.length());
+    }
+
+private:
+    const std::string& src;
+    size_t pos = 0;
+
+    void skipSpaces() {
+        while (pos < src.length() && std::isspace(static_cast<unsigned char>(src[pos]))) pos++;
+    }
+
+    bool literal(const char* word) {
+        size_t len = std::char_traits<char>::length(word);
+        if (src.compare(pos, len, word) != 0) return false;
+        pos += len;
+        return true;
+    }
+
+    static void appendUtf8(std::string& out, unsigned code) {
+        if (code < 0x80) {
+            out += static_cast<char>(code);
+        } else if (code < 0x800) {
+            out += static_cast<char>(0xC0 | (code >> 6));
+            out += static_cast<char>(0x80 | (code & 0x3F));
+        } else if (code < 0x10000) {
+            out += static_cast<char>(0xE0 | (code >> 12));
+            out += static_cast<char>(0x80 | ((code >> 6) & 0x3F));
+            out += static_cast<char>(0x80 | (code & 0x3F));
+        } else {
+            out += static_cast<char>(0xF0 | (code >> 18));
+            out += static_cast<char>(0x80 | ((code >> 12) & 0x3F));
+            out += static_cast<char>(0x80 | ((code >> 6) & 0x3F));
+            out += static_cast<char>(0x80 | (code & 0x3F));
+        }
+    }
+
+    bool parseHex4(unsigned& code) {
+        if (pos + 4 > src.length()) return false;
+        code = 0;
+        for (int i = 0; i < 4; i++) {
+            char c = src[pos++];
+            code <<= 4;
+            if (c >= '0' && c <= '9') code |= c - '0';
+            else if (c >= 'a' && c <= 'f') code |= c - 'a' + 10;
+            else if (c >= 'A' && c <= 'F') code |= c - 'A' + 10;
+            else return false;
+        }
+        return true;
+    }
+
+    bool parseString(std::string& out) {
+        if (pos >= src.length() || src[pos] != '"') return false;
+        pos++;
+        while (pos < src.length() && src[pos] != '"') {
+            char c = src[pos++];
+            if (c != '\\') {
+                out += c;
+                continue;
+            }
+            if (pos >= src.length()) return false;
+            char e = src[pos++];
+            switch (e) {
+                case 'n': out += '\n'; break;
+                case 't': out += '\t'; break;
+                case 'r': out += '\r'; break;
+                case 'b': out += '\b'; break;
+                case 'f': out += '\f'; break;
+                case 'u': {
+                    unsigned code;
+                    if (!parseHex4(code)) return false;
+                    if (code >= 0xD800 && code < 0xDC00 && src.compare(pos, 2, "\\u") == 0) {
+                        unsigned low;
+                        pos += 2;
+                        if (!parseHex4(low)) return false;
+                        code = 0x10000 + ((code - 0xD800) << 10) + (low - 0xDC00);
+                    }
+                    appendUtf8(out, code);
+                    break;
+                }
+                default: out += e; break;
+            }
+        }
+        if (pos >= src.length()) return false;
+        pos++;
+        return true;
+    }
+
+    bool parseValue(JsonValue& out) {
+        skipSpaces();
+        if (pos >= src.length()) return false;
+        char c = src[pos];
+
+        if (c == '{') {
+            pos++;
+            out.type = JsonValue::Type::Object;
+            skipSpaces();
+            if (pos < src.length() && src[pos] == '}') { pos++; return true; }
+            while (true) {
+                std::string key;
+                skipSpaces();
+                if (!parseString(key)) return false;
+                skipSpaces();
+                if (pos >= src.length() || src[pos++] != ':') return false;
+                out.object.emplace_back(std::move(key), JsonValue());
+                if (!parseValue(out.object.back().second)) return false;
+                skipSpaces();
+                if (pos < src.length() && src[pos] == ',') { pos++; continue; }
+                if (pos < src.length() && src[pos] == '}') { pos++; return true; }
+                return false;
+            }
+        }
+        if (c == '[') {
+            pos++;
+            out.type = JsonValue::Type::Array;
+            skipSpaces();
+            if (pos < src.length() && src[pos] == ']') { pos++; return true; }
+            while (true) {
+                out.array.emplace_back();
+                if (!parseValue(out.array.back())) return false;
+                skipSpaces();
+                if (pos < src.length() && src[pos] == ',') { pos++; continue; }
+                if (pos < src.length() && src[pos] == ']') { pos++; return true; }
+                return false;
+            }
+        }
+        if (c == '"') {
+            out.type = JsonValue::Type::String;
+            return parseString(out.string);
+        }
+        if (literal("true")) { out.type = JsonValue::Type::Bool; out.boolean = true; return true; }
+        if (literal("false")) { out.type = JsonValue::Type::Bool; out.boolean = false; return true; }
+        if (literal("null")) { out.type = JsonValue::Type::Null; return true; }
+
+        const char* begin = src.c_str() + pos;
+        auto result = std::from_chars(begin, src.c_str() + src.length(), out.number);
+        if (result.ec != std::errc()) return false;
+        out.type = JsonValue::Type::Number;
+        pos += static_cast<size_t>(result.ptr - begin);
+        return true;
+    }
+};
+
+static void appendJsonString(std::string& out, std::string_view text) {
+    out += '"';
+    for (char c : text) {
+        switch (c) {
+            case '"': out += "\\\""; break;
+            case '\\': out += "\\\\"; break;
+            case '\n': out += "\\n"; break;
+            case '\r': out += "\\r"; break;
+            case '\t': out += "\\t"; break;
+            default:
+                if (static_cast<unsigned char>(c) < 0x20) {
+                    char buffer[8];
+                    std::snprintf(buffer, sizeof(buffer), "\\u%04x", c);
+                    out += buffer;
+                } else {
+                    out += c;
+                }
+        }
+    }
+    out += '"';
+}
+
+// Language server over stdio (`iorn --lsp`). Documents are kept as lines with
+// a cached analysis per line; an edit re-analyses only the lines it touched,
+// plus following lines while their incoming comment state keeps changing.
+// Cross-line checks (redeclaration, if/endif pairing, imports) run over the
+// cached per-line results without re-parsing anything.
+class LanguageServer {
+public:
+    // Messages are read from `in` and written to `out`; `iorn --lsp` uses
+    // stdin and stdout.
+    LanguageServer(std::istream& in = std::cin, std::ostream& out = std::cout) : in(in), out(out) {}
+
+    int run() {
+#ifdef _WIN32
+        _setmode(_fileno(stdin), _O_BINARY);
+        _setmode(_fileno(stdout), _O_BINARY);
+#endif
+        std::string body;
+        while (!exitRequested && readMessage(body)) {
+            JsonValue message;
+            if (JsonParser(body).parse(message)) {
+                handle(message);
+            }
+        }
+        return shutdownRequested ? 0 : 1;
+    }
+
+private:
+    enum class LineKind { Other, Declare, Rename, If, ElseIf, Else, Endif, Import, Function, EndFunction, Return };
+
+    struct LineDiagnostic {
+        int column;      // 0-based byte offset
+        int endColumn;
+        std::string message;
+    };
+
+    struct Line {
+        std::string text;
+        bool dirty = true;
+        CommentState entry;
+        CommentState exit;
+        LineKind kind = LineKind::Other;
+        std::string name;  // declared or renamed variable, defined function
+        std::vector<std::string> parameters;
+        std::vector<std::pair<std::string, int>> calls;  // called function and its column
+        bool usesPrint = false;
+        bool usesInput = false;
+        bool importsPrint = false;
+        bool importsInput = false;
+        std::vector<LineDiagnostic> diagnostics;
+    };
+
+    struct Document {
+        std::vector<Line> lines;
+    };
+
+    std::istream& in;
+    std::ostream& out;
+    std::unordered_map<std::string, Document> documents;
+    bool shutdownRequested = false;
+    bool exitRequested = false;
+
+    bool readMessage(std::string& body) {
+        std::string header;
+        size_t length = 0;
+        bool haveLength = false;
+        while (std::getline(in, header)) {
+            if (!header.empty() && header.back() == '\r') header.pop_back();
+            if (header.empty()) {
+                if (haveLength) break;
+                continue;
+            }
+            if (header.compare(0, 15, "Content-Length:") == 0) {
+                length = static_cast<size_t>(std::strtoul(header.c_str() + 15, nullptr, 10));
+                haveLength = true;
+            }
+        }
+        if (!haveLength) return false;
+        body.resize(length);
+        in.read(&body[0], static_cast<std::streamsize>(length));
+        return static_cast<size_t>(in.gcount()) == length;
+    }
+
+    void send(const std::string& body) {
+        out << "Content-Length: " << body.length() << "\r\n\r\n" << body << std::flush;
+    }
+
+    static std::string idText(const JsonValue& id) {
+        if (id.type == JsonValue::Type::String) {
+            std::string out;
+            appendJsonString(out, id.string);
+            return out;
+        }
+        return std::to_string(id.asInt());
+    }
+
+    void respond(const JsonValue& id, const std::string& result) {
+        send("{\"jsonrpc\":\"2.0\",\"id\":" + idText(id) + ",\"result\":" + result + "}");
+    }
+
+    void handle(const JsonValue& message) {
+        const std::string& method = message["method"].string;
+        const JsonValue& id = message["id"];
+        const JsonValue& params = message["params"];
+
+        if (method == "initialize") {
+            respond(id, "{\"capabilities\":{\"textDocumentSync\":{\"openClose\":true,\"change\":2}},"
+                        "\"serverInfo\":{\"name\":\"iorn\"}}");
+        } else if (method == "shutdown") {
+            shutdownRequested = true;
+            respond(id, "null");
+        } else if (method == "exit") {
+            exitRequested = true;
+        } else if (method == "textDocument/didOpen") {
+            const JsonValue& doc = params["textDocument"];
+            Document& document = documents[doc["uri"].string];
+            document.lines.clear();
+            replaceText(document, doc["text"].string);
+            publish(doc["uri"].string, document);
+        } else if (method == "textDocument/didChange") {
+            const std::string& uri = params["textDocument"]["uri"].string;
+            auto it = documents.find(uri);
+            if (it == documents.end()) return;
+            for (const JsonValue& change : params["contentChanges"].array) {
+                if (change["range"].isNull()) {
+                    replaceText(it->second, change["text"].string);
+                } else {
+                    applyEdit(it->second, change["range"], change["text"].string);
+                }
+            }
+            publish(uri, it->second);
+        } else if (method == "textDocument/didClose") {
+            const std::string& uri = params["textDocument"]["uri"].string;
+            documents.erase(uri);
+            send("{\"jsonrpc\":\"2.0\",\"method\":\"textDocument/publishDiagnostics\","
+                 "\"params\":{\"uri\":" + jsonString(uri) + ",\"diagnostics\":[]}}");
+        } else if (!id.isNull()) {
+            send("{\"jsonrpc\":\"2.0\",\"id\":" + idText(id) +
+                 ",\"error\":{\"code\":-32601,\"message\":\"Method not found\"}}");
+        }
+    }
+
+    static std::string jsonString(std::string_view text) {
+        std::string out;
+        appendJsonString(out, text);
+        return out;
+    }
+
+    // LSP columns count UTF-16 code units; lines are stored as UTF-8.
+    static size_t utf16ToByte(const std::string& text, int units) {
+        size_t pos = 0;
+        while (pos < text.length() && units > 0) {
+            unsigned char c = static_cast<unsigned char>(text[pos]);
+            size_t len = (c < 0x80) ? 1 : (c < 0xE0) ? 2 : (c < 0xF0) ? 3 : 4;
+            units -= (len == 4) ? 2 : 1;
+            pos += len;
+        }
+        return std::min(pos, text.length());
+    }
+
+    static int byteToUtf16(const std::string& text, size_t bytes) {
+        int units = 0;
+        size_t pos = 0;
+        while (pos < bytes && pos < text.length()) {
+            unsigned char c = static_cast<unsigned char>(text[pos]);
+            size_t len = (c < 0x80) ? 1 : (c < 0xE0) ? 2 : (c < 0xF0) ? 3 : 4;
+            units += (len == 4) ? 2 : 1;
+            pos += len;
+        }
+        return units;
+    }
+
+    static std::vector<std::string> splitText(const std::string& text) {
+        std::vector<std::string> parts;
+        size_t start = 0;
+        while (true) {
+            size_t end = text.find('\n', start);
+            if (end == std::string::npos) {
+                parts.push_back(text.substr(start));
+                return parts;
+            }
+            parts.push_back(text.substr(start, end - start));
+            start = end + 1;
+        }
+    }
+
+    void replaceText(Document& document, const std::string& text) {
+        std::vector<std::string> texts = splitText(text);
+        std::vector<Line> lines(texts.size());
+        for (size_t i = 0; i < texts.size(); i++) {
+            // Keep the analysis of lines that did not change in place.
+            if (i < document.lines.size() && document.lines[i].text == texts[i]) {
+                lines[i] = std::move(document.lines[i]);
+            } else {
+                lines[i].text = std::move(texts[i]);
+            }
+        }
+        document.lines = std::move(lines);
+        reanalyze(document, 0, document.lines.size());
+    }
+
+    void applyEdit(Document& document, const JsonValue& range, const std::string& text) {
+        if (document.lines.empty()) document.lines.emplace_back();
+        size_t last = document.lines.size() - 1;
+        size_t startLine = std::min<size_t>(range["start"]["line"].asInt(), last);
+        size_t endLine = std::min<size_t>(range["end"]["line"].asInt(), last);
+        if (endLine < startLine) endLine = startLine;
+
+        const std::string& first = document.lines[startLine].text;
+        const std::string& final = document.lines[endLine].text;
+        std::string merged = first.substr(0, utf16ToByte(first, range["start"]["character"].asInt())) + text +
+                             final.substr(utf16ToByte(final, range["end"]["character"].asInt()));
+
+        std::vector<std::string> texts = splitText(merged);
+        std::vector<Line> inserted(texts.size());
+        for (size_t i = 0; i < texts.size(); i++) {
+            inserted[i].text = std::move(texts[i]);
+        }
+        document.lines.erase(document.lines.begin() + startLine, document.lines.begin() + endLine + 1);
+        document.lines.insert(document.lines.begin() + startLine,
+                              std::make_move_iterator(inserted.begin()), std::make_move_iterator(inserted.end()));
+        reanalyze(document, startLine, startLine + inserted.size());
+    }
+
+    // Re-analyses dirty lines in [from, to), then keeps going only while the
+    // comment state flowing into the next line differs from what it was.
+    void reanalyze(Document& document, size_t from, size_t to) {
+        for (size_t i = from; i < document.lines.size(); i++) {
+            Line& line = document.lines[i];
+            CommentState entry = (i == 0) ? CommentState() : document.lines[i - 1].exit;
+            if (!line.dirty && line.entry == entry) {
+                if (i >= to) break;
+                continue;
+            }
+            line.entry = entry;
+            analyzeLine(line, static_cast<int>(i) + 1);
+        }
+    }
+
+    void analyzeLine(Line& line, int lineNum) {
+        static const std::regex declaration("new variable\\s+(\\w+)\\s+(string|numeric\\[\\]|numeric|floating\\[\\]|floating|boolean)\\s*=\\s*([^;]+);");
+        static const std::regex nullDeclaration("new variable\\s+(\\w+)\\s+NULL;");
+        static const std::regex rename("rename variable\\s+(\\w+)(\\[[^\\]]+\\])?\\s+(string|numeric\\[\\]|numeric|floating\\[\\]|floating|boolean)\\s*=\\s*([^;]+);");
+        static const std::regex importDeclaration("import\\s+([\\w\\.]+\\*?);?");
+
+        line.dirty = false;
+        line.exit = line.entry;
+        line.kind = LineKind::Other;
+        line.name.clear();
+        line.parameters.clear();
+        line.calls.clear();
+        line.usesPrint = line.usesInput = line.importsPrint = line.importsInput = false;
+        line.diagnostics.clear();
+
+        std::string code = stripComments(line.text, line.exit);
+        if (!code.empty() && code.back() == '\r') code.pop_back();
+        size_t first = code.find_first_not_of(" \t");
+        if (first == std::string::npos) return;
+        int start = static_cast<int>(first);
+        int end = static_cast<int>(code.find_last_not_of(" \t") + 1);
+
+        // Diagnostics keep the columns of the line as written; only their
+        // checks see the English spelling of Russian keywords.
+        std::string original = code;
+        std::string translated;
+        if (translateKeywords(code, translated)) {
+            code.swap(translated);
+        }
+        KeywordMatch head = firstKeyword(code);
+        Keyword leading = head.keyword;
+
+        std::string message;
+        int column = 0;
+        if (!checkLineEnding(code, lineNum, message, &column)) {
+            line.diagnostics.push_back({start, end, message});
+        }
+
+        std::smatch match;
+        if (code.find("import ") != std::string::npos && std::regex_search(code, match, importDeclaration)) {
+            std::string path = match[1].str();
+            bool wildcard = path.find("terminal.") == 0 && path.back() == '*';
+            line.kind = LineKind::Import;
+            line.importsPrint = wildcard || path == "terminal.Print";
+            line.importsInput = wildcard || path == "terminal.input";
+            return;
+        }
+
+        if (leading == Keyword::NewFunction) {
+            std::string_view name, signature, returnType;
+            std::pmr::vector<Parameter> parameters;
+            // An invalid header still opens a body, as it does when run.
+            line.kind = LineKind::Function;
+            if (matchFunctionHeader(code, head.end, name, signature, parameters, returnType)) {
+                line.name = std::string(name);
+                for (const Parameter& parameter : parameters) {
+                    line.parameters.emplace_back(parameter.name);
+                }
+            } else if (line.diagnostics.empty()) {
+                line.diagnostics.push_back({start, end, "Error: Invalid function definition on line " + std::to_string(lineNum) + "."});
+            }
+        } else if (leading == Keyword::Return) {
+            line.kind = LineKind::Return;
+        } else if (endsFunction(code)) {
+            line.kind = LineKind::EndFunction;
+        } else if (leading == Keyword::NewVariable) {
+            line.kind = LineKind::Declare;
+            if (std::regex_search(code, match, nullDeclaration)) {
+                line.name = match[1].str();
+            } else if (std::regex_search(code, match, declaration)) {
+                line.name = match[1].str();
+                std::string value = match[3].str();
+                if (!checkVariableName(line.name, lineNum, message)) {
+                    line.diagnostics.push_back({start, end, message});
+                } else if (value.find("input(") == std::string::npos) {
+                    std::pmr::vector<TextPart> parts;
+                    bool valid;
+                    if (match[2].str() == "string" && splitConcatenation(value, parts, valid)) {
+                        if (!valid) {
+                            line.diagnostics.push_back({start, end, "Invalid string expression on line " + std::to_string(lineNum) + "."});
+                        }
+                    } else if (!checkVariableValue(match[2].str(), value, lineNum, message)) {
+                        line.diagnostics.push_back({start, end, message});
+                    }
+                }
+            } else if (line.diagnostics.empty()) {
+                line.diagnostics.push_back({start, end, "Invalid variable declaration on line " + std::to_string(lineNum) + "."});
+            }
+        } else if (leading == Keyword::RenameVariable) {
+            line.kind = LineKind::Rename;
+            if (std::regex_search(code, match, rename)) {
+                line.name = match[1].str();
+            } else if (line.diagnostics.empty()) {
+                line.diagnostics.push_back({start, end, "Invalid variable rename on line " + std::to_string(lineNum) + "."});
+            }
+        } else if (findKeyword(code, Keyword::ElseToIf, 0, '(')) {
+            line.kind = LineKind::ElseIf;
+        } else if (findKeyword(code, Keyword::ElsePerform, 0, ':')) {
+            line.kind = LineKind::Else;
+        } else if (endsIfBlock(code)) {
+            line.kind = LineKind::Endif;
+        } else if (findKeyword(code, Keyword::If, 0, '(')) {
+            line.kind = LineKind::If;
+        }
+
+        line.usesPrint = code.find("Print(") != std::string::npos;
+        line.usesInput = code.find("input(") != std::string::npos;
+
+        // Whether a call is defined depends on the whole document; publish()
+        // reports the ones that are not.
+        std::pmr::vector<std::string_view> calls;
+        findCalls(original, calls);
+        for (std::string_view call : calls) {
+            line.calls.emplace_back(std::string(call), static_cast<int>(call.data() - original.data()));
+        }
+    }
+
+    void appendDiagnostic(std::string& out, const Line& line, size_t lineIndex, int column, int endColumn,
+                          const std::string& message) {
+        if (out.back() != '[') out += ',';
+        out += "{\"range\":{\"start\":{\"line\":" + std::to_string(lineIndex) +
+               ",\"character\":" + std::to_string(byteToUtf16(line.text, column)) +
+               "},\"end\":{\"line\":" + std::to_string(lineIndex) +
+               ",\"character\":" + std::to_string(byteToUtf16(line.text, endColumn)) +
+               "}},\"severity\":1,\"source\":\"iorn\",\"message\":";
+        appendJsonString(out, message);
+        out += '}';
+    }
+
+    void publish(const std::string& uri, const Document& document) {
+        std::string out = "{\"jsonrpc\":\"2.0\",\"method\":\"textDocument/publishDiagnostics\","
+                          "\"params\":{\"uri\":" + jsonString(uri) + ",\"diagnostics\":[";
+
+        std::unordered_map<std::string_view, size_t> functions;
+        for (size_t i = 0; i < document.lines.size(); i++) {
+            const Line& line = document.lines[i];
+            if (line.kind == LineKind::Function && !line.name.empty()) functions.emplace(line.name, i);
+        }
+
+        // Variables declared inside a function are its own; globals stay visible.
+        std::unordered_map<std::string_view, size_t> declared;
+        std::unordered_map<std::string_view, size_t> locals;
+        size_t openFunction = std::string::npos;
+        std::vector<size_t> openIfs;
+        bool importsPrint = false, importsInput = false;
+        size_t firstPrint = std::string::npos, firstInput = std::string::npos;
+
+        for (size_t i = 0; i < document.lines.size(); i++) {
+            const Line& line = document.lines[i];
+            int width = static_cast<int>(line.text.length());
+            for (const LineDiagnostic& diag : line.diagnostics) {
+                appendDiagnostic(out, line, i, diag.column, diag.endColumn, diag.message);
+            }
+            for (const auto& call : line.calls) {
+                if (functions.find(call.first) == functions.end()) {
+                    appendDiagnostic(out, line, i, call.second, call.second + static_cast<int>(call.first.length()),
+                                     "Unknown function '" + call.first + "()'. Function is not defined or imported.");
+                }
+            }
+            bool inFunction = openFunction != std::string::npos;
+
+            importsPrint = importsPrint || line.importsPrint;
+            importsInput = importsInput || line.importsInput;
+            if (line.usesPrint && firstPrint == std::string::npos) firstPrint = i;
+            if (line.usesInput && firstInput == std::string::npos) firstInput = i;
+
+            std::string lineNum = std::to_string(i + 1);
+            switch (line.kind) {
+                case LineKind::Declare:
+                    if (!line.name.empty() && inFunction) {
+                        locals.emplace(line.name, i);
+                    } else if (!line.name.empty() && !declared.emplace(line.name, i).second) {
+                        appendDiagnostic(out, line, i, 0, width,
+                                         "Variable '" + line.name + "' is already declared on line " + lineNum + ".");
+                    }
+                    break;
+                case LineKind::Rename:
+                    if (!line.name.empty() && declared.find(line.name) == declared.end() &&
+                        (!inFunction || locals.find(line.name) == locals.end())) {
+                        appendDiagnostic(out, line, i, 0, width,
+                                         "Variable '" + line.name + "' does not exist for rename on line " + lineNum + ".");
+                    }
+                    break;
+                case LineKind::If:
+                    openIfs.push_back(i);
+                    break;
+                case LineKind::ElseIf:
+                case LineKind::Else:
+                    if (openIfs.empty()) {
+                        appendDiagnostic(out, line, i, 0, width, "Error: else without matching if on line " + lineNum + ".");
+                    }
+                    break;
+                case LineKind::Endif:
+                    if (openIfs.empty()) {
+                        appendDiagnostic(out, line, i, 0, width, "Error: endif; without matching if on line " + lineNum + ".");
+                    } else {
+                        openIfs.pop_back();
+                    }
+                    break;
+                case LineKind::Function:
+                    if (inFunction) {
+                        appendDiagnostic(out, line, i, 0, width, "Error: Function '" + line.name +
+                                         "' cannot be defined inside a function on line " + lineNum + ".");
+                        break;
+                    }
+                    if (!line.name.empty() && functions.at(line.name) != i) {
+                        appendDiagnostic(out, line, i, 0, width,
+                                         "Function '" + line.name + "' is already defined on line " + lineNum + ".");
+                    }
+                    openFunction = i;
+                    locals.clear();
+                    for (const std::string& parameter : line.parameters) {
+                        locals.emplace(parameter, i);
+                    }
+                    break;
+                case LineKind::EndFunction:
+                    if (!inFunction) {
+                        appendDiagnostic(out, line, i, 0, width, "Error: endfunction; without matching function on line " + lineNum + ".");
+                    }
+                    openFunction = std::string::npos;
+                    break;
+                case LineKind::Return:
+                    if (!inFunction) {
+                        appendDiagnostic(out, line, i, 0, width, "Error: return outside of a function on line " + lineNum + ".");
+                    }
+                    break;
+                default:
+                    break;
+            }
+        }
+
+        if (openFunction != std::string::npos) {
+            const Line& line = document.lines[openFunction];
+            appendDiagnostic(out, line, openFunction, 0, static_cast<int>(line.text.length()),
+                             "Error: Invalid function definition. Missing endfunction;");
+        }
+
+        for (size_t i : openIfs) {
+            const Line& line = document.lines[i];
+            appendDiagnostic(out, line, i, 0, static_cast<int>(line.text.length()),
+                             "Error: Invalid if statement structure. Missing endif;");
+        }
+        if (firstPrint != std::string::npos && !importsPrint) {
+            const Line& line = document.lines[firstPrint];
+            appendDiagnostic(out, line, firstPrint, 0, static_cast<int>(line.text.length()),
+                             "I do not know what Print is! Write its import");
+        }
+        if (firstInput != std::string::npos && !importsInput) {
+            const Line& line = document.lines[firstInput];
+            appendDiagnostic(out, line, firstInput, 0, static_cast<int>(line.text.length()),
+                             "I do not know what input is! Write its import");
+        }
+
+        out += "]}}";
+        send(out);
+    }
+};
+
+void createPackagedApp(const std::string& sourceFile, const std::string& extension, 
+                      const std::string& outName, const std::string& icon, bool loopMain) {
+    std::string templateCode = R"(
+#include <iostream>
+#include <string>
+#include <fstream>
+#include <cstdlib>
+
+int main() {
+    std::string iornCode = R"IORN_CODE(
+)IORN_CODE_PLACEHOLDER(
+)IORN_CODE";
+    
+    std::ofstream tempFile("temp_iorn_code.iorn");
+    tempFile << iornCode;
+    tempFile.close();
+    
+    std::string command = "iorn.exe temp_iorn_code.iorn";
+    int result = system(command.c_str());
+    
+    remove("temp_iorn_code.iorn");
+    
+    LOOP_PLACEHOLDER
+    
+    return result;
+}
+)";
+    
+    std::ifstream sourceFileStream(sourceFile);
+    if (!sourceFileStream.is_open()) {
+        std::cerr << "Error: Cannot open source file " << sourceFile << std::endl;
+        return;
+    }
+    
+    std::string iornCode((std::istreambuf_iterator<char>(sourceFileStream)), 
+                        std::istreambuf_iterator<char>());
+    sourceFileStream.close();
+    
+    size_t pos = templateCode.find(")IORN_CODE_PLACEHOLDER(");
+    if (pos != std::string::npos) {
+        templateCode.replace(pos, 23, iornCode);
+    }
+    
+    std::string loopCode = loopMain ? 
+        "std::cout << \"Press Enter to exit...\"; std::cin.get();" : "";
+    pos = templateCode.find("LOOP_PLACEHOLDER");
+    if (pos != std::string::npos) {
+        templateCode.replace(pos, 16, loopCode);
+    }
+    
+    std::string cppFile = outName + "_generated.cpp";
+    std::ofstream cppFileStream(cppFile);
+    cppFileStream << templateCode;
+    cppFileStream.close();
+    
+    // Create resource file with icon
+    std::string rcFile = outName + ".rc";
+    std::ofstream rcStream(rcFile);
+    rcStream << "IDI_ICON1 ICON \"..\\assets\\iorn_ico_exeFile_ordinary.ico\"" << std::endl;
+    rcStream.close();
+    
+    // Compile resource and then executable
+    std::string rcCompileCmd = "windres " + rcFile + " -o " + outName + ".o";
+    int rcResult = system(rcCompileCmd.c_str());
+    
+    std::string compileCmd = "g++ -std=c++11 -O2 -o " + outName + extension + " " + cppFile;
+    if (rcResult == 0) {
+        compileCmd += " " + outName + ".o";
+    }
+    
+    if (system(compileCmd.c_str()) == 0) {
+        std::cout << "Successfully packaged to: " << outName << extension << std::endl;
+        remove(cppFile.c_str());
+        remove((outName + ".rc").c_str());
+        remove((outName + ".o").c_str());
+        remove((outName + ".res").c_str());
+
+    } else {
+        std::cerr << "Error: Failed to compile packaged application" << std::endl;
+    }
+}
+
+// Synthetic corpus used by the benchmarks when no script is given.
+static std::string generateBenchCorpus(size_t targetBytes) {
+    std::string corpus = "import terminal.*;\n";
+    corpus.reserve(targetBytes + 256);
+    for (size_t i = 0; corpus.length() < targetBytes; i++) {
+        std::string n = std::to_string(i);
+        corpus += "new variable v" + n + " numeric = " + n + "; ## counter " + n + "\n";
+        corpus += "Print(f\"value $[v" + n + "] and text\");\n";
+        if (i % 8 == 0) corpus += "@rem generated block " + n + "\n";
+        if (i % 16 == 0) corpus += "\"\"\"\nblock comment " + n + "\n\"\"\"\n";
+        if (i % 32 == 0) corpus += "if (v" + n + " >= 0) then:\n    Print(\"ok\");\nendif;\n";
+    }
+    return corpus;
+}
+
+// Synthetic scripts that grow along one dimension each, for `iorn --generate`
+// and `iorn --bench=scaling`. The scripts run without errors and print
+// little, so that only the interpreter's own work grows.
+enum class ScriptFamily { Lines, Variables, Expression, Comments, IfChain };
+
+struct ScriptFamilyInfo {
+    const char* name;
+    ScriptFamily family;
+    size_t smallest;                   // first size of the scaling run
+    const char* unit;
+};
+
+static const ScriptFamilyInfo scriptFamilies[] = {
+    {"lines", ScriptFamily::Lines, 4096, "statements"},
+    {"variables", ScriptFamily::Variables, 2048, "variables"},
+    {"expression", ScriptFamily::Expression, 256, "terms per expression"},
+    {"comments", ScriptFamily::Comments, 1, "comment lines per statement"},
+    {"ifchain", ScriptFamily::IfChain, 256, "branches per if"}
+};
+
+static std::string generateScript(ScriptFamily family, size_t size) {
+    std::string script = "import terminal.*;\n";
+    switch (family) {
+        case ScriptFamily::Lines:
+            // Arithmetic, string building, a condition and a print, in turn.
+            script += "new variable total numeric = 0;\nnew variable label string = \"\";\n";
+            for (size_t i = 0; i < size; i++) {
+                std::string n = std::to_string(i);
+                switch (i % 4) {
+                    case 0: script += "rename variable total numeric = total + " + n + " % 7;\n"; break;
+                    case 1: script += "rename variable label string = label + \"x\";\n"; break;
+                    case 2: script += "if (total < 0 or label == \"" + n + "\") then:\n    Print(\"never\");\nendif;\n"; break;
+                    default: script += "new variable v" + n + " numeric = total * 2;\n"; break;
+                }
+            }
+            script += "Print(f\"$[total]\");\n";
+            break;
+        case ScriptFamily::Variables:
+            for (size_t i = 0; i < size; i++) {
+                std::string n = std::to_string(i);
+                script += "new variable v" + n + " numeric = " + n + ";\n";
+            }
+            for (size_t i = 0; i < size; i++) {
+                std::string n = std::to_string(i);
+                script += "rename variable v" + n + " numeric = v" + n + " + v" + std::to_string(i / 2) + ";\n";
             }
-        } else if (varType == "boolean") {
-            if (trimmedValue != "TRUE" && trimmedValue != "FALSE") {
-                setRedColor();
-                std::cerr << "Boolean value must be TRUE or FALSE on line " << lineNum << "." << std::endl;
-                resetColor();
-                return false;
+            script += "Print(f\"$[v0] $[v" + std::to_string(size - 1) + "]\");\n";
+            break;
+        case ScriptFamily::Expression: {
+            // Renamed, so the optimiser cannot fold the expressions away.
+            script += "new variable x numeric = 3;\nrename variable x numeric = 4;\nnew variable e numeric = 0;\n";
+            std::string expression = "x";
+            for (size_t i = 1; i < size; i++) {
+                expression += (i % 2) ? " + x" : " - x";
             }
-        }
-        return true;
-    }
-    
-    std::string replaceVariables(const std::string& expr) {
-        std::string result = expr;
-        for (const auto& var : variables) {
-            size_t pos = 0;
-            while ((pos = result.find(var.first, pos)) != std::string::npos) {
-                bool isFullWord = (pos == 0 || !std::isalnum(result[pos-1])) && 
-                                 (pos + var.first.length() == result.length() || !std::isalnum(result[pos + var.first.length()]));
-                if (isFullWord) {
-                    result.replace(pos, var.first.length(), var.second);
-                    pos += var.second.length();
-                } else {
-                    pos++;
-                }
+            for (int i = 0; i < 16; i++) {
+                script += "rename variable e numeric = " + expression + ";\n";
+                script += "if (" + expression + " < 0) then:\n    Print(\"never\");\nendif;\n";
             }
+            script += "Print(f\"$[e]\");\n";
+            break;
         }
-        return result;
-    }
-    
-    double evaluateExpression(const std::string& expr);
-    double evaluateWithPrecedence(const std::string& expr);
-    size_t findNumberStart(const std::string& expr, size_t pos);
-    size_t findNumberEnd(const std::string& expr, size_t pos);
-    
-    bool evaluateCondition(const std::string& condition) {
-        std::string cleanCond = condition;
-        cleanCond.erase(std::remove(cleanCond.begin(), cleanCond.end(), ' '), cleanCond.end());
-        
-        std::vector<std::string> operators = {"==", "!=", ">=", "<=", ">", "<"};
-        
-        for (const std::string& op : operators) {
-            size_t pos = cleanCond.find(op);
-            if (pos != std::string::npos) {
-                std::string left = cleanCond.substr(0, pos);
-                std::string right = cleanCond.substr(pos + op.length());
-                
-                bool leftIsStringLiteral = (left.length() >= 2 && left.front() == '"' && left.back() == '"');
-                bool rightIsStringLiteral = (right.length() >= 2 && right.front() == '"' && right.back() == '"');
-                
-                std::string leftOriginal = left;
-                std::string rightOriginal = right;
-                left = replaceVariables(left);
-                right = replaceVariables(right);
-                
-                bool leftWasVariable = (leftOriginal != left && !leftIsStringLiteral);
-                bool rightWasVariable = (rightOriginal != right && !rightIsStringLiteral);
-                
-                if (leftIsStringLiteral || rightIsStringLiteral || leftWasVariable || rightWasVariable) {
-                    std::string leftStr = leftIsStringLiteral ? left.substr(1, left.length() - 2) : left;
-                    std::string rightStr = rightIsStringLiteral ? right.substr(1, right.length() - 2) : right;
-                    
-                    // Trim whitespace for comparison
-                    leftStr.erase(0, leftStr.find_first_not_of(" \t\r\n"));
-                    leftStr.erase(leftStr.find_last_not_of(" \t\r\n") + 1);
-                    rightStr.erase(0, rightStr.find_first_not_of(" \t\r\n"));
-                    rightStr.erase(rightStr.find_last_not_of(" \t\r\n") + 1);
-                    
-                    // Try numeric comparison first if both look like numbers
-                    bool leftIsNumeric = std::regex_match(leftStr, std::regex("^-?\\d+(\\.\\d+)?$"));
-                    bool rightIsNumeric = std::regex_match(rightStr, std::regex("^-?\\d+(\\.\\d+)?$"));
-                    
-                    if (leftIsNumeric && rightIsNumeric) {
-                        try {
-                            double leftVal = std::stod(leftStr);
-                            double rightVal = std::stod(rightStr);
-                            
-                            if (op == "==") return leftVal == rightVal;
-                            else if (op == "!=") return leftVal != rightVal;
-                            else if (op == ">=") return leftVal >= rightVal;
-                            else if (op == "<=") return leftVal <= rightVal;
-                            else if (op == ">") return leftVal > rightVal;
-                            else if (op == "<") return leftVal < rightVal;
-                        } catch (...) {
-                            // Fall back to string comparison
-                        }
-                    }
-                    
-                    // String comparison
-                    if (op == "==") return leftStr == rightStr;
-                    else if (op == "!=") return leftStr != rightStr;
-                    else if (op == ">=") return leftStr >= rightStr;
-                    else if (op == "<=") return leftStr <= rightStr;
-                    else if (op == ">") return leftStr > rightStr;
-                    else if (op == "<") return leftStr < rightStr;
-                } else {
-                    try {
-                        double leftVal = evaluateExpression(left);
-                        double rightVal = evaluateExpression(right);
-                        
-                        if (op == "==") return leftVal == rightVal;
-                        else if (op == "!=") return leftVal != rightVal;
-                        else if (op == ">=") return leftVal >= rightVal;
-                        else if (op == "<=") return leftVal <= rightVal;
-                        else if (op == ">") return leftVal > rightVal;
-                        else if (op == "<") return leftVal < rightVal;
-                    } catch (...) {
-                        // Trim whitespace for string comparison fallback
-                        std::string leftTrimmed = left;
-                        std::string rightTrimmed = right;
-                        leftTrimmed.erase(0, leftTrimmed.find_first_not_of(" \t\r\n"));
-                        leftTrimmed.erase(leftTrimmed.find_last_not_of(" \t\r\n") + 1);
-                        rightTrimmed.erase(0, rightTrimmed.find_first_not_of(" \t\r\n"));
-                        rightTrimmed.erase(rightTrimmed.find_last_not_of(" \t\r\n") + 1);
-                        
-                        if (op == "==") return leftTrimmed == rightTrimmed;
-                        else if (op == "!=") return leftTrimmed != rightTrimmed;
-                        else if (op == ">=") return leftTrimmed >= rightTrimmed;
-                        else if (op == "<=") return leftTrimmed <= rightTrimmed;
-                        else if (op == ">") return leftTrimmed > rightTrimmed;
-                        else if (op == "<") return leftTrimmed < rightTrimmed;
+        case ScriptFamily::Comments:
+            // All four comment styles, and marker characters inside string literals.
+            for (size_t i = 0; i < 2000; i++) {
+                std::string n = std::to_string(i);
+                script += "new variable c" + n + " string = \"# @ not a comment " + n + "\"; ## note\n";
+                for (size_t k = 0; k < size; k++) {
+                    switch (k % 4) {
+                        case 0: script += "## comment " + n + "\n"; break;
+                        case 1: script += "@rem comment " + n + "\n"; break;
+                        case 2: script += "\"\"\"\nblock comment (" + n + ")\n\"\"\"\n"; break;
+                        default: script += "@remLine(\n    nested (" + n + ") comment\n)\n"; break;
                     }
                 }
             }
-        }
-        
-        std::string varName = cleanCond;
-        if (variables.find(varName) != variables.end()) {
-            return variables[varName] == "TRUE";
-        }
-        
-        return false;
-    }
-    
-    bool isInComment(const std::string& originalCode, size_t pos) {
-        size_t searchPos = 0;
-        while (true) {
-            size_t start = originalCode.find("\"\"\"", searchPos);
-            if (start == std::string::npos || start > pos) break;
-            
-            size_t end = originalCode.find("\"\"\"", start + 3);
-            if (end != std::string::npos && pos >= start && pos <= end) {
-                return true;
-            }
-            searchPos = (end != std::string::npos) ? end + 3 : start + 3;
-        }
-        
-        searchPos = 0;
-        while (true) {
-            size_t start = originalCode.find("@remLine(", searchPos);
-            if (start == std::string::npos || start > pos) break;
-            
-            size_t end = start + 9;
-            int brackets = 1;
-            while (end < originalCode.length() && brackets > 0) {
-                if (originalCode[end] == '(') brackets++;
-                else if (originalCode[end] == ')') brackets--;
-                end++;
-            }
-            
-            if (brackets == 0 && pos >= start && pos <= end) {
-                return true;
+            script += "Print(f\"$[c0]\");\n";
+            break;
+        case ScriptFamily::IfChain:
+            // Only the last branch is taken, so every condition is checked.
+            script += "new variable k numeric = 0;\nrename variable k numeric = " + std::to_string(size) + ";\n";
+            for (int chain = 0; chain < 4; chain++) {
+                script += "if (k == 0) then:\n    Print(\"never\");\n";
+                for (size_t i = 1; i < size; i++) {
+                    script += "else to if (k == " + std::to_string(i) + ") resume:\n    Print(\"never\");\n";
+                }
+                script += "else perform:\n    Print(\"last\");\nendif;\n";
             }
-            searchPos = start + 1;
-        }
-        
-        return false;
+            break;
     }
-    
-    void executeBlock(const std::string& block);
-    void processIfStatement(const std::string& cleanCode);
-    std::string executeInput(const std::string& prompt = "", const std::string& expectedType = "string");
-    void processVariables(const std::string& cleanCode);
-    std::string interpolateVariables(const std::string& text);
-    void executePrint(const std::string& text);
-    void executeSequentially(const std::string& cleanCode);
-    void processVariableLine(const std::string& line, int lineNum);
-    
-public:
-    IornInterpreter() {
-#ifdef _WIN32
-        SetConsoleOutputCP(65001);
-        SetConsoleCP(65001);
-#endif
+    return script;
+}
+
+// `iorn --generate=<family>:<size>` writes a generated script to stdout.
+static bool printGeneratedScript(const std::string& spec) {
+    size_t colon = spec.find(':');
+    size_t size = 0;
+    std::string name = spec.substr(0, colon);
+    if (colon != std::string::npos) {
+        auto result = std::from_chars(spec.data() + colon + 1, spec.data() + spec.length(), size);
+        if (result.ec != std::errc() || result.ptr != spec.data() + spec.length()) size = 0;
     }
-    
-    void interpret(const std::string& code) {
-        std::string cleanCode = removeComments(code);
-        
-        if (!checkSyntax(cleanCode)) {
-            return;
-        }
-        
-        std::regex importDeclaration("import\\s+([\\w\\.]+\\*?);?");
-        bool printDeclared = false;
-        bool inputDeclared = false;
-        
-        std::sregex_iterator iter(cleanCode.begin(), cleanCode.end(), importDeclaration);
-        std::sregex_iterator end;
-        
-        for (; iter != end; ++iter) {
-            std::string importPath = (*iter)[1].str();
-            if (importPath == "terminal.Print" || 
-                importPath == "terminal.*" || 
-                (importPath.find("terminal.") == 0 && importPath.back() == '*')) {
-                printDeclared = true;
-            }
-            if (importPath == "terminal.input" || 
-                importPath == "terminal.*" || 
-                (importPath.find("terminal.") == 0 && importPath.back() == '*')) {
-                inputDeclared = true;
-            }
-        }
-        
-        if (!printDeclared) {
-            setRedColor();
-            std::cerr << "I do not know what Print is! Write its import" << std::endl;
-            resetColor();
-            return;
-        }
-        
-        std::regex inputCallAny("input\\(");
-        if (std::regex_search(cleanCode, inputCallAny) && !inputDeclared) {
-            setRedColor();
-            std::cerr << "I do not know what input is! Write its import" << std::endl;
-            resetColor();
-            return;
-        }
-        
-        // Execute code line by line
-        executeSequentially(cleanCode);
-        
-        // Validate function calls (exclude numbers)
-        std::regex anyFunctionCall("([a-zA-Z_]\\w*)\\(([^)]*)\\);");
-        std::string::const_iterator start2 = cleanCode.cbegin();
-        std::smatch match2;
-        
-        while (std::regex_search(start2, cleanCode.cend(), match2, anyFunctionCall)) {
-            std::string funcName = match2[1].str();
-            if (funcName != "Print" && funcName != "input") {
-                setRedColor();
-                std::cerr << "Unknown function '" << funcName << "()'. Function is not defined or imported." << std::endl;
-                resetColor();
-                return;
-            }
-            start2 = match2.suffix().first;
+    for (const ScriptFamilyInfo& info : scriptFamilies) {
+        if (name == info.name && size > 0) {
+            std::cout << generateScript(info.family, size);
+            return true;
         }
     }
-    
-    void interpretFile(const std::string& filename) {
-        std::ifstream file(filename);
-        if (!file.is_open()) {
-            setRedColor();
-            std::cerr << "Error: Cannot open file " << filename << std::endl;
-            resetColor();
-            return;
+    return false;
+}
+
+// `iorn --bench=scaling`: every script family at six doubling sizes, each
+// run by a fresh interpreter so the front end is measured too. The growth
+// exponent is fitted over the sizes; a family fails when it grows faster
+// than linearly, with some room for noise and logarithmic factors. Returns
+// false if a family failed.
+static bool benchScaling() {
+    const int sizes = 6;
+    const int rounds = 3;
+    const double maxExponent = 1.3;
+    std::ostream discard(nullptr);
+    std::ostream* savedOut = scriptOut;
+    scriptOut = &discard;
+    bool passed = true;
+    for (const ScriptFamilyInfo& info : scriptFamilies) {
+        std::cout << "scaling: " << info.name << " (" << info.unit << ")" << std::endl;
+        double sumX = 0, sumY = 0, sumXX = 0, sumXY = 0;
+        double previousMs = 0;
+        for (int step = 0; step < sizes; step++) {
+            size_t size = info.smallest << step;
+            std::string script = generateScript(info.family, size);
+            double bestMs = 0;
+            for (int r = 0; r < rounds; r++) {
+                IornInterpreter interpreter;
+                auto start = std::chrono::steady_clock::now();
+                interpreter.interpret(script);
+                double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+                bestMs = (r == 0) ? ms : std::min(bestMs, ms);
+            }
+            bestMs = std::max(bestMs, 1e-3);
+            std::cout << "  " << size << ": " << bestMs << " ms";
+            if (step > 0) std::cout << " (x" << bestMs / previousMs << ")";
+            std::cout << std::endl;
+            previousMs = bestMs;
+            double x = std::log2(static_cast<double>(size));
+            double y = std::log2(bestMs);
+            sumX += x;
+            sumY += y;
+            sumXX += x * x;
+            sumXY += x * y;
         }
-        
-        std::string code((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
-        interpret(code);
+        double exponent = (sizes * sumXY - sumX * sumY) / (sizes * sumXX - sumX * sumX);
+        bool ok = exponent <= maxExponent;
+        passed = passed && ok;
+        std::cout << "  growth n^" << exponent << ", limit n^" << maxExponent << ": " << (ok ? "ok" : "FAILED") << std::endl;
     }
+    scriptOut = savedOut;
+    std::cout << "scaling: " << (passed ? "all families linear" : "FAILED") << std::endl;
+    return passed;
+}
+
+// `iorn --self-test`: short scripts whose output is known, each run as a
+// whole and streamed line by line. Returns false if any output or exit
+// status differed.
+struct SelfTestCase {
+    const char* name;
+    const char* script;
+    const char* expected;              // printed text and errors, in order
+    const char* input = "";            // what input() reads
+    size_t maxSteps = 0;               // limits as given on the command line
+    size_t timeoutMs = 0;
+    size_t maxInputs = 0;
+    int status = 0;                    // exit status of the run
 };
 
-// Implementation of forward-declared methods
-double IornInterpreter::evaluateExpression(const std::string& expr) {
-    std::string cleanExpr = expr;
-    cleanExpr.erase(std::remove(cleanExpr.begin(), cleanExpr.end(), ' '), cleanExpr.end());
-    
-    size_t pos = 0;
-    while ((pos = cleanExpr.find("**", pos)) != std::string::npos) {
-        cleanExpr.replace(pos, 2, "^");
-        pos += 1;
+static const SelfTestCase selfTestCases[] = {
+    {"unclosed block comment",
+     "import terminal.*;\nPrint(\"a\");\n\"\"\"\nPrint(\"b\");\nPrint(\"c\");\n",
+     "a\n"},
+    {"unclosed @remLine",
+     "import terminal.*;\nPrint(\"a\"); @remLine( (x)\nPrint(\"b\");\n",
+     "a\n"},
+    {"comment after an unmatched quote",
+     "import terminal.*;\nPrint(\"a\"); ## \"\nPrint(\"b\");\n",
+     "a\nb\n"},
+    {"large and small floats read back",
+     "import terminal.*;\nnew variable a floating = 1.0;\nrename variable a floating = 10.0 ** 22;\n"
+     "new variable b floating = a * 1000.0;\nnew variable c floating = 1.0;\nrename variable c floating = 0.1 ** 10;\n"
+     "new variable d floating = c / 1000.0;\nPrint(f\"$[b] $[d]\");\n"
+     "if (b > a and d < c) then:\n    Print(\"ordered\");\nendif;\n",
+     "10000000000000000905969664.0 0.00000000000010000000000000005\nordered\n"},
+    {"constants folded to large and small floats",
+     "import terminal.*;\nnew variable big floating = 10.0 ** 20;\nnew variable tiny floating = 1.0 / 100000000.0;\n"
+     "new variable both floating = big * tiny;\n"
+     "if (big > 5.0 and tiny < 1.0) then:\n    Print(f\"$[big] $[tiny] $[both]\");\nendif;\n",
+     "100000000000000000000.0 0.00000001 1000000000000.0\n"},
+    {"exponent literals in conditions",
+     "import terminal.*;\nif (1e5 > 99999 and 2.5E-3 < 0.01 and 1e+2 == 100) then:\n    Print(\"a\");\nendif;\n",
+     "a\n"},
+    {"unknown function reported once",
+     "import terminal.*;\nnew variable z numeric = nope(3);\nPrint(\"x\");\n",
+     "Unknown function 'nope()' on line 2. Function is not defined or imported.\nx\n"},
+    {"numeric arrays exact above 2^53",
+     "import terminal.*;\nnew variable xs numeric[] = [9007199254740993, -4];\n"
+     "new variable ys numeric[] = xs * 2 - xs + 1;\nnew variable rs numeric[] = xs % 3;\n"
+     "Print(f\"$[ys] $[rs]\");\n",
+     "[9007199254740994, -3] [0, -1]\n"},
+    {"indexing, sum, min and max above 2^53",
+     "import terminal.*;\nnew variable xs numeric[] = [9007199254740993, 2];\n"
+     "new variable s numeric = sum(xs);\nnew variable hi numeric = max(xs);\nnew variable lo numeric = min(-xs);\n"
+     "new variable first numeric = xs[0];\nrename variable xs[1] numeric = xs[0] + 2;\n"
+     "Print(f\"$[s] $[hi] $[lo] $[first] $[xs]\");\n"
+     "if (xs[0] == 9007199254740992) then:\n    Print(\"rounded\");\nendif;\n"
+     "if (xs[0] < xs[1] and max(xs) > 9007199254740994) then:\n    Print(\"ordered\");\nendif;\n",
+     "9007199254740995 9007199254740993 -9007199254740993 9007199254740993 [9007199254740993, 9007199254740995]\nordered\n"},
+    {"Russian keywords",
+     "import terminal.*;\nновая переменная x numeric = 5;\nизменить переменную x numeric = 7;\n"
+     "новая переменная ok boolean = ИСТИНА;\nновая функция twice(n numeric) numeric:\n    вернуть n * 2;\nконецфункции;\n"
+     "если (x > 9) тогда:\n    Print(\"big\");\nиначе если (twice(x) == 14 and ok) продолжить:\n    Print(f\"twice $[x]\");\n"
+     "иначе выполнить:\n    Print(\"small\");\nконецесли;\nPrint(\"если (x)\");\n",
+     "twice 7\nесли (x)\n"},
+    {"functions: recursion, call depth and argument errors",
+     "import terminal.*;\nnew function fact(n numeric) numeric:\n    if (n <= 1) then:\n        return 1;\n    endif;\n"
+     "    return n * fact(n - 1);\nendfunction;\nnew function down(n numeric) numeric:\n    return down(n + 1);\nendfunction;\n"
+     "new variable f numeric = fact(10);\nPrint(f\"$[f]\");\nnew variable a numeric = fact(\"ten\");\n"
+     "new variable b numeric = fact(1, 2);\nnew variable d numeric = down(0);\nPrint(\"after\");\n",
+     "3628800\nArgument 'n' of 'fact()' must be numeric on line 13.\n"
+     "Wrong number of arguments for 'fact()' on line 14, expected fact(n numeric).\n"
+     "Error: Call depth limit of 1000 reached in 'down()' on line 9.\nafter\n"},
+    {"step limit",
+     "import terminal.*;\nPrint(\"a\");\nPrint(\"b\");\nPrint(\"c\");\n",
+     "a\nb\nError: Step limit of 2 statements reached on line 4.\n", "", 2, 0, 0, 4},
+    {"time limit",
+     "import terminal.*;\nnew function spin(n numeric) numeric:\n    if (n <= 0) then:\n        return 0;\n    endif;\n"
+     "    return spin(n - 1) + spin(n - 1);\nendfunction;\nnew variable s numeric = spin(60);\nPrint(\"done\");\n",
+     "Error: Time limit of 20 ms reached on line 8.\n", "", 0, 20, 0, 5},
+    {"input limit",
+     "import terminal.*;\nnew variable x numeric = input(\"x: \");\nnew variable y numeric = input(\"y: \");\n"
+     "Print(f\"$[x] $[y]\");\n",
+     "x: y: Error: Please enter a valid integer number.\nError: Input limit of 2 reads reached on line 3.\n",
+     "1\nzz\n2\n", 0, 0, 2, 6},
+    {"input ended",
+     "import terminal.*;\nnew variable x numeric = input(\"x: \");\nnew variable y numeric = input(\"y: \");\n",
+     "x: y: Error: Input ended before line 3 could read a value.\n", "1\n", 0, 0, 0, 6}
+};
+
+// Every finite double must read back as itself from the text formatNumber()
+// writes for it.
+static bool numbersReadBack() {
+    const double values[] = {
+        0.0, 0.1, -2.5, 123456.789, 1e20, -1e22, 1.0000000000000005e-08, 1e-300,
+        std::numeric_limits<double>::max(), std::numeric_limits<double>::min(),
+        std::numeric_limits<double>::denorm_min(), -std::numeric_limits<double>::denorm_min()
+    };
+    bool passed = true;
+    std::string text;
+    for (double value : values) {
+        double back = 0;
+        bool ok = formatNumber(value, false, text) && parseNumber(text, back) == NumberForm::Decimal && back == value;
+        if (!ok) std::cout << "  " << text << " does not read back as " << value << std::endl;
+        passed = passed && ok;
     }
-    
-    return evaluateWithPrecedence(cleanExpr);
+    return passed;
 }
 
-double IornInterpreter::evaluateWithPrecedence(const std::string& expr) {
-    if (expr.empty()) return 0;
-    
-    std::string workExpr = expr;
-    while (workExpr.find('(') != std::string::npos) {
-        size_t start = workExpr.find_last_of('(');
-        size_t end = workExpr.find(')', start);
-        if (end == std::string::npos) break;
-        
-        std::string subExpr = workExpr.substr(start + 1, end - start - 1);
-        double result = evaluateWithPrecedence(subExpr);
-        
-        workExpr = workExpr.substr(0, start) + std::to_string(result) + workExpr.substr(end + 1);
+// Numbers past the range of a double are not numbers; ones below it are 0.
+static bool numbersOutOfRange() {
+    double value = 1;
+    std::string huge(400, '9');
+    std::string tiny = "0." + std::string(400, '0') + "1";
+    return parseNumber(huge, value) == NumberForm::None && parseNumber("-" + huge + ".5", value) == NumberForm::None &&
+           parseNumber(tiny, value) == NumberForm::Decimal && value == 0;
+}
+
+// Incremental edits in the language server: each didChange replaces ranges
+// given in UTF-16 columns, and the diagnostics published after it must
+// describe the edited text.
+static bool languageServerEdits() {
+    auto frame = [](const std::string& body) { return "Content-Length: " + std::to_string(body.length()) + "\r\n\r\n" + body; };
+    auto change = [&](const std::string& edits) {
+        return frame("{\"jsonrpc\":\"2.0\",\"method\":\"textDocument/didChange\",\"params\":{\"textDocument\":"
+                     "{\"uri\":\"file:///t.iorn\"},\"contentChanges\":[" + edits + "]}}");
+    };
+    auto edit = [](int line, int character, int endLine, int endCharacter, const std::string& text) {
+        return "{\"range\":{\"start\":{\"line\":" + std::to_string(line) + ",\"character\":" + std::to_string(character) +
+               "},\"end\":{\"line\":" + std::to_string(endLine) + ",\"character\":" + std::to_string(endCharacter) +
+               "}},\"text\":\"" + text + "\"}";
+    };
+    std::string input =
+        frame("{\"jsonrpc\":\"2.0\",\"method\":\"textDocument/didOpen\",\"params\":{\"textDocument\":{\"uri\":\"file:///t.iorn\","
+              "\"text\":\"import terminal.*;\\nnew variable x numeric = 5;\\nPrint(\\\"\U0001F600\\\");\\n\"}}}") +
+        change(edit(1, 25, 1, 26, "\\\"five\\\"")) +
+        // The emoji is two UTF-16 units: column 11 is the ';' after `)`.
+        change(edit(1, 25, 1, 31, "6") + "," + edit(2, 11, 3, 0, "\\nPrint(\\\"b\\\")\\n")) +
+        change(edit(2, 11, 2, 11, ";") + "," + edit(3, 10, 3, 10, ";")) +
+        frame("{\"jsonrpc\":\"2.0\",\"method\":\"exit\"}");
+    std::istringstream in(input);
+    std::ostringstream out;
+    LanguageServer(in, out).run();
+    const char* expected[] = {
+        "\"diagnostics\":[]",
+        "\"message\":\"Invalid numeric value '\\\"five\\\"' on line 2.\"",
+        "{\"range\":{\"start\":{\"line\":2,\"character\":0},\"end\":{\"line\":2,\"character\":11}},\"severity\":1,"
+        "\"source\":\"iorn\",\"message\":\"There is no ending on 3 page 14 character!\"}",
+        "\"message\":\"There is no ending on 4 page 11 character!\"",
+        "\"diagnostics\":[]"
+    };
+    std::string published = out.str();
+    size_t at = 0;
+    for (const char* text : expected) {
+        at = published.find(text, at);
+        if (at == std::string::npos) {
+            std::cout << "  not published: " << text << std::endl;
+            return false;
+        }
+        at += std::strlen(text);
     }
-    
-    if (workExpr.find_first_of("+-*/%^") == std::string::npos) {
-        return std::stod(workExpr);
+    return true;
+}
+
+// Runs `test` whole and streamed, as a script at `scriptPath` if one is
+// given, and prints how each run went.
+static bool runSelfTestCase(const SelfTestCase& test, const std::string& scriptPath = std::string()) {
+    bool passed = true;
+    for (bool stream : {false, true}) {
+        std::ostringstream out;
+        std::ostream* savedOut = scriptOut;
+        std::ostream* savedErr = scriptErr;
+        scriptOut = scriptErr = &out;
+#ifndef _WIN32
+        InputReader input{std::string(test.input)};
+        scriptInput = &input;
+#endif
+        InterpreterOptions options;
+        options.maxSteps = test.maxSteps;
+        options.timeoutMs = test.timeoutMs;
+        options.maxInputs = test.maxInputs;
+        IornInterpreter interpreter;
+        interpreter.setOptions(options);
+        if (!scriptPath.empty()) interpreter.setScriptPath(scriptPath);
+        if (stream) {
+            std::istringstream in(test.script);
+            interpreter.interpretStream(in);
+        } else {
+            interpreter.interpret(test.script);
+        }
+        scriptOut = savedOut;
+        scriptErr = savedErr;
+#ifndef _WIN32
+        scriptInput = &standardInput;
+#endif
+        int status = exitStatus(interpreter.lastRunStats().status);
+        bool ok = out.str() == test.expected && status == test.status;
+        passed = passed && ok;
+        std::cout << (ok ? "ok: " : "FAILED: ") << test.name << (stream ? " (streamed)" : "") << std::endl;
+        if (!ok) {
+            std::cout << "  expected:\n" << test.expected << "  printed:\n" << out.str();
+            if (status != test.status) std::cout << "  exit status " << status << ", expected " << test.status << std::endl;
+        }
     }
-    
-    while (workExpr.find('^') != std::string::npos) {
-        size_t opPos = workExpr.find('^');
-        size_t leftStart = findNumberStart(workExpr, opPos - 1);
-        size_t rightEnd = findNumberEnd(workExpr, opPos + 1);
-        
-        double left = std::stod(workExpr.substr(leftStart, opPos - leftStart));
-        double right = std::stod(workExpr.substr(opPos + 1, rightEnd - opPos - 1));
-        double result = std::pow(left, right);
-        
-        workExpr = workExpr.substr(0, leftStart) + std::to_string(result) + workExpr.substr(rightEnd);
+    return passed;
+}
+
+// Modules imported from next to the script, and imports that form a cycle.
+// The modules are written to a fresh temporary directory, which is removed
+// afterwards. Like the cases above, each script runs whole and streamed.
+static bool modulesImported() {
+    const char* modules[][2] = {
+        {"lib.iorn", "import terminal.Print;\nPrint(\"lib runs\");\nnew variable greeting string = \"Hello\";\n"
+                     "new variable answer numeric = 42;\n"},
+        {"cyc_a.iorn", "import cyc_b.*;\nnew variable a numeric = 1;\n"},
+        {"cyc_b.iorn", "import cyc_a.*;\nnew variable b numeric = 1;\n"}
+    };
+    const SelfTestCase scripts[] = {
+        {"modules",
+         "import terminal.*;\nimport lib.answer;\nimport lib.greeting;\nPrint(\"before use\");\n"
+         "Print(f\"$[greeting] $[answer]\");\n",
+         "before use\nlib runs\nHello 42\n"},
+        {"circular import",
+         "import terminal.*;\nimport cyc_a.a;\nPrint(\"after\");\n",
+         "Circular import of module 'cyc_a' on line 1.\nModule 'cyc_b' could not be loaded.\n"
+         "Module 'cyc_a' could not be loaded.\n"}
+    };
+#ifdef _WIN32
+    std::error_code error;
+    std::filesystem::path base = std::filesystem::temp_directory_path(error) /
+                                 ("iorn-self-test-" + std::to_string(GetCurrentProcessId()));
+    bool created = !error && std::filesystem::create_directories(base, error);
+    std::string directory = base.string();
+#else
+    const char* temp = std::getenv("TMPDIR");
+    std::string directory = std::string(temp && *temp ? temp : "/tmp") + "/iorn-self-test-XXXXXX";
+    bool created = mkdtemp(directory.data()) != nullptr;
+#endif
+    if (!created) {
+        std::cout << "FAILED: modules, no temporary directory for them" << std::endl;
+        return false;
     }
-    
-    size_t pos = 0;
-    while ((pos = workExpr.find_first_of("*/%", pos)) != std::string::npos) {
-        char op = workExpr[pos];
-        size_t leftStart = findNumberStart(workExpr, pos - 1);
-        size_t rightEnd = findNumberEnd(workExpr, pos + 1);
-        
-        double left = std::stod(workExpr.substr(leftStart, pos - leftStart));
-        double right = std::stod(workExpr.substr(pos + 1, rightEnd - pos - 1));
-        double result = 0;
-        
-        if (op == '*') result = left * right;
-        else if (op == '/') result = (right != 0) ? left / right : 0;
-        else if (op == '%') result = std::fmod(left, right);
-        
-        workExpr = workExpr.substr(0, leftStart) + std::to_string(result) + workExpr.substr(rightEnd);
-        pos = leftStart;
+    for (const auto& module : modules) {
+        std::ofstream(directory + "/" + module[0]) << module[1];
     }
-    
-    pos = 0;
-    while ((pos = workExpr.find_first_of("+-", pos)) != std::string::npos) {
-        if (pos == 0) { pos++; continue; }
-        
-        char op = workExpr[pos];
-        size_t leftStart = findNumberStart(workExpr, pos - 1);
-        size_t rightEnd = findNumberEnd(workExpr, pos + 1);
-        
-        double left = std::stod(workExpr.substr(leftStart, pos - leftStart));
-        double right = std::stod(workExpr.substr(pos + 1, rightEnd - pos - 1));
-        double result = (op == '+') ? left + right : left - right;
-        
-        workExpr = workExpr.substr(0, leftStart) + std::to_string(result) + workExpr.substr(rightEnd);
-        pos = leftStart;
+
+    bool passed = true;
+    for (const SelfTestCase& test : scripts) {
+        passed = runSelfTestCase(test, directory + "/main.iorn") && passed;
     }
-    
-    return std::stod(workExpr);
-}
 
-size_t IornInterpreter::findNumberStart(const std::string& expr, size_t pos) {
-    while (pos > 0 && (std::isdigit(expr[pos]) || expr[pos] == '.' || expr[pos] == '-')) {
-        pos--;
+    for (const auto& module : modules) {
+        std::remove((directory + "/" + module[0]).c_str());
     }
-    if (pos > 0 && !std::isdigit(expr[pos]) && expr[pos] != '.' && expr[pos] != '-') pos++;
-    return pos;
+#ifdef _WIN32
+    std::filesystem::remove(base, error);
+#else
+    rmdir(directory.c_str());
+#endif
+    return passed;
 }
 
-size_t IornInterpreter::findNumberEnd(const std::string& expr, size_t pos) {
-    while (pos < expr.length() && (std::isdigit(expr[pos]) || expr[pos] == '.' || (pos == 0 && expr[pos] == '-'))) {
-        pos++;
+// A save under `iorn --watch`: the same interpreter runs the edited script
+// and parses again only the statement that changed.
+static bool watchReparse() {
+    const char* saved = "import terminal.*;\nnew variable x numeric = 5;\nPrint(f\"$[x]\");\nPrint(\"end\");\n";
+    const char* edited = "import terminal.*;\nnew variable x numeric = 6;\nPrint(f\"$[x]\");\nPrint(\"end\");\n";
+    std::ostringstream out;
+    std::ostream* savedOut = scriptOut;
+    std::ostream* savedErr = scriptErr;
+    scriptOut = scriptErr = &out;
+    IornInterpreter interpreter;
+    interpreter.interpret(saved);
+    interpreter.reset();
+    interpreter.interpret(edited);
+    scriptOut = savedOut;
+    scriptErr = savedErr;
+    const RunStats& stats = interpreter.lastRunStats();
+    bool ok = out.str() == "5\nend\n6\nend\n" && stats.parsedStatements == 1;
+    if (!ok) std::cout << "  " << stats.parsedStatements << " of " << stats.statements << " statements parsed, printed:\n" << out.str();
+    return ok;
+}
+
+// Over-aligned objects get their alignment from the replaced operator new,
+// also while memory is charged to an account.
+static bool alignedAllocations() {
+    struct alignas(64) CacheLine { char bytes[64]; };
+    MemoryAccount* account = MemoryAccount::create();
+    bool aligned = true;
+    memoryAccounting.store(true, std::memory_order_relaxed);
+    {
+        MemoryScope scope(account);
+        auto one = std::make_unique<CacheLine>();
+        auto many = std::make_unique<CacheLine[]>(3);
+        aligned = reinterpret_cast<uintptr_t>(one.get()) % 64 == 0 && reinterpret_cast<uintptr_t>(many.get()) % 64 == 0;
     }
-    return pos;
+    bool credited = account->peak.load(std::memory_order_relaxed) >= 4 * sizeof(CacheLine) && account->current() == 0;
+    account->release();
+    return aligned && credited;
 }
 
-std::string IornInterpreter::executeInput(const std::string& prompt, const std::string& expectedType) {
-    std::string input;
-    while (true) {
-        if (!prompt.empty()) {
-            std::cout << prompt << std::flush;
-        }
-        
+static bool selfTest() {
+    bool passed = true;
+    for (const SelfTestCase& test : selfTestCases) {
 #ifdef _WIN32
-        // Для Windows читаем через широкие символы
-        wchar_t wbuffer[1024];
-        DWORD charsRead;
-        HANDLE hStdin = GetStdHandle(STD_INPUT_HANDLE);
-        if (ReadConsoleW(hStdin, wbuffer, sizeof(wbuffer)/sizeof(wchar_t) - 1, &charsRead, NULL)) {
-            wbuffer[charsRead] = L'\0';
-            // Убираем \r\n в конце
-            std::wstring winput(wbuffer);
-            while (!winput.empty() && (winput.back() == L'\r' || winput.back() == L'\n')) {
-                winput.pop_back();
-            }
-            // Преобразуем в UTF-8
-            if (!winput.empty()) {
-                int size_needed = WideCharToMultiByte(CP_UTF8, 0, winput.c_str(), (int)winput.size(), NULL, 0, NULL, NULL);
-                input.resize(size_needed);
-                WideCharToMultiByte(CP_UTF8, 0, winput.c_str(), (int)winput.size(), &input[0], size_needed, NULL, NULL);
-            } else {
-                input = "";
-            }
-        } else {
-            input = "";
-        }
-#else
-        if (!std::getline(std::cin, input)) {
-            input = "";
-            break;
-        }
+        // Input is read from the console there.
+        if (*test.input) continue;
 #endif
-        
-        // Убираем возможные символы \r в конце строки
-        if (!input.empty() && input.back() == '\r') {
-            input.pop_back();
+        passed = runSelfTestCase(test) && passed;
+    }
+    bool numbers = numbersReadBack();
+    std::cout << (numbers ? "ok: " : "FAILED: ") << "numbers read back" << std::endl;
+    passed = passed && numbers;
+    bool outOfRange = numbersOutOfRange();
+    std::cout << (outOfRange ? "ok: " : "FAILED: ") << "numbers out of range" << std::endl;
+    passed = passed && outOfRange;
+    bool modules = modulesImported();
+    passed = passed && modules;
+    bool edits = languageServerEdits();
+    std::cout << (edits ? "ok: " : "FAILED: ") << "language server edits" << std::endl;
+    passed = passed && edits;
+    bool watched = watchReparse();
+    std::cout << (watched ? "ok: " : "FAILED: ") << "watch re-parse" << std::endl;
+    passed = passed && watched;
+    bool aligned = alignedAllocations();
+    std::cout << (aligned ? "ok: " : "FAILED: ") << "over-aligned allocations" << std::endl;
+    passed = passed && aligned;
+    std::cout << "self-test: " << (passed ? "all passed" : "FAILED") << std::endl;
+    return passed;
+}
+
+// `iorn --bench=scan [file.iorn]`: structural indexing, and preprocessing
+// (comment stripping, keyword translation and line splitting) on the same
+// corpus, once per available scan mode.
+static void benchScan(const std::string& corpus) {
+    std::vector<ScanMode> modes = {ScanMode::Scalar};
+#ifdef IORN_SCAN_X86
+    if (__builtin_cpu_supports("sse2")) modes.push_back(ScanMode::Sse2);
+    if (__builtin_cpu_supports("avx2")) modes.push_back(ScanMode::Avx2);
+#endif
+    const int rounds = std::max<int>(3, static_cast<int>((256u << 20) / std::max<size_t>(corpus.length(), 1)));
+    std::cout << "corpus: " << corpus.length() << " bytes, " << rounds << " rounds" << std::endl;
+    
+    for (ScanMode mode : modes) {
+        size_t checksum = 0;
+        auto start = std::chrono::steady_clock::now();
+        for (int r = 0; r < rounds; r++) {
+            StructuralIndex index(corpus, mode);
+            checksum += index.count(ScanNewline);
         }
-        
-        // Для строкового типа принимаем любой ввод
-        if (expectedType == "string") {
-            break;
+        auto mid = std::chrono::steady_clock::now();
+        std::string translated;
+        for (int r = 0; r < rounds; r++) {
+            std::string stripped = stripComments(corpus, mode);
+            if (translateKeywords(stripped, translated)) stripped.swap(translated);
+            StructuralIndex index(stripped, mode);
+            checksum += splitLines(stripped, index).size();
         }
+        auto end = std::chrono::steady_clock::now();
         
-        if (expectedType == "numeric") {
-            if (std::regex_match(input, std::regex("^-?\\d+$"))) {
-                break;
-            } else {
-                setRedColor();
-                std::cerr << "Error: Please enter a valid integer number." << std::endl;
-                resetColor();
-            }
-        } else if (expectedType == "floating") {
-            if (std::regex_match(input, std::regex("^-?\\d+\\.\\d+$"))) {
-                break;
-            } else {
-                setRedColor();
-                std::cerr << "Error: Please enter a valid floating point number (e.g., 1.5)." << std::endl;
-                resetColor();
-            }
-        } else if (expectedType == "boolean") {
-            if (input == "TRUE" || input == "FALSE" || input == "true" || input == "false") {
-                if (input == "true") input = "TRUE";
-                if (input == "false") input = "FALSE";
-                break;
-            } else {
-                setRedColor();
-                std::cerr << "Error: Please enter TRUE/FALSE or true/false." << std::endl;
-                resetColor();
-            }
+        double bytes = static_cast<double>(corpus.length()) * rounds;
+        double indexSec = std::chrono::duration<double>(mid - start).count();
+        double preprocessSec = std::chrono::duration<double>(end - mid).count();
+        std::cout << scanModeName(mode) << ": index " << bytes / indexSec / 1e9 << " GB/s, "
+                  << "preprocess " << bytes / preprocessSec / 1e9 << " GB/s"
+                  << " (checksum " << checksum << ")" << std::endl;
+    }
+}
+
+// Operand of a condition for `--bench=cond`, with failures reported either as
+// an EvalResult, as the interpreter does, or thrown and caught around the
+// operand, as conditions did before. Everything else is the same code.
+template <bool Throwing>
+static EvalResult<double> benchNumber(const CompiledCondition& cond, int idx, const std::unordered_map<std::string, std::string>& variables) {
+    const CondNode& node = cond.nodes[idx];
+    auto fail = [idx](EvalError error) -> EvalResult<double> {
+        if constexpr (Throwing) {
+            throw std::invalid_argument("not a number");
         } else {
-            // Для всех остальных типов тоже принимаем ввод
-            break;
+            return {0, error, idx};
         }
+    };
+    switch (node.op) {
+        case CondOp::IntLit:
+        case CondOp::FloatLit:
+            return {node.number};
+        case CondOp::StringLit:
+            if (!node.numericText) return fail(EvalError::NotNumeric);
+            return {node.number};
+        case CondOp::Slot: {
+            auto it = variables.find(node.text);
+            double number = 0;
+            if (it == variables.end()) return fail(EvalError::UndeclaredVariable);
+            if (parseNumber(it->second, number) == NumberForm::None) return fail(EvalError::NotNumeric);
+            return {number};
+        }
+        case CondOp::Add: case CondOp::Sub: case CondOp::Mul: {
+            EvalResult<double> left = benchNumber<Throwing>(cond, node.lhs, variables);
+            if (!left) return left;
+            EvalResult<double> right = benchNumber<Throwing>(cond, node.rhs, variables);
+            if (!right) return right;
+            if (node.op == CondOp::Add) return {left.value + right.value};
+            return {node.op == CondOp::Sub ? left.value - right.value : left.value * right.value};
+        }
+        default:
+            return fail(EvalError::InvalidExpression);
     }
-    return input;
 }
 
-void IornInterpreter::processVariables(const std::string& cleanCode) {
-    std::istringstream stream(cleanCode);
-    std::string line;
-    int lineNum = 0;
-    
-    while (std::getline(stream, line)) {
-        lineNum++;
-        
-        if (line.find("new variable") != std::string::npos) {
-            std::regex nullDeclaration("new variable\\s+(\\w+)\\s+NULL;");
-            std::smatch nullMatch;
-            if (std::regex_search(line, nullMatch, nullDeclaration)) {
-                std::string varName = nullMatch[1].str();
-                variables[varName] = "null";
-                continue;
-            }
-            
-            std::regex varDeclaration("new variable\\s+(\\w+)\\s+(string|numeric|floating|boolean)\\s*=\\s*([^;]+);");
-            std::smatch match;
-            
-            if (std::regex_search(line, match, varDeclaration)) {
-                std::string varName = match[1].str();
-                std::string varType = match[2].str();
-                std::string varValue = match[3].str();
-                
-                if (varValue.find_first_of("+-*/%^") != std::string::npos || varValue.find("**") != std::string::npos) {
-                    if (varType == "numeric" || varType == "floating") {
-                        try {
-                            double result = evaluateExpression(varValue);
-                            if (varType == "numeric") {
-                                varValue = std::to_string(static_cast<int>(result));
-                            } else {
-                                varValue = std::to_string(result);
-                            }
-                        } catch (...) {
-                            setRedColor();
-                            std::cerr << "Invalid mathematical expression on line " << lineNum << "." << std::endl;
-                            resetColor();
-                            continue;
-                        }
-                    }
-                }
-                
-                bool isInputCall = varValue.find("input(") != std::string::npos;
-                if (isInputCall) {
-                    std::regex inputCall("input\\((\"[^\"]*\"|[^)]*)\\)");
-                    std::smatch inputMatch;
-                    if (std::regex_search(varValue, inputMatch, inputCall)) {
-                        std::string prompt = inputMatch[1].str();
-                        if (!prompt.empty() && prompt.front() == '"' && prompt.back() == '"') {
-                            prompt = prompt.substr(1, prompt.length() - 2);
-                        }
-                        std::string inputValue = executeInput(prompt, varType);
-                        variables[varName] = inputValue;
+template <bool Throwing>
+static bool benchCondition(const CompiledCondition& cond, int idx, const std::unordered_map<std::string, std::string>& variables) {
+    const CondNode& node = cond.nodes[idx];
+    switch (node.op) {
+        case CondOp::Not:
+            return !benchCondition<Throwing>(cond, node.lhs, variables);
+        case CondOp::And:
+            return benchCondition<Throwing>(cond, node.lhs, variables) && benchCondition<Throwing>(cond, node.rhs, variables);
+        case CondOp::Or:
+            return benchCondition<Throwing>(cond, node.lhs, variables) || benchCondition<Throwing>(cond, node.rhs, variables);
+        case CondOp::Eq: case CondOp::Ne: case CondOp::Ge:
+        case CondOp::Le: case CondOp::Gt: case CondOp::Lt: {
+            auto operand = [&](int side) -> EvalResult<double> {
+                if constexpr (Throwing) {
+                    try {
+                        return benchNumber<true>(cond, side, variables);
+                    } catch (const std::invalid_argument&) {
+                        return {0, EvalError::NotNumeric, side};
                     }
                 } else {
-                    if (!validateVariable(varName, varType, varValue, lineNum)) {
-                        continue;
-                    }
-                    
-                    std::string trimmedValue = varValue;
-                    trimmedValue.erase(0, trimmedValue.find_first_not_of(" \t"));
-                    trimmedValue.erase(trimmedValue.find_last_not_of(" \t") + 1);
-                    
-                    if (varType == "string" && trimmedValue.front() == '"' && trimmedValue.back() == '"') {
-                        trimmedValue = trimmedValue.substr(1, trimmedValue.length() - 2);
-                    }
-                    
-                    variables[varName] = trimmedValue;
+                    return benchNumber<false>(cond, side, variables);
                 }
+            };
+            auto text = [&](int side) -> std::string_view {
+                const CondNode& operandNode = cond.nodes[side];
+                auto it = operandNode.op == CondOp::Slot ? variables.find(operandNode.text) : variables.end();
+                return it != variables.end() ? std::string_view(it->second) : std::string_view(operandNode.text);
+            };
+            EvalResult<double> left = operand(node.lhs);
+            EvalResult<double> right = operand(node.rhs);
+            if (left && right) return applyComparison(node.op, left.value, right.value);
+            return applyComparison(node.op, text(node.lhs), text(node.rhs));
+        }
+        default:
+            return false;
+    }
+}
+
+// `iorn --bench=cond`: the conditions of if statements comparing strings and
+// numbers, compiled once and evaluated with operand failures returned as
+// EvalResult and, for contrast, thrown and caught. Comparing strings fails to
+// read every operand as a number, so that is where the two differ.
+static void benchConditions() {
+    const int count = 2000;
+    const int rounds = 200;
+    std::unordered_map<std::string, std::string> variables;
+    std::vector<std::pair<const char*, std::vector<CompiledCondition>>> kinds = {{"strings", {}}, {"numbers", {}}};
+    for (int i = 0; i < count; i++) {
+        std::string n = std::to_string(i);
+        variables["s" + n] = "name" + n;
+        variables["x" + n] = n;
+        std::string sources[] = {
+            "s" + n + " == \"name" + std::to_string(i + 1) + "\" or s" + n + " != \"name" + n + "\"",
+            "x" + n + " + 1 == " + std::to_string(i + 2) + " or x" + n + " * 2 < " + n
+        };
+        for (size_t k = 0; k < kinds.size(); k++) {
+            CompiledCondition& condition = kinds[k].second.emplace_back();
+            if (!ConditionCompiler(sources[k]).compile(condition)) {
+                std::cerr << "Error: Benchmark condition '" << sources[k] << "' does not compile" << std::endl;
+                return;
             }
         }
-        
-        if (line.find("rename variable") != std::string::npos) {
-            std::regex renameDeclaration("rename variable\\s+(\\w+)\\s+(string|numeric|floating|boolean)\\s*=\\s*([^;]+);");
-            std::smatch match;
-            
-            if (std::regex_search(line, match, renameDeclaration)) {
-                std::string varName = match[1].str();
-                std::string varType = match[2].str();
-                std::string varValue = match[3].str();
-                
-                if (variables.find(varName) == variables.end()) {
-                    setRedColor();
-                    std::cerr << "Variable '" << varName << "' does not exist for rename on line " << lineNum << "." << std::endl;
-                    resetColor();
-                    continue;
-                }
-                
-                if (varValue.find("input(") != std::string::npos) {
-                    std::regex inputCall("input\\((\"[^\"]*\"|[^)]*)\\)");
-                    std::smatch inputMatch;
-                    if (std::regex_search(varValue, inputMatch, inputCall)) {
-                        std::string prompt = inputMatch[1].str();
-                        if (!prompt.empty() && prompt.front() == '"' && prompt.back() == '"') {
-                            prompt = prompt.substr(1, prompt.length() - 2);
-                        }
-                        std::string inputValue = executeInput(prompt, varType);
-                        variables[varName] = inputValue;
-                    }
-                } else {
-                    std::string trimmedValue = varValue;
-                    trimmedValue.erase(0, trimmedValue.find_first_not_of(" \t"));
-                    trimmedValue.erase(trimmedValue.find_last_not_of(" \t") + 1);
-                    
-                    if (varType == "string" && trimmedValue.front() == '"' && trimmedValue.back() == '"') {
-                        trimmedValue = trimmedValue.substr(1, trimmedValue.length() - 2);
-                    }
-                    
-                    variables[varName] = trimmedValue;
-                }
+    }
+    std::cout << "conditions: " << count << " per kind, 2 comparisons each, " << rounds << " rounds" << std::endl;
+
+    auto measure = [&](const char* path, const std::vector<CompiledCondition>& conditions, auto&& evaluate) {
+        size_t taken = 0;
+        auto start = std::chrono::steady_clock::now();
+        for (int r = 0; r < rounds; r++) {
+            for (const CompiledCondition& condition : conditions) {
+                taken += evaluate(condition, condition.root, variables);
             }
         }
+        double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        double comparisons = 2.0 * static_cast<double>(conditions.size()) * rounds;
+        std::cout << "  " << path << ": " << ms / rounds << " ms per round, "
+                  << comparisons / (ms / 1000) / 1e6 << " M comparisons/s (taken " << taken << ")" << std::endl;
+    };
+    for (const auto& [name, conditions] : kinds) {
+        std::cout << name << ":" << std::endl;
+        measure("EvalResult", conditions, benchCondition<false>);
+        measure("throw/catch", conditions, benchCondition<true>);
     }
 }
 
-std::string IornInterpreter::interpolateVariables(const std::string& text) {
-    std::string result = text;
-    std::regex varPattern("\\$\\[(\\w+)\\]");
-    std::smatch match;
-    
-    while (std::regex_search(result, match, varPattern)) {
-        std::string varName = match[1].str();
-        if (variables.find(varName) != variables.end()) {
-            result.replace(match.position(), match.length(), variables[varName]);
+// `iorn --bench=arrays`: builtins and element-wise arithmetic on arrays of
+// ten million elements. Each operation is timed as the difference between a
+// run with it and a run without it, next to a plain C++ loop.
+static void benchArrays() {
+    const size_t count = 10000000;
+    const int rounds = 3;
+    std::string base = "import terminal.*;\n"
+                       "new variable xs numeric[] = range(" + std::to_string(count) + ");\n"
+                       "new variable ys floating[] = xs * 0.5;\n";
+    std::cout << "arrays: " << count << " elements, " << rounds << " rounds" << std::endl;
+
+    IornInterpreter interpreter;
+    auto run = [&](const std::string& script) {
+        double executeMs = 0;
+        for (int r = 0; r < rounds; r++) {
+            interpreter.reset();
+            interpreter.interpret(script);
+            executeMs += interpreter.lastRunStats().executeMs;
         }
+        return executeMs / rounds;
+    };
+    double baseMs = run(base);
+    static const std::pair<const char*, const char*> operations[] = {
+        {"sum(xs)", "new variable r numeric = sum(xs);\n"},
+        {"min(xs)", "new variable r numeric = min(xs);\n"},
+        {"max(xs)", "new variable r numeric = max(xs);\n"},
+        {"sum(ys)", "new variable r floating = sum(ys);\n"},
+        {"xs * 2 + 1", "rename variable ys floating[] = xs * 2 + 1;\n"}
+    };
+    for (const auto& operation : operations) {
+        double ms = std::max(run(base + operation.second) - baseMs, 1e-3);
+        std::cout << "interpreter " << operation.first << ": " << ms << " ms, "
+                  << static_cast<double>(count) / (ms / 1000) / 1e6 << " M elements/s" << std::endl;
     }
-    
-    return result;
+
+    std::vector<long long> native(count);
+    std::iota(native.begin(), native.end(), 0);
+    auto start = std::chrono::steady_clock::now();
+    long long checksum = std::accumulate(native.begin(), native.end(), 0LL);
+    double nativeMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    std::cout << "native C++ sum: " << nativeMs << " ms, " << static_cast<double>(count) / (nativeMs / 1000) / 1e6
+              << " M elements/s (checksum " << checksum << ")" << std::endl;
 }
 
-void IornInterpreter::executePrint(const std::string& text) {
-    std::string output = text.substr(1, text.length() - 2);
-    
-    if (text.length() > 2 && text.substr(0, 2) == "f\"") {
-        output = text.substr(2, text.length() - 3);
-        output = interpolateVariables(output);
-    }
-    
-    std::cout << output << std::endl;
+static long long nativeFib(long long n) {
+    return n < 2 ? n : nativeFib(n - 1) + nativeFib(n - 2);
 }
 
-void IornInterpreter::executeBlock(const std::string& block) {
-    std::string trimmedBlock = block;
-    trimmedBlock.erase(0, trimmedBlock.find_first_not_of(" \t\n\r"));
-    trimmedBlock.erase(trimmedBlock.find_last_not_of(" \t\n\r") + 1);
-    
-    if (trimmedBlock == "ignore" || trimmedBlock.empty() || trimmedBlock == "ignore;") {
-        return;
+// `iorn --bench=fib`: a recursive fib(25) run by the interpreter, as calls
+// per second next to the same function compiled as C++.
+static void benchFib() {
+    const int n = 25;
+    const int rounds = 5;
+    std::string script =
+        "import terminal.*;\n"
+        "new function fib(n numeric) numeric:\n"
+        "    if (n < 2) then:\n"
+        "        return n;\n"
+        "    endif;\n"
+        "    return fib(n - 1) + fib(n - 2);\n"
+        "endfunction;\n"
+        "new variable result numeric = fib(" + std::to_string(n) + ");\n";
+    double calls = 0;
+    for (int i = n, a = 1, b = 1; i > 0; i--) {  // fib(n) makes 2 * fib(n + 1) - 1 calls
+        calls = 2.0 * b - 1;
+        int next = a + b;
+        a = b;
+        b = next;
     }
-    
-    std::regex printCall("Print\\((f?\"[^\"]*\")\\);");
-    std::sregex_iterator iter(block.begin(), block.end(), printCall);
-    std::sregex_iterator end;
-    
-    for (; iter != end; ++iter) {
-        std::string text = (*iter)[1].str();
-        executePrint(text);
+    std::cout << "fib(" << n << "): " << calls << " calls, " << rounds << " rounds" << std::endl;
+
+    IornInterpreter interpreter;
+    double executeMs = 0;
+    for (int r = 0; r < rounds; r++) {
+        interpreter.reset();
+        interpreter.interpret(script);
+        executeMs += interpreter.lastRunStats().executeMs;
+    }
+
+    volatile int argument = n;  // keeps the compiler from folding the calls
+    long long checksum = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (int r = 0; r < rounds; r++) {
+        checksum += nativeFib(argument);
     }
+    double nativeMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+    std::cout << "interpreter: " << executeMs / rounds << " ms per run, "
+              << calls / (executeMs / rounds / 1000) / 1e6 << " M calls/s" << std::endl;
+    std::cout << "native C++: " << nativeMs / rounds << " ms per run, "
+              << calls / (nativeMs / rounds / 1000) / 1e6 << " M calls/s (checksum " << checksum << ")" << std::endl;
 }
 
-void IornInterpreter::executeSequentially(const std::string& cleanCode) {
-    std::istringstream stream(cleanCode);
-    std::string line;
-    std::vector<std::string> lines;
-    
-    // Collect all lines
-    while (std::getline(stream, line)) {
-        if (!line.empty() && line.find("import ") == std::string::npos) {
-            lines.push_back(line);
+// `iorn --bench=numbers`: parsing and formatting of numbers through the
+// conversion layer, next to the regex/std::stod/std::to_string path it
+// replaced.
+static void benchNumbers() {
+    const size_t count = 1u << 20;
+    std::vector<std::string> texts;
+    std::vector<double> values;
+    texts.reserve(count);
+    values.reserve(count);
+    uint64_t state = 42;
+    auto random = [&state] {
+        state = state * 6364136223846793005ull + 1442695040888963407ull;
+        return state >> 33;
+    };
+    for (size_t i = 0; i < count; i++) {
+        long long integer = static_cast<long long>(random() % 2000000) - 1000000;
+        if (i % 2 == 0) {
+            texts.push_back(std::to_string(integer));
+        } else {
+            texts.push_back(std::to_string(integer) + "." + std::to_string(random() % 100000));
         }
+        values.push_back(static_cast<double>(integer) / 64.0);
     }
+    std::cout << "numbers: " << count << " values" << std::endl;
     
-    // Execute lines sequentially
-    for (size_t i = 0; i < lines.size(); i++) {
-        std::string currentLine = lines[i];
-        
-        // Skip empty lines and comments
-        if (currentLine.empty() || currentLine.find("@rem") != std::string::npos || 
-            currentLine.find("##") != std::string::npos) {
-            continue;
+    auto measure = [&](const char* name, auto&& body) {
+        auto start = std::chrono::steady_clock::now();
+        double checksum = body();
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        std::cout << name << ": " << count / seconds / 1e6 << " M/s (checksum " << checksum << ")" << std::endl;
+    };
+    
+    measure("parse  parseNumber", [&] {
+        double sum = 0, number = 0;
+        for (const std::string& text : texts) {
+            if (parseNumber(text, number) != NumberForm::None) sum += number;
         }
-        
-        // Handle variable declarations
-        if (currentLine.find("new variable") != std::string::npos || 
-            currentLine.find("rename variable") != std::string::npos) {
-            processVariableLine(currentLine, i + 1);
+        return sum;
+    });
+    measure("parse  regex + std::stod", [&] {
+        static const std::regex numericLiteral("^-?\\d+$");
+        static const std::regex floatingLiteral("^-?\\d+\\.\\d+$");
+        double sum = 0;
+        for (const std::string& text : texts) {
+            if (std::regex_match(text, numericLiteral) || std::regex_match(text, floatingLiteral)) sum += std::stod(text);
         }
-        // Handle Print statements
-        else if (currentLine.find("Print(") != std::string::npos) {
-            std::regex printCall("Print\\((f?\"[^\"]*\")\\);");
-            std::smatch match;
-            if (std::regex_search(currentLine, match, printCall)) {
-                std::string text = match[1].str();
-                executePrint(text);
-            }
+        return sum;
+    });
+    measure("format formatNumber", [&] {
+        double length = 0;
+        std::string text;
+        for (double value : values) {
+            formatNumber(value, false, text);
+            length += static_cast<double>(text.length());
         }
-        // Handle if statements
-        else if (currentLine.find("if (") != std::string::npos) {
-            // Find the complete if block
-            std::string ifBlock = currentLine;
-            size_t j = i + 1;
-            while (j < lines.size() && lines[j].find("endif;") == std::string::npos) {
-                ifBlock += "\n" + lines[j];
-                j++;
-            }
-            if (j < lines.size()) {
-                ifBlock += "\n" + lines[j]; // Add endif line
-            }
-            processIfStatement(ifBlock);
-            i = j; // Skip processed lines
+        return length;
+    });
+    measure("format std::to_string", [&] {
+        double length = 0;
+        for (double value : values) {
+            length += static_cast<double>(std::to_string(value).length());
         }
-    }
+        return length;
+    });
 }
 
-void IornInterpreter::processVariableLine(const std::string& line, int lineNum) {
-    if (line.find("new variable") != std::string::npos) {
-        std::regex nullDeclaration("new variable\\s+(\\w+)\\s+NULL;");
-        std::smatch nullMatch;
-        if (std::regex_search(line, nullMatch, nullDeclaration)) {
-            std::string varName = nullMatch[1].str();
-            variables[varName] = "null";
+// `iorn --watch file.iorn`: runs the script, then runs it again whenever the
+// file is saved. Parsed statements stay cached in the interpreter between
+// runs, so after an edit only the changed statements are parsed again.
+static int watchFile(IornInterpreter& interpreter, const std::string& filename) {
+    const int debounceMs = 100;
+    
+    auto runOnce = [&]() {
+        std::ifstream file(filename);
+        if (!file.is_open()) {
+            std::cerr << "Error: Cannot open file " << filename << std::endl;
             return;
         }
+        std::string code((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+        interpreter.reset();
+        interpreter.setScriptPath(filename);
+        interpreter.interpret(code);
+        interpreter.printStats();
         
-        std::regex varDeclaration("new variable\\s+(\\w+)\\s+(string|numeric|floating|boolean)\\s*=\\s*([^;]+);");
-        std::smatch match;
-        
-        if (std::regex_search(line, match, varDeclaration)) {
-            std::string varName = match[1].str();
-            std::string varType = match[2].str();
-            std::string varValue = match[3].str();
-            
-            bool isInputCall = varValue.find("input(") != std::string::npos;
-            if (isInputCall) {
-                std::regex inputCall("input\\((\"[^\"]*\"|[^)]*)\\)");
-                std::smatch inputMatch;
-                if (std::regex_search(varValue, inputMatch, inputCall)) {
-                    std::string prompt = inputMatch[1].str();
-                    if (!prompt.empty() && prompt.front() == '"' && prompt.back() == '"') {
-                        prompt = prompt.substr(1, prompt.length() - 2);
-                    }
-                    std::string inputValue = executeInput(prompt, varType);
-                    variables[varName] = inputValue;
-                }
-            } else {
-                if (!validateVariable(varName, varType, varValue, lineNum)) {
-                    return;
-                }
-                
-                std::string trimmedValue = varValue;
-                trimmedValue.erase(0, trimmedValue.find_first_not_of(" \t"));
-                trimmedValue.erase(trimmedValue.find_last_not_of(" \t") + 1);
-                
-                if (varType == "string" && trimmedValue.front() == '"' && trimmedValue.back() == '"') {
-                    trimmedValue = trimmedValue.substr(1, trimmedValue.length() - 2);
-                }
-                
-                variables[varName] = trimmedValue;
-            }
-        }
+        const RunStats& stats = interpreter.lastRunStats();
+        std::cerr << "[watch] " << stats.parsedStatements << " of " << stats.statements
+                  << " statements parsed, front end " << stats.frontEndMs << " ms, execution "
+                  << stats.executeMs << " ms" << std::endl;
+    };
+    
+    runOnce();
+    
+#ifdef __linux__
+    size_t slash = filename.find_last_of('/');
+    std::string directory = (slash == std::string::npos) ? "." : filename.substr(0, slash + 1);
+    std::string baseName = (slash == std::string::npos) ? filename : filename.substr(slash + 1);
+    
+    // Editors often save by writing a new file and renaming it over the old
+    // one, so the directory is watched rather than the file itself.
+    int fd = inotify_init1(IN_CLOEXEC);
+    if (fd < 0 || inotify_add_watch(fd, directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE) < 0) {
+        std::cerr << "Error: Cannot watch " << directory << std::endl;
+        return 1;
     }
     
-    if (line.find("rename variable") != std::string::npos) {
-        std::regex renameDeclaration("rename variable\\s+(\\w+)\\s+(string|numeric|floating|boolean)\\s*=\\s*([^;]+);");
-        std::smatch match;
+    alignas(inotify_event) char buffer[4096];
+    while (true) {
+        ssize_t length = read(fd, buffer, sizeof(buffer));
+        if (length <= 0) break;
         
-        if (std::regex_search(line, match, renameDeclaration)) {
-            std::string varName = match[1].str();
-            std::string varType = match[2].str();
-            std::string varValue = match[3].str();
-            
-            if (variables.find(varName) == variables.end()) {
-                setRedColor();
-                std::cerr << "Variable '" << varName << "' does not exist for rename on line " << lineNum << "." << std::endl;
-                resetColor();
-                return;
-            }
-            
-            if (varValue.find("input(") != std::string::npos) {
-                std::regex inputCall("input\\((\"[^\"]*\"|[^)]*)\\)");
-                std::smatch inputMatch;
-                if (std::regex_search(varValue, inputMatch, inputCall)) {
-                    std::string prompt = inputMatch[1].str();
-                    if (!prompt.empty() && prompt.front() == '"' && prompt.back() == '"') {
-                        prompt = prompt.substr(1, prompt.length() - 2);
-                    }
-                    std::string inputValue = executeInput(prompt, varType);
-                    variables[varName] = inputValue;
-                }
-            } else {
-                std::string trimmedValue = varValue;
-                trimmedValue.erase(0, trimmedValue.find_first_not_of(" \t"));
-                trimmedValue.erase(trimmedValue.find_last_not_of(" \t") + 1);
-                
-                if (varType == "string" && trimmedValue.front() == '"' && trimmedValue.back() == '"') {
-                    trimmedValue = trimmedValue.substr(1, trimmedValue.length() - 2);
-                }
-                
-                variables[varName] = trimmedValue;
-            }
+        bool changed = false;
+        for (char* p = buffer; p < buffer + length; ) {
+            inotify_event* event = reinterpret_cast<inotify_event*>(p);
+            if (event->len > 0 && baseName == event->name) changed = true;
+            p += sizeof(inotify_event) + event->len;
         }
+        if (!changed) continue;
+        
+        // Debounce: a burst of saves produces a single run.
+        pollfd pending = {fd, POLLIN, 0};
+        while (poll(&pending, 1, debounceMs) > 0) {
+            if (read(fd, buffer, sizeof(buffer)) <= 0) break;
+        }
+        runOnce();
+    }
+    close(fd);
+#else
+    std::error_code error;
+    auto lastWrite = std::filesystem::last_write_time(filename, error);
+    while (true) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(debounceMs));
+        auto current = std::filesystem::last_write_time(filename, error);
+        if (error || current == lastWrite) continue;
+        
+        // Debounce: wait until the file stops changing.
+        do {
+            lastWrite = current;
+            std::this_thread::sleep_for(std::chrono::milliseconds(debounceMs));
+            current = std::filesystem::last_write_time(filename, error);
+        } while (!error && current != lastWrite);
+        runOnce();
     }
+#endif
+    return 0;
 }
 
-void IornInterpreter::processIfStatement(const std::string& cleanCode) {
-    size_t ifPos = cleanCode.find("if (");
-    size_t thenPos = cleanCode.find("then:");
-    size_t elsePerformPos = cleanCode.find("else perform:");
-    size_t endifPos = cleanCode.find("endif;");
-    
-    if (ifPos == std::string::npos || thenPos == std::string::npos || endifPos == std::string::npos) {
-        setRedColor();
-        std::cerr << "Error: Invalid if statement structure." << std::endl;
-        resetColor();
-        return;
-    }
+#ifndef _WIN32
+// Connection of `iorn --serve`. Requests and replies are sequences of
+// frames: a line `<name> <length>` followed by that many bytes. A request
+// is a `path` or `source` frame, an optional `input` frame and a `run`
+// frame; the reply is `stdout` and `stderr` frames followed by a `status`
+// frame holding the exit status. A connection may carry any number of
+// requests, one after another. Frames longer than maxFrameLength are
+// refused rather than buffered.
+class FrameChannel {
+public:
+    static constexpr size_t maxFrameLength = 64 << 20;
     
-    size_t closeParenPos = cleanCode.find(")", ifPos);
-    std::string condition1 = cleanCode.substr(ifPos + 4, closeParenPos - ifPos - 4);
+    explicit FrameChannel(int fd) : fd(fd) {}
     
-    size_t thenStart = thenPos + 5;
-    size_t firstElsePos = cleanCode.find("else to if (", thenStart);
-    size_t thenEnd = (firstElsePos != std::string::npos) ? firstElsePos : 
-                    (elsePerformPos != std::string::npos) ? elsePerformPos : endifPos;
-    std::string thenBlock = cleanCode.substr(thenStart, thenEnd - thenStart);
+    int descriptor() const { return fd; }
+    bool buffered() const { return !buffer.empty(); }
+    bool oversized() const { return tooLong; }
     
-    std::vector<std::pair<std::string, std::string>> elseIfBlocks;
-    size_t searchPos = thenEnd;
+    bool readFrame(std::string& name, std::string& payload) {
+        size_t newline;
+        while ((newline = buffer.find('\n')) == std::string::npos) {
+            if (buffer.length() > 256 || !fill()) return false;
+        }
+        size_t space = buffer.find(' ');
+        if (space == std::string::npos || space > newline) return false;
+        size_t length = 0;
+        auto result = std::from_chars(buffer.data() + space + 1, buffer.data() + newline, length);
+        if (result.ec != std::errc() || result.ptr != buffer.data() + newline) return false;
+        if (length > maxFrameLength) {
+            tooLong = true;
+            return false;
+        }
+        name.assign(buffer, 0, space);
+        buffer.erase(0, newline + 1);
+        while (buffer.length() < length) {
+            if (!fill()) return false;
+        }
+        payload.assign(buffer, 0, length);
+        buffer.erase(0, length);
+        return true;
+    }
     
-    while (searchPos < endifPos) {
-        size_t elseToIfPos = cleanCode.find("else to if (", searchPos);
-        if (elseToIfPos == std::string::npos || elseToIfPos >= endifPos) break;
-        
-        size_t resumePos = cleanCode.find(") resume:", elseToIfPos);
-        if (resumePos == std::string::npos) break;
-        
-        std::string condition = cleanCode.substr(elseToIfPos + 12, resumePos - elseToIfPos - 12);
-        
-        size_t blockStart = resumePos + 9;
-        size_t nextElsePos = cleanCode.find("else to if (", blockStart);
-        size_t blockEnd = (nextElsePos != std::string::npos && nextElsePos < endifPos) ? nextElsePos :
-                         (elsePerformPos != std::string::npos && elsePerformPos > blockStart) ? elsePerformPos : endifPos;
-        
-        std::string block = cleanCode.substr(blockStart, blockEnd - blockStart);
-        elseIfBlocks.push_back({condition, block});
-        
-        searchPos = blockEnd;
+    bool writeFrame(std::string_view name, std::string_view payload) {
+        std::string header(name);
+        header += ' ';
+        header += std::to_string(payload.length());
+        header += '\n';
+        return writeAll(header) && writeAll(payload);
     }
     
-    std::string elseBlock = "";
-    if (elsePerformPos != std::string::npos) {
-        size_t elseStart = elsePerformPos + 13;
-        elseBlock = cleanCode.substr(elseStart, endifPos - elseStart);
+private:
+    bool fill() {
+        char chunk[16384];
+        ssize_t length;
+        do {
+            length = ::read(fd, chunk, sizeof(chunk));
+        } while (length < 0 && errno == EINTR);
+        if (length <= 0) return false;
+        buffer.append(chunk, static_cast<size_t>(length));
+        return true;
     }
     
-    try {
-        if (evaluateCondition(condition1)) {
-            executeBlock(thenBlock);
-            return;
-        }
-        
-        for (const auto& elseIf : elseIfBlocks) {
-            if (evaluateCondition(elseIf.first)) {
-                executeBlock(elseIf.second);
-                return;
-            }
-        }
-        
-        if (!elseBlock.empty()) {
-            executeBlock(elseBlock);
+    bool writeAll(std::string_view data) {
+        while (!data.empty()) {
+            ssize_t length = ::write(fd, data.data(), data.length());
+            if (length < 0 && errno == EINTR) continue;
+            if (length <= 0) return false;
+            data.remove_prefix(static_cast<size_t>(length));
         }
-    } catch (...) {
-        setRedColor();
-        std::cerr << "Error: Invalid condition or expression in if statement." << std::endl;
-        resetColor();
+        return true;
     }
-}
-
-void createPackagedApp(const std::string& sourceFile, const std::string& extension, 
-                      const std::string& outName, const std::string& icon, bool loopMain) {
-    std::string templateCode = R"(
-#include <iostream>
-#include <string>
-#include <fstream>
-#include <cstdlib>
+    
+    int fd;
+    std::string buffer;
+    bool tooLong = false;
+};
 
-int main() {
-    std::string iornCode = R"IORN_CODE(
-)IORN_CODE_PLACEHOLDER(
-)IORN_CODE";
+// Output of a served run, sent as frames of up to 64 KB while the run goes
+// on. Flushes such as std::endl do not send a frame of their own.
+class FrameStreamBuf : public std::streambuf {
+public:
+    FrameStreamBuf(FrameChannel& channel, const char* name) : channel(channel), name(name) {}
     
-    std::ofstream tempFile("temp_iorn_code.iorn");
-    tempFile << iornCode;
-    tempFile.close();
+    void send() {
+        if (!pending.empty()) channel.writeFrame(name, pending);
+        pending.clear();
+    }
     
-    std::string command = "iorn.exe temp_iorn_code.iorn";
-    int result = system(command.c_str());
+protected:
+    int_type overflow(int_type c) override {
+        if (!traits_type::eq_int_type(c, traits_type::eof())) {
+            pending += traits_type::to_char_type(c);
+            if (pending.length() >= 65536) send();
+        }
+        return traits_type::not_eof(c);
+    }
     
-    remove("temp_iorn_code.iorn");
+    std::streamsize xsputn(const char* data, std::streamsize count) override {
+        pending.append(data, static_cast<size_t>(count));
+        if (pending.length() >= 65536) send();
+        return count;
+    }
     
-    LOOP_PLACEHOLDER
+private:
+    FrameChannel& channel;
+    const char* name;
+    std::string pending;
+};
+
+// Connection of `iorn --serve` between requests. It belongs to the poll loop
+// while idle and to one worker while a request on it is read and run; the
+// script and any bytes of the next request stay with it in between.
+struct ServedConnection {
+    explicit ServedConnection(int fd) : channel(fd) {}
+    ~ServedConnection() { close(channel.descriptor()); }
     
-    return result;
+    FrameChannel channel;
+    std::string path, source, input;
+    bool haveSource = false;
+};
+
+// Reads one request from a connection and runs it on this worker's
+// interpreter. Each run starts from reset() state and sees only its own
+// input; parsed statements and whole programs stay cached in the interpreter
+// between requests. Returns false once the connection should be closed.
+static bool serveRequest(ServedConnection& connection, IornInterpreter& interpreter) {
+    FrameChannel& channel = connection.channel;
+    std::string name, payload;
+    while (channel.readFrame(name, payload)) {
+        if (name == "path") {
+            connection.path = std::move(payload);
+            connection.haveSource = false;
+        } else if (name == "source") {
+            connection.source = std::move(payload);
+            connection.haveSource = true;
+            connection.path.clear();
+        } else if (name == "input") {
+            connection.input = std::move(payload);
+        } else if (name == "run") {
+            FrameStreamBuf outBuffer(channel, "stdout"), errBuffer(channel, "stderr");
+            std::ostream out(&outBuffer), err(&errBuffer);
+            InputReader reader(std::move(connection.input));
+            connection.input.clear();
+            scriptOut = &out;
+            scriptErr = &err;
+            scriptInput = &reader;
+            
+            int status = 0;
+            if (!connection.haveSource) {
+                std::ifstream file(connection.path);
+                if (file.is_open()) {
+                    connection.source.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+                } else {
+                    err << "Error: Cannot open file " << connection.path << std::endl;
+                    status = 1;
+                }
+            }
+            if (status == 0) {
+                interpreter.reset();
+                interpreter.setScriptPath(connection.path);
+                interpreter.interpret(connection.source);
+                status = exitStatus(interpreter.lastRunStats().status);
+            }
+            
+            scriptOut = &std::cout;
+            scriptErr = &std::cerr;
+            scriptInput = &standardInput;
+            outBuffer.send();
+            errBuffer.send();
+            return channel.writeFrame("status", std::to_string(status));
+        } else {
+            channel.writeFrame("stderr", "Error: Unknown request frame '" + name + "'\n");
+            channel.writeFrame("status", "1");
+            return false;
+        }
+    }
+    if (channel.oversized()) {
+        channel.writeFrame("stderr", "Error: Request frame is longer than " +
+                           std::to_string(FrameChannel::maxFrameLength) + " bytes\n");
+        channel.writeFrame("status", "1");
+    }
+    return false;
 }
-)";
-    
-    std::ifstream sourceFileStream(sourceFile);
-    if (!sourceFileStream.is_open()) {
-        std::cerr << "Error: Cannot open source file " << sourceFile << std::endl;
-        return;
+
+// `iorn --serve /path/to/sock`: accepts connections on a Unix socket and
+// polls them while idle; each request that arrives goes to a pool of workers,
+// every worker with an interpreter of its own, and its connection comes back
+// to the poll loop once the reply is sent. A client that stalls in the middle
+// of a request or reply for requestTimeout seconds is disconnected. Limits
+// such as --timeout and --max-memory apply to every request.
+static int serve(const std::string& socketPath, InterpreterOptions options, size_t workers) {
+    constexpr int requestTimeout = 10;
+    sockaddr_un address{};
+    if (socketPath.length() >= sizeof(address.sun_path)) {
+        std::cerr << "Error: Socket path is too long: " << socketPath << std::endl;
+        return 1;
     }
+    address.sun_family = AF_UNIX;
+    std::memcpy(address.sun_path, socketPath.c_str(), socketPath.length() + 1);
     
-    std::string iornCode((std::istreambuf_iterator<char>(sourceFileStream)), 
-                        std::istreambuf_iterator<char>());
-    sourceFileStream.close();
-    
-    size_t pos = templateCode.find(")IORN_CODE_PLACEHOLDER(");
-    if (pos != std::string::npos) {
-        templateCode.replace(pos, 23, iornCode);
+    int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+    unlink(socketPath.c_str());
+    if (listener < 0 || bind(listener, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 ||
+        listen(listener, 128) != 0) {
+        std::cerr << "Error: Cannot listen on " << socketPath << ": " << std::strerror(errno) << std::endl;
+        if (listener >= 0) close(listener);
+        return 1;
     }
-    
-    std::string loopCode = loopMain ? 
-        "std::cout << \"Press Enter to exit...\"; std::cin.get();" : "";
-    pos = templateCode.find("LOOP_PLACEHOLDER");
-    if (pos != std::string::npos) {
-        templateCode.replace(pos, 16, loopCode);
+    // Workers write a byte here when they hand a connection back.
+    int wake[2];
+    if (pipe(wake) != 0) {
+        std::cerr << "Error: Cannot create pipe: " << std::strerror(errno) << std::endl;
+        close(listener);
+        return 1;
     }
+    // A client that goes away mid-reply must not end the server.
+    std::signal(SIGPIPE, SIG_IGN);
+    options.cachePrograms = true;
     
-    std::string cppFile = outName + "_generated.cpp";
-    std::ofstream cppFileStream(cppFile);
-    cppFileStream << templateCode;
-    cppFileStream.close();
-    
-    // Create resource file with icon
-    std::string rcFile = outName + ".rc";
-    std::ofstream rcStream(rcFile);
-    rcStream << "IDI_ICON1 ICON \"..\\assets\\iorn_ico_exeFile_ordinary.ico\"" << std::endl;
-    rcStream.close();
+    std::mutex mutex;
+    std::condition_variable ready;
+    std::deque<std::unique_ptr<ServedConnection>> requests;
+    std::vector<std::unique_ptr<ServedConnection>> served;
+    bool stopping = false;
+    std::vector<std::thread> pool;
+    for (size_t i = 0; i < workers; i++) {
+        pool.emplace_back([&] {
+            IornInterpreter interpreter;
+            interpreter.setOptions(options);
+            while (true) {
+                std::unique_ptr<ServedConnection> connection;
+                {
+                    std::unique_lock<std::mutex> lock(mutex);
+                    ready.wait(lock, [&] { return stopping || !requests.empty(); });
+                    if (stopping) return;
+                    connection = std::move(requests.front());
+                    requests.pop_front();
+                }
+                if (!serveRequest(*connection, interpreter)) continue;
+                std::lock_guard<std::mutex> lock(mutex);
+                served.push_back(std::move(connection));
+                char byte = 0;
+                while (write(wake[1], &byte, 1) < 0 && errno == EINTR) {}
+            }
+        });
+    }
+    std::cerr << "Serving on " << socketPath << " with " << workers << " workers" << std::endl;
     
-    // Compile resource and then executable
-    std::string rcCompileCmd = "windres " + rcFile + " -o " + outName + ".o";
-    int rcResult = system(rcCompileCmd.c_str());
+    int status = 0;
+    std::vector<std::unique_ptr<ServedConnection>> idle, arrived;
+    std::vector<pollfd> polled;
+    while (true) {
+        polled.clear();
+        polled.push_back({listener, POLLIN, 0});
+        polled.push_back({wake[0], POLLIN, 0});
+        for (const auto& connection : idle) polled.push_back({connection->channel.descriptor(), POLLIN, 0});
+        if (poll(polled.data(), polled.size(), -1) < 0) {
+            if (errno == EINTR) continue;
+            std::cerr << "Error: poll failed: " << std::strerror(errno) << std::endl;
+            status = 1;
+            break;
+        }
+        
+        // Readable and hung-up connections alike go to a worker, which reads
+        // the request or notices the end of the connection.
+        for (size_t i = idle.size(); i-- > 0;) {
+            if (polled[i + 2].revents == 0) continue;
+            arrived.push_back(std::move(idle[i]));
+            idle[i] = std::move(idle.back());
+            idle.pop_back();
+        }
+        if (polled[1].revents & POLLIN) {
+            char bytes[64];
+            while (read(wake[0], bytes, sizeof(bytes)) < 0 && errno == EINTR) {}
+            std::lock_guard<std::mutex> lock(mutex);
+            // A client may have sent its next request along with the last one.
+            for (auto& connection : served) {
+                (connection->channel.buffered() ? arrived : idle).push_back(std::move(connection));
+            }
+            served.clear();
+        }
+        if (polled[0].revents & POLLIN) {
+            int fd = accept(listener, nullptr, nullptr);
+            if (fd >= 0) {
+                timeval timeout{requestTimeout, 0};
+                setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+                setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+                idle.push_back(std::make_unique<ServedConnection>(fd));
+            } else if (errno != EINTR && errno != ECONNABORTED) {
+                std::cerr << "Error: accept failed: " << std::strerror(errno) << std::endl;
+                status = 1;
+                break;
+            }
+        }
+        if (!arrived.empty()) {
+            std::lock_guard<std::mutex> lock(mutex);
+            for (auto& connection : arrived) requests.push_back(std::move(connection));
+            arrived.clear();
+            ready.notify_all();
+        }
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    ready.notify_all();
+    for (std::thread& worker : pool) worker.join();
+    close(wake[0]);
+    close(wake[1]);
+    close(listener);
+    unlink(socketPath.c_str());
+    return status;
+}
+
+// `iorn --load=/path/to/sock file.iorn`: load generator for `iorn --serve`.
+// Each connection sends the script's source over and over and waits for the
+// reply; requests per second and latency percentiles are printed at the end.
+static int loadServer(const std::string& socketPath, const std::string& sourceFile, size_t connections, size_t requests) {
+    std::ifstream file(sourceFile);
+    if (!file.is_open()) {
+        std::cerr << "Error: Cannot open file " << sourceFile << std::endl;
+        return 1;
+    }
+    std::string source((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    sockaddr_un address{};
+    if (socketPath.length() >= sizeof(address.sun_path)) {
+        std::cerr << "Error: Socket path is too long: " << socketPath << std::endl;
+        return 1;
+    }
+    address.sun_family = AF_UNIX;
+    std::memcpy(address.sun_path, socketPath.c_str(), socketPath.length() + 1);
     
-    std::string compileCmd = "g++ -std=c++11 -O2 -o " + outName + extension + " " + cppFile;
-    if (rcResult == 0) {
-        compileCmd += " " + outName + ".o";
+    std::vector<std::vector<double>> latencies(connections);
+    std::vector<size_t> failures(connections, 0);
+    std::vector<std::thread> clients;
+    auto start = std::chrono::steady_clock::now();
+    for (size_t c = 0; c < connections; c++) {
+        clients.emplace_back([&, c] {
+            size_t count = requests / connections + (c < requests % connections ? 1 : 0);
+            int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+            if (fd < 0 || connect(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0) {
+                failures[c] = count;
+                if (fd >= 0) close(fd);
+                return;
+            }
+            FrameChannel channel(fd);
+            std::string name, payload;
+            latencies[c].reserve(count);
+            for (size_t r = 0; r < count; r++) {
+                auto sent = std::chrono::steady_clock::now();
+                if (!channel.writeFrame("source", source) || !channel.writeFrame("run", "")) {
+                    failures[c] += count - r;
+                    break;
+                }
+                bool replied = false;
+                while (channel.readFrame(name, payload)) {
+                    if (name == "status") {
+                        replied = true;
+                        break;
+                    }
+                }
+                if (!replied) {
+                    failures[c] += count - r;
+                    break;
+                }
+                if (payload != "0") failures[c]++;
+                latencies[c].push_back(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - sent).count());
+            }
+            close(fd);
+        });
     }
+    for (std::thread& client : clients) client.join();
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
     
-    if (system(compileCmd.c_str()) == 0) {
-        std::cout << "Successfully packaged to: " << outName << extension << std::endl;
-        remove(cppFile.c_str());
-        remove((outName + ".rc").c_str());
-        remove((outName + ".o").c_str());
-        remove((outName + ".res").c_str());
+    std::vector<double> all;
+    for (const auto& each : latencies) all.insert(all.end(), each.begin(), each.end());
+    size_t failed = 0;
+    for (size_t each : failures) failed += each;
+    std::sort(all.begin(), all.end());
+    auto percentile = [&all](double p) {
+        return all.empty() ? 0.0 : all[std::min(all.size() - 1, static_cast<size_t>(p * all.size()))];
+    };
+    std::cout << "requests: " << all.size() << " over " << connections << " connections, "
+              << failed << " failed" << std::endl;
+    std::cout << "throughput: " << all.size() / seconds << " req/s" << std::endl;
+    std::cout << "latency: p50 " << percentile(0.50) << " ms, p99 " << percentile(0.99) << " ms, max "
+              << (all.empty() ? 0.0 : all.back()) << " ms" << std::endl;
+    return failed == 0 ? 0 : 1;
+}
+#endif
 
-    } else {
-        std::cerr << "Error: Failed to compile packaged application" << std::endl;
-    }
+// Parses "65536", "512K", "64M" or "1G" (powers of 1024).
+static bool parseByteSize(const std::string& text, size_t& bytes) {
+    size_t value = 0;
+    auto result = std::from_chars(text.data(), text.data() + text.length(), value);
+    if (result.ec != std::errc() || result.ptr == text.data()) return false;
+    std::string_view suffix(result.ptr, text.data() + text.length() - result.ptr);
+    if (suffix.empty() || suffix == "B") bytes = value;
+    else if (suffix == "K" || suffix == "KB") bytes = value << 10;
+    else if (suffix == "M" || suffix == "MB") bytes = value << 20;
+    else if (suffix == "G" || suffix == "GB") bytes = value << 30;
+    else return false;
+    return true;
+}
+
+// Milliseconds from "250", "250ms" or "2s".
+static bool parseDuration(const std::string& text, size_t& milliseconds) {
+    size_t value = 0;
+    auto result = std::from_chars(text.data(), text.data() + text.length(), value);
+    if (result.ec != std::errc() || result.ptr == text.data()) return false;
+    std::string_view suffix(result.ptr, text.data() + text.length() - result.ptr);
+    if (suffix.empty() || suffix == "ms") milliseconds = value;
+    else if (suffix == "s") milliseconds = value * 1000;
+    else return false;
+    return true;
 }
 
 int main(int argc, char* argv[]) {
@@ -1065,7 +7513,17 @@ int main(int argc, char* argv[]) {
         
         bool isPackaging = false;
         std::string sourceFile, extension = ".exe", outName = "app", icon = "False";
+        std::vector<std::string> sourceFiles;
+        std::string benchName;
         bool loopMain = false;
+        bool lspMode = false;
+        bool watchMode = false;
+        bool streamMode = false;
+        bool selfTestMode = false;
+        std::string servePath, loadPath;
+        size_t workers = std::max(1u, std::thread::hardware_concurrency());
+        size_t connections = 8, requests = 10000;
+        InterpreterOptions options;
         
         for (int i = 1; i < argc; i++) {
             std::string arg = argv[i];
@@ -1080,22 +7538,196 @@ int main(int argc, char* argv[]) {
             } else if (arg.find("--loop_main=") == 0) {
                 std::string loopStr = arg.substr(12);
                 loopMain = (loopStr == "True" || loopStr == "true");
+            } else if (arg.find("--stats=") == 0) {
+                std::stringstream kinds(arg.substr(8));
+                std::string kind;
+                while (std::getline(kinds, kind, ',')) {
+                    if (kind == "alloc") {
+                        options.allocStats = true;
+                    } else if (kind == "mem") {
+                        options.memStats = true;
+                    } else if (kind == "cpu") {
+                        options.cpuStats = true;
+                    } else {
+                        std::cerr << "Error: Unknown statistics '" << kind << "'" << std::endl;
+                        return 1;
+                    }
+                }
+            } else if (arg.find("--max-memory=") == 0) {
+                if (!parseByteSize(arg.substr(13), options.maxMemory)) {
+                    std::cerr << "Error: Invalid memory limit '" << arg.substr(13) << "'" << std::endl;
+                    return 1;
+                }
+            } else if (arg.find("--max-steps=") == 0 || arg.find("--max-inputs=") == 0) {
+                bool steps = arg[6] == 's';
+                std::string value = arg.substr(steps ? 12 : 13);
+                auto result = std::from_chars(value.data(), value.data() + value.length(), steps ? options.maxSteps : options.maxInputs);
+                if (result.ec != std::errc() || result.ptr != value.data() + value.length()) {
+                    std::cerr << "Error: Invalid " << (steps ? "step" : "input") << " limit '" << value << "'" << std::endl;
+                    return 1;
+                }
+            } else if (arg.find("--timeout=") == 0) {
+                if (!parseDuration(arg.substr(10), options.timeoutMs)) {
+                    std::cerr << "Error: Invalid timeout '" << arg.substr(10) << "'" << std::endl;
+                    return 1;
+                }
+            } else if (arg == "--serve" && i + 1 < argc) {
+                servePath = argv[++i];
+            } else if (arg.find("--load=") == 0) {
+                loadPath = arg.substr(7);
+            } else if (arg.find("--workers=") == 0 || arg.find("--connections=") == 0 || arg.find("--requests=") == 0) {
+                size_t equals = arg.find('=');
+                std::string value = arg.substr(equals + 1);
+                size_t& target = arg[2] == 'w' ? workers : (arg[2] == 'c' ? connections : requests);
+                auto result = std::from_chars(value.data(), value.data() + value.length(), target);
+                if (result.ec != std::errc() || result.ptr != value.data() + value.length() || target == 0) {
+                    std::cerr << "Error: Invalid value '" << value << "' for " << arg.substr(0, equals) << std::endl;
+                    return 1;
+                }
+            } else if (arg == "--opt-report") {
+                options.optReport = true;
+            } else if (arg == "--watch") {
+                watchMode = true;
+            } else if (arg == "--stream") {
+                streamMode = true;
+            } else if (arg == "-") {
+                streamMode = true;
+                sourceFile = arg;
+                sourceFiles.push_back(arg);
+            } else if (arg == "--lsp") {
+                lspMode = true;
+            } else if (arg == "--self-test") {
+                selfTestMode = true;
+            } else if (arg.find("--bench=") == 0) {
+                benchName = arg.substr(8);
+            } else if (arg.find("--generate=") == 0) {
+                if (!printGeneratedScript(arg.substr(11))) {
+                    std::cerr << "Error: Invalid script family '" << arg.substr(11) << "'" << std::endl;
+                    return 1;
+                }
+                return 0;
             } else if (arg.find(".iorn") != std::string::npos) {
                 sourceFile = arg;
+                sourceFiles.push_back(arg);
             }
         }
         
+        interpreter.setOptions(options);
+        
+        if (lspMode) {
+            return LanguageServer().run();
+        }
+        
+        if (!servePath.empty() || !loadPath.empty()) {
+#ifndef _WIN32
+            if (!servePath.empty()) {
+                return serve(servePath, options, workers);
+            }
+            if (sourceFile.empty()) {
+                std::cerr << "Error: No .iorn source file specified" << std::endl;
+                return 1;
+            }
+            return loadServer(loadPath, sourceFile, connections, requests);
+#else
+            std::cerr << "Error: --serve and --load need Unix sockets" << std::endl;
+            return 1;
+#endif
+        }
+        
+        if (watchMode) {
+            if (sourceFile.empty()) {
+                std::cerr << "Error: No .iorn source file specified" << std::endl;
+                return 1;
+            }
+            return watchFile(interpreter, sourceFile);
+        }
+        
+        if (selfTestMode) {
+            return selfTest() ? 0 : 1;
+        }
+        
+        if (!benchName.empty()) {
+            if (benchName == "scan") {
+                std::string corpus;
+                if (!sourceFile.empty()) {
+                    std::ifstream file(sourceFile);
+                    corpus.assign((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+                } else {
+                    corpus = generateBenchCorpus(16u << 20);
+                }
+                benchScan(corpus);
+            } else if (benchName == "cond") {
+                benchConditions();
+            } else if (benchName == "numbers") {
+                benchNumbers();
+            } else if (benchName == "fib") {
+                benchFib();
+            } else if (benchName == "arrays") {
+                benchArrays();
+            } else if (benchName == "scaling") {
+                return benchScaling() ? 0 : 1;
+            } else {
+                std::cerr << "Error: Unknown benchmark '" << benchName << "'" << std::endl;
+                return 1;
+            }
+            return 0;
+        }
+        
         if (isPackaging) {
             if (sourceFile.empty()) {
                 std::cerr << "Error: No .iorn source file specified" << std::endl;
                 return 1;
             }
             createPackagedApp(sourceFile, extension, outName, icon, loopMain);
+        } else if (streamMode) {
+            if (sourceFiles.empty()) {
+                std::cerr << "Error: No .iorn source file specified" << std::endl;
+                return 1;
+            }
+            int status = 0;
+            for (const std::string& file : sourceFiles) {
+                interpreter.reset();
+                interpreter.streamFile(file);
+                status = std::max(status, exitStatus(interpreter.lastRunStats().status));
+            }
+            return status;
+        } else if (sourceFiles.size() > 1) {
+            // Scripts run one after another in this process and share the
+            // parsed statements and modules.
+            int status = 0;
+            for (const std::string& file : sourceFiles) {
+                interpreter.reset();
+                interpreter.interpretFile(file);
+                status = std::max(status, exitStatus(interpreter.lastRunStats().status));
+            }
+            return status;
         } else {
-            interpreter.interpretFile(firstArg);
+            interpreter.interpretFile(sourceFile.empty() ? firstArg : sourceFile);
+            return exitStatus(interpreter.lastRunStats().status);
         }
     } else {
-        std::cout << "Usage: iorn <filename.iorn>" << std::endl;
+        std::cout << "Usage: iorn <filename.iorn>..." << std::endl;
+        std::cout << "       iorn --watch <filename.iorn>" << std::endl;
+        std::cout << "       iorn --lsp" << std::endl;
+        std::cout << "       iorn --bench=<name> [filename.iorn]" << std::endl;
+        std::cout << "       iorn --self-test" << std::endl;
+        std::cout << "       iorn --serve <socket> [--workers=<n>]" << std::endl;
+        std::cout << "       iorn --load=<socket> <filename.iorn> [--connections=<n>] [--requests=<n>]" << std::endl;
+        std::cout << "       iorn --stream <filename.iorn>" << std::endl;
+        std::cout << "       iorn -" << std::endl;
+        std::cout << "       iorn --generate=<family>:<size>" << std::endl;
+        std::cout << "Options:" << std::endl;
+        std::cout << "  --stats=alloc,mem,cpu  print the heap allocations, memory and CPU counters of the run to stderr" << std::endl;
+        std::cout << "  --max-memory=<size>    stop a script that needs more memory (K, M and G suffixes)" << std::endl;
+        std::cout << "  --opt-report           print the constants folded and branches removed to stderr" << std::endl;
+        std::cout << "  --max-steps=<n>        stop after n statements" << std::endl;
+        std::cout << "  --timeout=<time>       stop after a time in milliseconds (ms and s suffixes)" << std::endl;
+        std::cout << "  --max-inputs=<n>       stop after n lines read by input()" << std::endl;
+        std::cout << "Exit status:" << std::endl;
+        std::cout << "  3  the script went over --max-memory" << std::endl;
+        std::cout << "  4  the script reached --max-steps" << std::endl;
+        std::cout << "  5  the script reached --timeout" << std::endl;
+        std::cout << "  6  the script reached --max-inputs, read past the end of its input or read a line over 16 MB" << std::endl;
     }
     
     return 0;
@@ -1,7 +1,142 @@
 const vscode = require('vscode');
-const { exec } = require('child_process');
+const { exec, spawn } = require('child_process');
 const path = require('path');
 
+// Клиент языкового сервера: `iorn --lsp` через stdio
+class IornLanguageClient {
+    constructor(diagnostics) {
+        this.diagnostics = diagnostics;
+        this.process = null;
+        this.buffer = Buffer.alloc(0);
+        this.nextId = 1;
+        this.versions = new Map();
+    }
+
+    start() {
+        try {
+            this.process = spawn('iorn', ['--lsp'], { stdio: ['pipe', 'pipe', 'ignore'] });
+        } catch (err) {
+            this.process = null;
+            return;
+        }
+
+        this.process.on('error', () => {
+            this.process = null;
+            vscode.window.showWarningMessage('IORN: diagnostics are unavailable, `iorn` was not found in PATH');
+        });
+        this.process.on('exit', () => {
+            this.process = null;
+        });
+        this.process.stdout.on('data', (chunk) => this.onData(chunk));
+
+        this.request('initialize', { processId: process.pid, rootUri: null, capabilities: {} });
+        this.notify('initialized', {});
+    }
+
+    stop() {
+        if (!this.process) {
+            return;
+        }
+        this.request('shutdown', null);
+        this.notify('exit', null);
+        this.process = null;
+    }
+
+    send(message) {
+        if (!this.process) {
+            return;
+        }
+        const body = Buffer.from(JSON.stringify(Object.assign({ jsonrpc: '2.0' }, message)), 'utf8');
+        this.process.stdin.write(`Content-Length: ${body.length}\r\n\r\n`);
+        this.process.stdin.write(body);
+    }
+
+    request(method, params) {
+        this.send({ id: this.nextId++, method, params });
+    }
+
+    notify(method, params) {
+        this.send({ method, params });
+    }
+
+    onData(chunk) {
+        this.buffer = Buffer.concat([this.buffer, chunk]);
+        while (true) {
+            const headerEnd = this.buffer.indexOf('\r\n\r\n');
+            if (headerEnd < 0) {
+                return;
+            }
+            const match = /Content-Length: (\d+)/i.exec(this.buffer.slice(0, headerEnd).toString('ascii'));
+            const length = match ? parseInt(match[1], 10) : 0;
+            if (this.buffer.length < headerEnd + 4 + length) {
+                return;
+            }
+            const body = this.buffer.slice(headerEnd + 4, headerEnd + 4 + length).toString('utf8');
+            this.buffer = this.buffer.slice(headerEnd + 4 + length);
+            this.onMessage(JSON.parse(body));
+        }
+    }
+
+    onMessage(message) {
+        if (message.method !== 'textDocument/publishDiagnostics') {
+            return;
+        }
+        const uri = vscode.Uri.parse(message.params.uri);
+        const items = message.params.diagnostics.map((d) => {
+            const range = new vscode.Range(d.range.start.line, d.range.start.character,
+                                           d.range.end.line, d.range.end.character);
+            const diagnostic = new vscode.Diagnostic(range, d.message, vscode.DiagnosticSeverity.Error);
+            diagnostic.source = 'iorn';
+            return diagnostic;
+        });
+        this.diagnostics.set(uri, items);
+    }
+
+    didOpen(document) {
+        if (document.languageId !== 'iorn') {
+            return;
+        }
+        this.versions.set(document.uri.toString(), document.version);
+        this.notify('textDocument/didOpen', {
+            textDocument: {
+                uri: document.uri.toString(),
+                languageId: 'iorn',
+                version: document.version,
+                text: document.getText()
+            }
+        });
+    }
+
+    // Отправляем только изменённые диапазоны, сервер перепроверяет лишь затронутые строки
+    didChange(event) {
+        const uri = event.document.uri.toString();
+        if (event.document.languageId !== 'iorn' || !this.versions.has(uri) || event.contentChanges.length === 0) {
+            return;
+        }
+        this.versions.set(uri, event.document.version);
+        this.notify('textDocument/didChange', {
+            textDocument: { uri, version: event.document.version },
+            contentChanges: event.contentChanges.map((change) => ({
+                range: {
+                    start: { line: change.range.start.line, character: change.range.start.character },
+                    end: { line: change.range.end.line, character: change.range.end.character }
+                },
+                text: change.text
+            }))
+        });
+    }
+
+    didClose(document) {
+        const uri = document.uri.toString();
+        if (!this.versions.has(uri)) {
+            return;
+        }
+        this.versions.delete(uri);
+        this.diagnostics.delete(document.uri);
+        this.notify('textDocument/didClose', { textDocument: { uri } });
+    }
+}
+
 function activate(context) {
     // Команда компиляции
     let compileCommand = vscode.commands.registerCommand('iorn.compile', function (uri) {
@@ -30,6 +165,20 @@ function activate(context) {
     });
 
     context.subscriptions.push(compileCommand, runCommand);
+
+    // Диагностика через языковой сервер
+    const diagnostics = vscode.languages.createDiagnosticCollection('iorn');
+    const client = new IornLanguageClient(diagnostics);
+    client.start();
+
+    vscode.workspace.textDocuments.forEach((document) => client.didOpen(document));
+    context.subscriptions.push(
+        diagnostics,
+        vscode.workspace.onDidOpenTextDocument((document) => client.didOpen(document)),
+        vscode.workspace.onDidChangeTextDocument((event) => client.didChange(event)),
+        vscode.workspace.onDidCloseTextDocument((document) => client.didClose(document)),
+        { dispose: () => client.stop() }
+    );
 }
 
 function deactivate() {}
@@ -37,4 +186,4 @@ function deactivate() {}
 module.exports = {
     activate,
     deactivate
-};
\ No newline at end of file
+};